@@ -0,0 +1,57 @@
+#ifndef _AUTOTUNE_H
+#define _AUTOTUNE_H
+
+/* Automatic selection of the matmul kernel.
+ *
+ * matMulSquare_auto_omp and matMulSquare_auto_mpi have the signatures
+ * of the other kernels and run whichever candidate was fastest for the
+ * key (backend, width rounded up to a power of two, threads, ranks,
+ * CPU model). On the first call for a key every candidate is timed on
+ * the arguments of that call, the winner is appended to the cache file
+ * and later calls, also in later runs, dispatch directly.
+ *
+ * The cache file is AUTOTUNE_CACHE from the environment, or
+ * autotune.cache in the working directory. Delete it (or the lines of
+ * a machine) to tune again. Lines are
+ *
+ *   backend width_bucket threads ranks method tile cpu model
+ *
+ * Candidates compute M_1 M_2: baseline, transpose and the tiled kernel
+ * with AUTOTUNE_TILES for OpenMP, baseline, balanced and transpose for
+ * MPI. The pretranspose kernels expect M_2 transposed and are not
+ * candidates. */
+
+#include <stdint.h>
+
+#define AUTOTUNE_REPS 3
+#define AUTOTUNE_TILES(X) X(16) X(32) X(64) X(128)
+#define AUTOTUNE_METHOD_LEN 32
+
+typedef struct {
+    char method[AUTOTUNE_METHOD_LEN];
+    int tile;
+} autotune_choice_t;
+
+/* width rounded up to the next power of two */
+int
+autotune_bucket(int width);
+
+/* fills choice and returns 0 if the key has been tuned, -1 if not */
+int
+autotune_lookup(const char *backend, int width, int threads, int ranks,
+        autotune_choice_t *choice);
+
+/* remembers choice for the key and appends it to the cache file */
+int
+autotune_store(const char *backend, int width, int threads, int ranks,
+        const autotune_choice_t *choice);
+
+int
+matMulSquare_auto_omp(const double *M_1, const double *M_2, double *P,
+        uint32_t width);
+
+int
+matMulSquare_auto_mpi(const double *M_1, double *M_2, double *P,
+        int width, int proc_rank, int num_procs);
+
+#endif
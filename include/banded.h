@@ -0,0 +1,90 @@
+#ifndef _BANDED_H
+#define _BANDED_H
+
+/* Banded and tridiagonal systems.
+ *
+ * A band matrix with `lower` subdiagonals and `upper` superdiagonals
+ * is packed row by row, lower + upper + 1 entries per row, element
+ * (row, col) at data[row * ld + col - row + lower]. The slots that
+ * fall outside the matrix in the first and last rows are zero. LU
+ * without pivoting, as in the dense kernels, creates no fill outside
+ * the band, so it factorises in place in O(width lower upper) time
+ * and O(width (lower + upper)) memory.
+ *
+ * The tridiagonal solvers take the subdiagonal a, diagonal b and
+ * superdiagonal c as arrays of length n each, a[0] and c[n-1] unused:
+ * Thomas' algorithm sequentially, cyclic reduction in log2(n) levels
+ * whose equations are independent and split between the threads, and
+ * the partition method over MPI: every process solves its block of
+ * rows for the right hand side and the two spikes that couple it to
+ * its neighbours, process 0 solves the 2 num_procs unknowns at the
+ * block ends as a band system and each process recovers its block
+ * from them. */
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t width;
+    uint32_t lower;
+    uint32_t upper;
+    double *data;
+} band_matrix_t;
+
+#define BAND_LD(B) ((B)->lower + (B)->upper + 1)
+
+static inline double *
+band_at(const band_matrix_t *B, uint32_t row, uint32_t col)
+{
+    return B->data + (size_t) row * BAND_LD(B) + col - row + B->lower;
+}
+
+/* the number of nonzero sub- and superdiagonals of M */
+int
+band_detect(const double *M, uint32_t width, uint32_t *lower, uint32_t *upper);
+
+int
+band_alloc(band_matrix_t *B, uint32_t width, uint32_t lower, uint32_t upper);
+
+void
+band_free(band_matrix_t *B);
+
+/* packs the band of M, the entries outside it are dropped */
+int
+band_from_dense(band_matrix_t *B, const double *M);
+
+int
+band_to_dense(const band_matrix_t *B, double *M);
+
+/* as lu_factor_inplace_omp */
+int
+band_lu_factor_omp(band_matrix_t *B);
+
+/* solves LU X = X for the width x nrhs row-major block X in place */
+int
+band_lu_solve(const band_matrix_t *LU, double *X, uint32_t nrhs);
+
+/* as gaussian_elimination_naive_inplace_omp, through the band
+ * storage when M is banded. A band wider than width /
+ * BAND_DENSE_FRACTION is not worth packing, M is eliminated dense */
+#define BAND_DENSE_FRACTION 4
+
+int
+gaussian_elimination_banded_omp(double *M, uint32_t width);
+
+/* solve for the n x nrhs row-major block D in place, a, b, c are not
+ * changed */
+int
+tridiag_solve_thomas(const double *a, const double *b, const double *c,
+        double *D, uint32_t n, uint32_t nrhs);
+
+int
+tridiag_solve_cr_omp(const double *a, const double *b, const double *c,
+        double *d, uint32_t n);
+
+/* a, b, c and d are only read from and written to on process 0, the
+ * rows are split as in the dense kernels and n >= 2 num_procs */
+int
+tridiag_solve_mpi(const double *a, const double *b, const double *c,
+        double *d, int n, int proc_rank, int num_procs);
+
+#endif
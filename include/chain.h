@@ -0,0 +1,71 @@
+#ifndef _CHAIN_H
+#define _CHAIN_H
+
+/* Products of chains of matrices of differing shapes.
+ *
+ * chain_plan picks the parenthesisation by dynamic programming over
+ * the subchains. The cost of a subchain is its flops plus byte_weight
+ * flops for every byte of workspace it is estimated to need. That
+ * estimate assumes the intermediates are stacked, the results of both
+ * halves live at once and the scratch of the half computed first
+ * overlapping the slot of the other. With byte_weight 0 the flops
+ * alone decide, and the footprint only breaks ties.
+ *
+ * The intermediates are then laid out in one workspace by replaying
+ * the evaluation order and placing each result at the lowest offset
+ * that is free. A result is freed as soon as the product that reads it
+ * is done, so the steps take turns in the same buffers, e.g. the two
+ * halves of a ping-pong along a left-deep chain. The workspace comes
+ * from mat_scratch and is kept between calls.
+ *
+ * Two halves that both cost at least CHAIN_TASK_FLOPS are independent
+ * and evaluated concurrently: as OpenMP tasks in matmul_chain_omp,
+ * and on two subcommunicators sized by the flops of each half in
+ * matmul_chain_mpi. Their intermediates never share workspace. Every
+ * product splits its rows between the threads (as tasks of a
+ * taskloop) or the processes of its communicator. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define CHAIN_TASK_FLOPS (1u << 22)
+
+typedef struct {
+    uint32_t count;         // matrices in the chain
+    uint32_t *dims;         // count + 1, matrix i is dims[i] x dims[i+1]
+    // count x count, entry i*count + j for the subchain i..j
+    uint32_t *split;        // it is (i..split)(split+1..j)
+    double *flops;          // flops of the subchain
+    uint8_t *concurrent;    // its halves are evaluated concurrently
+    size_t *offset;         // where its result is in the workspace
+    size_t workspace;       // doubles of the intermediates
+} chain_plan_t;
+
+/* plans the product of the count matrices of dims */
+int
+chain_plan(chain_plan_t *plan, const uint32_t *dims, uint32_t count,
+        double byte_weight);
+
+/* plans ((M_0 M_1) M_2) ... in the order written, the baseline */
+int
+chain_plan_left(chain_plan_t *plan, const uint32_t *dims, uint32_t count);
+
+void
+chain_plan_free(chain_plan_t *plan);
+
+/* C = A B for the row-major m x k A, k x n B and m x n C */
+int
+matmul_rect_omp(const double *A, const double *B, double *C,
+        uint32_t m, uint32_t k, uint32_t n);
+
+/* P = M[0] M[1] ... M[count-1] as planned */
+int
+matmul_chain_omp(const chain_plan_t *plan, const double *const *M, double *P);
+
+/* the same with the matrices on process 0, P is written there. The
+ * plan has to be the same on every process */
+int
+matmul_chain_mpi(const chain_plan_t *plan, const double *const *M, double *P,
+        int proc_rank, int num_procs);
+
+#endif
@@ -0,0 +1,184 @@
+#ifndef _FIXED_KERNELS_H
+#define _FIXED_KERNELS_H
+/* Header only
+ *
+ * Matmul and elimination kernels specialised at compile time for
+ * small fixed widths. With the width a constant every loop has a
+ * known trip count, the innermost loops are fully unrolled (and
+ * vectorised) and a row of the product is accumulated in registers.
+ * Forcing the outer loops to unroll as well blows up compile times
+ * for the wider kernels. No argument checks, no debug output and no
+ * OpenMP, these are meant to be called on many small matrices and
+ * from the generic entry points when the width matches. The serial
+ * kernels at the end add the loops for the other widths. */
+
+#include <stdint.h>
+
+// widths that get a specialised kernel
+#define FIXED_WIDTHS(X) X(4) X(8) X(16) X(32)
+
+#define FIXED_UNROLL _Pragma("GCC unroll 32")
+
+// P = M_1 M_2
+#define DEFINE_MATMUL_FIXED(W) \
+static inline void \
+matmul_fixed_##W(const double *restrict M_1, const double *restrict M_2, \
+        double *restrict P) \
+{ \
+    for (int row = 0; row < W; row++) \
+    { \
+        double acc[W] = {0}; \
+        for (int i = 0; i < W; i++) \
+        { \
+            const double a = M_1[row*W + i]; \
+            FIXED_UNROLL \
+            for (int col = 0; col < W; col++) \
+                acc[col] += a * M_2[i*W + col]; \
+        } \
+        FIXED_UNROLL \
+        for (int col = 0; col < W; col++) \
+            P[row*W + col] = acc[col]; \
+    } \
+}
+
+// P = M_1 M_2^T
+#define DEFINE_MATMUL_NT_FIXED(W) \
+static inline void \
+matmul_nt_fixed_##W(const double *restrict M_1, const double *restrict M_2, \
+        double *restrict P) \
+{ \
+    for (int row = 0; row < W; row++) \
+    { \
+        for (int col = 0; col < W; col++) \
+        { \
+            double sum = 0.0; \
+            FIXED_UNROLL \
+            for (int i = 0; i < W; i++) \
+                sum += M_1[row*W + i] * M_2[col*W + i]; \
+            P[row*W + col] = sum; \
+        } \
+    } \
+}
+
+/* in place elimination without pivoting, the multipliers are kept
+ * below the diagonal if keep_multipliers is set and zeroed otherwise.
+ * Zero pivots are only reported at the end (the matrix is garbage
+ * then), so the sweep itself has no early exits */
+#define DEFINE_ELIMINATE_FIXED(W) \
+static inline int \
+eliminate_fixed_##W(double *restrict M, int keep_multipliers) \
+{ \
+    int singular = 0; \
+    for (int iter = 0; iter < W - 1; iter++) \
+    { \
+        const double pivot = M[iter*W + iter]; \
+        singular |= (pivot == 0.0); \
+        const double inv_pivot = 1.0 / pivot; \
+        for (int row = iter + 1; row < W; row++) \
+        { \
+            const double factor = M[row*W + iter] * inv_pivot; \
+            FIXED_UNROLL \
+            for (int col = iter + 1; col < W; col++) \
+                M[row*W + col] -= factor * M[iter*W + col]; \
+            M[row*W + iter] = keep_multipliers ? factor : 0.0; \
+        } \
+    } \
+    return singular ? -1 : 0; \
+}
+
+#define DEFINE_FIXED_KERNELS(W) \
+    DEFINE_MATMUL_FIXED(W) \
+    DEFINE_MATMUL_NT_FIXED(W) \
+    DEFINE_ELIMINATE_FIXED(W)
+
+FIXED_WIDTHS(DEFINE_FIXED_KERNELS)
+
+
+/* dispatchers, these return 1 if width has a specialised kernel
+ * (which has then been run) and 0 otherwise */
+
+static inline int
+matmul_fixed(const double *M_1, const double *M_2, double *P, uint32_t width)
+{
+    switch (width)
+    {
+#       define FIXED_CASE(W) case W: matmul_fixed_##W(M_1, M_2, P); return 1;
+        FIXED_WIDTHS(FIXED_CASE)
+#       undef FIXED_CASE
+    }
+    return 0;
+}
+
+static inline int
+matmul_nt_fixed(const double *M_1, const double *M_2, double *P, uint32_t width)
+{
+    switch (width)
+    {
+#       define FIXED_CASE(W) case W: matmul_nt_fixed_##W(M_1, M_2, P); return 1;
+        FIXED_WIDTHS(FIXED_CASE)
+#       undef FIXED_CASE
+    }
+    return 0;
+}
+
+/* *err is set to the kernel's return value when width is handled */
+static inline int
+eliminate_fixed(double *M, uint32_t width, int keep_multipliers, int *err)
+{
+    switch (width)
+    {
+#       define FIXED_CASE(W) case W: *err = eliminate_fixed_##W(M, keep_multipliers); return 1;
+        FIXED_WIDTHS(FIXED_CASE)
+#       undef FIXED_CASE
+    }
+    return 0;
+}
+
+/* any width on one thread, through the specialised kernels when there
+ * is one. The batched kernels run these on every matrix. A zero pivot
+ * makes eliminate_serial return -1 */
+static inline void
+matmul_serial(const double *M_1, const double *M_2, double *P, uint32_t width)
+{
+    if (matmul_fixed(M_1, M_2, P, width))
+        return;
+    for (uint32_t row = 0; row < width; row++)
+    {
+        for (uint32_t col = 0; col < width; col++)
+            P[row*width + col] = 0.0l;
+        for (uint32_t i = 0; i < width; i++)
+        {
+            const double a = M_1[row*width + i];
+            for (uint32_t col = 0; col < width; col++)
+            {
+                P[row*width + col] += a * M_2[i*width + col];
+            }
+        }
+    }
+}
+
+static inline int
+eliminate_serial(double *M, uint32_t width)
+{
+    int err;
+    if (eliminate_fixed(M, width, 0, &err))
+        return err;
+    for (uint32_t iter = 0; iter + 1 < width; iter++)
+    {
+        const double pivot = M[iter*width + iter];
+        if (pivot == 0)
+            return -1;
+        for (uint32_t row = iter + 1; row < width; row++)
+        {
+            const double factor = M[row*width + iter] / pivot;
+            for (uint32_t col = iter + 1; col < width; col++)
+            {
+                M[row*width + col] -= factor * M[iter*width + col];
+            }
+            M[row*width + iter] = 0.0l;
+        }
+    }
+    return 0;
+}
+
+#endif
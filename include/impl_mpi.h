@@ -6,7 +6,12 @@
     double *P, int width,\
     int proc_rank, int num_procs
 
+#define ARGUMENT_SIGNATURE_MPI_F const float *M_1, float *M_2,\
+    float *P, int width,\
+    int proc_rank, int num_procs
+
 typedef int (*impl_mpi_t)(ARGUMENT_SIGNATURE_MPI);
+typedef int (*impl_mpi_f_t)(ARGUMENT_SIGNATURE_MPI_F);
 
 
 int
@@ -21,10 +26,72 @@ matMulSquare_pretranspose_mpi(ARGUMENT_SIGNATURE_MPI);
 int
 matMulSquare_balanced_mpi(ARGUMENT_SIGNATURE_MPI);
 
+/* P = M_1 M_2 in less memory. Process 0 scatters and gathers its own
+ * rows in place (MPI_IN_PLACE) and needs no buffers. With panel 0 or
+ * at least width the others receive all of M_2 and overwrite their
+ * rows of M_1 with the product one row at a time through a row
+ * temporary, without a separate result buffer. Otherwise they receive
+ * panel columns of M_2 at a time and send back those columns of their
+ * rows of P: their rows of M_1, width x panel of M_2 and rows x panel
+ * of P instead of all of M_2 and two row blocks */
+int
+matMulSquare_lowmem_mpi(ARGUMENT_SIGNATURE_MPI, int panel);
+
+// panel columns of the low memory kernel in the drivers
+#define LOWMEM_PANEL 256
+
 int
 gaussian_elimination_naive_inplace_mpi(double *M, int width,
         int proc_rank, int num_procs);
 
+/* LU factorisation without pivoting, L (unit diagonal) is stored
+ * below the diagonal of M and U on and above it */
+int
+lu_factor_inplace_mpi(double *M, int width,
+        int proc_rank, int num_procs);
+
+/* solves LU X = B for the width x nrhs row-major block B in place,
+ * LU and B are only read from/written to on process 0 */
+int
+lu_solve_mpi(double *LU, double *B, int width, int nrhs,
+        int proc_rank, int num_procs);
+
+/* factorises M in place and solves M X = B, overwriting B with X */
+int
+solve_mpi(double *M, double *B, int width, int nrhs,
+        int proc_rank, int num_procs);
+
+/* batched kernels for many small matrices, matrix b of a batch
+ * starts at b*width*width, see src/batch_mpi.c */
+int
+matMulBatched_mpi(const double *M_1, const double *M_2, double *P,
+        int width, int batch_count, int proc_rank, int num_procs);
+
+int
+gaussian_elimination_batched_mpi(double *M, int width, int batch_count,
+        int proc_rank, int num_procs);
+
+/* single precision variants */
+int
+matMulSquare_balanced_mpi_f(ARGUMENT_SIGNATURE_MPI_F);
+
+int
+gaussian_elimination_naive_inplace_mpi_f(float *M, int width,
+        int proc_rank, int num_procs);
+
+int
+lu_factor_inplace_mpi_f(float *M, int width,
+        int proc_rank, int num_procs);
+
+/* solves M X = B by factorising M in single precision and refining
+ * X with double precision residuals, falling back to solve_mpi if
+ * the refinement does not converge. M is left untouched. If iter is
+ * not NULL it is set to the number of refinement steps taken, or to
+ * a negative value if the fallback was used */
+int
+solve_mixed_mpi(double *M, double *B, int width, int nrhs,
+        int proc_rank, int num_procs, int *iter);
+
 /*
 int
 gaussian_elimination_naive(double *M, int width,
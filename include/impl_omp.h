@@ -1,12 +1,15 @@
 #ifndef _MY_OMP_IMPL_H
 #define _MY_OMP_IMPL_H
 
+#include <stddef.h>
 #include <stdint.h>
 
 #define ARGUMENT_SIGNATURE_OMP const double *M_1, const double *M_2, double *P, uint32_t width
+#define ARGUMENT_SIGNATURE_OMP_F const float *M_1, const float *M_2, float *P, uint32_t width
 
 
 typedef int (*impl_omp_t)(ARGUMENT_SIGNATURE_OMP);
+typedef int (*impl_omp_f_t)(ARGUMENT_SIGNATURE_OMP_F);
 
 
 int
@@ -18,6 +21,127 @@ matMulSquare_transpose_omp(ARGUMENT_SIGNATURE_OMP);
 int
 matMulSquare_pretranspose_omp(ARGUMENT_SIGNATURE_OMP);
 
+/* cache blocked P = M_1 M_2, tile x tile blocks of M_2 are reused
+ * across a row of M_1 while they are in cache */
+int
+matMulSquare_tiled_omp(ARGUMENT_SIGNATURE_OMP, uint32_t tile);
+
 int gaussian_elimination_naive_inplace_omp(double *M, uint32_t width);
 
+/* the same elimination in a single parallel region: rows are dealt to
+ * the threads cyclically and stay with them, and instead of a barrier
+ * per pivot each thread publishes the steps it has finished and waits
+ * only for the owner of the next pivot row to be done with it */
+int
+gaussian_elimination_persistent_omp(double *M, uint32_t width);
+
+/* LU factorisation without pivoting, L (unit diagonal) is stored
+ * below the diagonal of M and U on and above it */
+int
+lu_factor_inplace_omp(double *M, uint32_t width);
+
+/* solves LU X = B for the width x nrhs row-major block B in place */
+int
+lu_solve_omp(const double *LU, double *B, uint32_t width, uint32_t nrhs);
+
+/* factorises M in place and solves M X = B, overwriting B with X */
+int
+solve_omp(double *M, double *B, uint32_t width, uint32_t nrhs);
+
+
+/* P = M M^T, only the lower triangle of P is computed and written */
+int
+syrk_lower_omp(const double *M, double *P, uint32_t width);
+
+/* Cholesky factorisation of a symmetric positive definite M, the
+ * lower triangle of M is read and overwritten with L */
+int
+cholesky_inplace_omp(double *M, uint32_t width);
+
+/* batched kernels for many small matrices, parallel across the
+ * batch, see src/batch_omp.c. The _strided variants take matrix b at
+ * offset b*stride, the plain ones an array of pointers */
+int
+matMulBatched_strided_omp(const double *M_1, const double *M_2, double *P,
+        uint32_t width, size_t stride, size_t batch_count);
+
+int
+matMulBatched_omp(const double *const *M_1, const double *const *M_2,
+        double *const *P, uint32_t width, size_t batch_count);
+
+int
+gaussian_elimination_batched_strided_omp(double *M, uint32_t width,
+        size_t stride, size_t batch_count);
+
+int
+gaussian_elimination_batched_omp(double *const *M, uint32_t width,
+        size_t batch_count);
+
+/* conversion between contiguous batches and the interleaved layout,
+ * where element (row, col) of matrix b is at (row*width + col)*batch_count + b */
+int
+batch_interleave(const double *A, double *A_il, uint32_t width, size_t batch_count);
+
+int
+batch_deinterleave(const double *A_il, double *A, uint32_t width, size_t batch_count);
+
+int
+matMulBatched_interleaved_omp(const double *M_1, const double *M_2, double *P,
+        uint32_t width, size_t batch_count);
+
+int
+gaussian_elimination_batched_interleaved_omp(double *M, uint32_t width,
+        size_t batch_count);
+
+/* single precision variants */
+int
+matMulSquare_baseline_omp_f(ARGUMENT_SIGNATURE_OMP_F);
+
+int
+matMulSquare_transpose_omp_f(ARGUMENT_SIGNATURE_OMP_F);
+
+int
+matMulSquare_pretranspose_omp_f(ARGUMENT_SIGNATURE_OMP_F);
+
+int
+gaussian_elimination_naive_inplace_omp_f(float *M, uint32_t width);
+
+int
+lu_factor_inplace_omp_f(float *M, uint32_t width);
+
+int
+lu_solve_omp_f(const float *LU, float *B, uint32_t width, uint32_t nrhs);
+
+/* solves M X = B by factorising M in single precision and refining
+ * X with double precision residuals, falling back to solve_omp if
+ * the refinement does not converge. M is left untouched. If iter is
+ * not NULL it is set to the number of refinement steps taken, or to
+ * a negative value if the fallback was used */
+int
+solve_mixed_omp(const double *M, double *B, uint32_t width, uint32_t nrhs,
+        int *iter);
+
+/* NUMA placement. Pages of a matrix belong to the node of the thread
+ * that first writes them, so matrices are allocated page aligned and
+ * their rows are zeroed in parallel with the same static row schedule
+ * (and so by the same threads) as the kernels, before anything is read
+ * into them. NUMA_INTERLEAVE spreads the pages round robin over all
+ * nodes instead, for data every thread reads in full. NUMA_NONE is a
+ * plain malloc. Free the result with free() */
+enum {NUMA_NONE, NUMA_FIRST_TOUCH, NUMA_INTERLEAVE};
+
+double *
+numa_alloc_matrix_omp(uint32_t width, int policy);
+
+/* number of online NUMA nodes, 1 if unknown */
+int
+numa_num_nodes(void);
+
+/* warns if the OpenMP threads are not bound to places while there
+ * is more than one node (set OMP_PLACES and OMP_PROC_BIND, e.g.
+ * OMP_PLACES=cores OMP_PROC_BIND=spread) and logs the places in
+ * debug builds. Returns 1 if the threads are bound */
+int
+numa_check_binding_omp(void);
+
 #endif
@@ -0,0 +1,74 @@
+#ifndef _MATALLOC_H
+#define _MATALLOC_H
+
+/* Matrix buffer allocation.
+ *
+ * mat_alloc returns MAT_ALIGN (cache line, and widest SIMD register)
+ * aligned memory that has to be released with mat_free. With the
+ * MATALLOC_HUGEPAGES environment variable set to "thp" (or "1"),
+ * allocations of at least MAT_HUGE_PAGE bytes are placed in 2 MB
+ * aligned regions advised for transparent huge pages; "explicit" maps
+ * them from the hugetlbfs pool (MAP_HUGETLB, see
+ * /proc/sys/vm/nr_hugepages) and falls back to "thp" if the pool is
+ * empty.
+ *
+ * mat_scratch hands out per thread scratch buffers (and so per rank
+ * in the MPI kernels) that live until mat_scratch_release, so kernels
+ * called over and over allocate only on their first call or when the
+ * size grows. A slot of at least MAT_HUGE_PAGE bytes is reallocated
+ * when less than 1 / MAT_SCRATCH_SHRINK of it is asked for, so a
+ * small request after a large one does not pin the high-water size.
+ * The drivers release the buffers before they exit. The contents are
+ * undefined on return, and a buffer stays valid until the same thread
+ * asks for the same slot again, so every slot must be used by one
+ * kernel at a time only. */
+
+#include <stddef.h>
+
+#define MAT_ALIGN 64
+#define MAT_HUGE_PAGE (2u << 20)
+#define MAT_SCRATCH_SHRINK 4
+
+// the scratch buffers of the kernels
+enum {
+    SCRATCH_TRANSPOSE,  // transposed operand
+    SCRATCH_OPERAND,    // broadcast operand on the non-root ranks
+    SCRATCH_RECV,       // local rows of the scattered operand
+    SCRATCH_SEND,       // local rows of the result
+    SCRATCH_PIVOT,      // pivot row of the distributed elimination
+    SCRATCH_COUNTS,     // send counts and displacements of Scatterv/Gatherv
+    SCRATCH_ALLTOALL,   // packed send blocks of the distributed transpose
+    SCRATCH_CHAIN,      // intermediates of a matrix chain product
+    NUM_SCRATCH_SLOTS
+};
+
+void *
+mat_alloc(size_t bytes);
+
+void
+mat_free(void *ptr);
+
+void *
+mat_scratch(int slot, size_t bytes);
+
+/* frees all scratch buffers of the calling thread, for the drivers
+ * before they exit */
+void
+mat_scratch_release(void);
+
+/* the bytes of every slot of the calling thread, for mat_scratch_trim */
+void
+mat_scratch_sizes(size_t held[NUM_SCRATCH_SLOTS]);
+
+/* frees the slots of the calling thread that have grown past held
+ * since. Their buffers were reallocated in between, so no caller can
+ * still hold them, and the buffers of the other slots stay valid */
+void
+mat_scratch_trim(const size_t held[NUM_SCRATCH_SLOTS]);
+
+/* advises a page aligned region for transparent huge pages if they
+ * have been asked for, for memory not coming from mat_alloc */
+void
+mat_advise_hugepages(void *addr, size_t bytes);
+
+#endif
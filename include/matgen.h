@@ -0,0 +1,79 @@
+#ifndef _MATGEN_H
+#define _MATGEN_H
+
+/* Deterministic parallel generation of test matrices.
+ *
+ * Every entry comes from a counter-based generator (Philox4x32-10,
+ * keyed by the seed, the counter being the column pair, the row, the
+ * matrix id and a stream number), so any row can be produced on its
+ * own: the threads split the rows however they like and the matrix is
+ * the same bit for bit for a seed and id on any number of threads.
+ *
+ * MATGEN_UNIFORM draws the entries uniformly from [low, high), like
+ * test/generate_matrices.py, with no control of the conditioning.
+ *
+ * MATGEN_DOMINANT draws the off-diagonal entries from [low, high) and
+ * sets each diagonal entry to (1 + delta) times the sum of the absolute
+ * values of the rest of its row, with delta = 2 / (cond - 1). The
+ * matrix is then strictly diagonally dominant, needs no pivoting, and
+ * its infinity norm condition number is at most cond times the ratio of
+ * the largest to the smallest row sum (close to 1 for wide matrices).
+ *
+ * MATGEN_SPECTRUM builds H_1 S H_2 with the Householder reflections
+ * H_i = I - 2 v_i v_i^T of random unit vectors and S the diagonal of
+ * singular values from 1 down to 1 / cond in geometric steps, so the 2
+ * norm condition number is exactly cond. Each entry is an O(1) formula
+ * in v_1, v_2 and S. These matrices may need pivoting, which the
+ * kernels here do not do. low and high are unused. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+typedef enum {
+    MATGEN_UNIFORM,
+    MATGEN_DOMINANT,
+    MATGEN_SPECTRUM
+} matgen_kind_t;
+
+typedef struct {
+    matgen_kind_t kind;
+    uint32_t width;
+    uint64_t seed;
+    uint32_t id;        // which matrix of the seed, M_1 and M_2 differ by it
+    double cond;
+    double low;
+    double high;
+    double *v1;         // MATGEN_SPECTRUM: the reflections, the singular
+    double *v2;         // values and v_1^T S v_2
+    double *sigma;
+    double v1_s_v2;
+} matgen_t;
+
+/* sets up G, cond > 1 for MATGEN_DOMINANT and >= 1 for MATGEN_SPECTRUM */
+int
+matgen_init(matgen_t *G, matgen_kind_t kind, uint32_t width, uint64_t seed,
+        uint32_t id, double cond, double low, double high);
+
+void
+matgen_free(matgen_t *G);
+
+/* count rows from row on into the row-major buf, on the calling thread */
+void
+matgen_rows(const matgen_t *G, double *buf, uint32_t row, uint32_t count);
+
+/* the whole matrix into M, rows split between the threads */
+int
+matgen_fill_omp(const matgen_t *G, double *M);
+
+/* the matrix as a binary matrix file (see include/ooc.h), each thread
+ * generating and writing its own panels of rows in about memory bytes */
+int
+matgen_write_omp(const matgen_t *G, const char *path, size_t memory);
+
+/* the matrix as text rows in the format of read_matrix, the rows
+ * formatted in parallel and written in order */
+int
+matgen_write_text_omp(const matgen_t *G, FILE *file);
+
+#endif
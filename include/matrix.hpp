@@ -0,0 +1,484 @@
+#ifndef _MATRIX_HPP
+#define _MATRIX_HPP
+
+/* Header only C++ layer over the OpenMP kernels.
+ *
+ * hpsc::Matrix owns a width x width row-major buffer from mat_alloc
+ * and frees it on destruction. It can be moved but not copied (clone()
+ * copies explicitly). MatrixView is a non-owning, possibly strided,
+ * rows x cols window into a matrix (a block, a row, a column) that can
+ * be read from and assigned to without copying.
+ *
+ * Arithmetic builds expression templates and nothing is computed until
+ * an expression is assigned to a matrix or view:
+ *
+ *     Matrix P = A * B;                // one matmul kernel call into P
+ *     Matrix D = A * B + C - 2.0 * E;  // the matmul into D, then one
+ *                                      // pass adding C - 2 E in place
+ *     Matrix U = (A * B).eliminate();  // the product is eliminated in
+ *                                      // place, no other n^2 buffer
+ *     A.view(0, 0, 8, 8) = B.view(8, 8, 8, 8) + C.view(0, 8, 8, 8);
+ *
+ * The elementwise part of an expression is evaluated in a single
+ * parallel pass over the destination. One product per expression is
+ * computed straight into the destination, when the destination is not
+ * an operand of the expression; other products (and products of
+ * expressions or views, since the kernels take whole square matrices)
+ * are computed into temporaries. Expressions hold references to their
+ * matrices, so they should be evaluated within the statement that
+ * builds them rather than kept with auto.
+ *
+ * Errors of the kernels, allocation failures and mismatched sizes
+ * throw std::runtime_error. The kernels can be swapped through
+ * hpsc::matmul_kernel and hpsc::eliminate_kernel. */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+extern "C" {
+#include "impl_omp.h"
+#include "matalloc.h"
+}
+
+namespace hpsc {
+
+typedef int (*eliminate_omp_t)(double *M, uint32_t width);
+
+inline impl_omp_t matmul_kernel = matMulSquare_transpose_omp;
+inline eliminate_omp_t eliminate_kernel = gaussian_elimination_persistent_omp;
+
+class Matrix;
+class MatrixView;
+
+inline void
+kernel_check(int err, const char *what)
+{
+    if (err)
+        throw std::runtime_error(std::string(what) + " failed");
+}
+
+
+// base of every expression, D being the node type
+template <class D>
+struct Expr
+{
+    const D &self() const { return static_cast<const D &>(*this); }
+
+    // evaluates into a new matrix and eliminates that in place
+    Matrix eliminate() const;
+    Matrix lu_factor() const;
+};
+
+
+// nodes are kept by value in their parents, matrices by reference
+template <class T>
+struct stored { typedef T type; };
+
+template <>
+struct stored<Matrix> { typedef const Matrix &type; };
+
+
+/* The node interface: rows(), cols(), at(row, col), overlaps(begin,
+ * end) for aliasing, and prepare(dest), which computes the products
+ * below the node, the first of them into *dest if that is not NULL
+ * (then setting it to NULL). */
+
+template <class L, class R, class Op>
+class Elementwise : public Expr<Elementwise<L, R, Op>>
+{
+public:
+    Elementwise(const L &l, const R &r) : l_(l), r_(r)
+    {
+        if (l.rows() != r.rows() || l.cols() != r.cols())
+            throw std::runtime_error("Elementwise operands differ in size");
+    }
+    uint32_t rows() const { return l_.rows(); }
+    uint32_t cols() const { return l_.cols(); }
+    double at(size_t row, size_t col) const { return Op::apply(l_.at(row, col), r_.at(row, col)); }
+    bool overlaps(const double *begin, const double *end) const
+    {
+        return l_.overlaps(begin, end) || r_.overlaps(begin, end);
+    }
+    void prepare(double **dest) const { l_.prepare(dest); r_.prepare(dest); }
+
+private:
+    typename stored<L>::type l_;
+    typename stored<R>::type r_;
+};
+
+struct Add { static double apply(double a, double b) { return a + b; } };
+struct Subtract { static double apply(double a, double b) { return a - b; } };
+
+
+template <class E>
+class Scaled : public Expr<Scaled<E>>
+{
+public:
+    Scaled(double alpha, const E &e) : alpha_(alpha), e_(e) {}
+    uint32_t rows() const { return e_.rows(); }
+    uint32_t cols() const { return e_.cols(); }
+    double at(size_t row, size_t col) const { return alpha_ * e_.at(row, col); }
+    bool overlaps(const double *begin, const double *end) const { return e_.overlaps(begin, end); }
+    void prepare(double **dest) const { e_.prepare(dest); }
+
+private:
+    double alpha_;
+    typename stored<E>::type e_;
+};
+
+
+template <class L, class R>
+class Product : public Expr<Product<L, R>>
+{
+public:
+    Product(const L &l, const R &r);
+    uint32_t rows() const { return l_.rows(); }
+    uint32_t cols() const { return l_.rows(); }
+    double at(size_t row, size_t col) const { return result_[row * l_.rows() + col]; }
+    bool overlaps(const double *begin, const double *end) const
+    {
+        return l_.overlaps(begin, end) || r_.overlaps(begin, end);
+    }
+    void prepare(double **dest) const;
+
+private:
+    typename stored<L>::type l_;
+    typename stored<R>::type r_;
+    // set by prepare, the destination or temp_
+    mutable const double *result_ = nullptr;
+    mutable std::shared_ptr<Matrix> temp_;
+};
+
+
+class MatrixView : public Expr<MatrixView>
+{
+public:
+    MatrixView(double *data, uint32_t rows, uint32_t cols, size_t stride)
+        : data_(data), rows_(rows), cols_(cols), stride_(stride) {}
+
+    uint32_t rows() const { return rows_; }
+    uint32_t cols() const { return cols_; }
+    size_t stride() const { return stride_; }
+    double *data() const { return data_; }
+    double &operator()(size_t row, size_t col) const { return data_[row * stride_ + col]; }
+    double at(size_t row, size_t col) const { return data_[row * stride_ + col]; }
+    bool overlaps(const double *begin, const double *end) const
+    {
+        return rows_ > 0 && data_ < end && data_ + (rows_ - 1) * stride_ + cols_ > begin;
+    }
+    void prepare(double **) const {}
+
+    MatrixView view(uint32_t row, uint32_t col, uint32_t rows, uint32_t cols) const
+    {
+        if (row + rows > rows_ || col + cols > cols_)
+            throw std::runtime_error("View out of range");
+        return MatrixView(data_ + row * stride_ + col, rows, cols, stride_);
+    }
+
+    template <class E>
+    const MatrixView &operator=(const Expr<E> &e) const;
+    const MatrixView &operator=(const MatrixView &v) const
+    {
+        return *this = static_cast<const Expr<MatrixView> &>(v);
+    }
+    MatrixView(const MatrixView &) = default;
+
+private:
+    double *data_;
+    uint32_t rows_, cols_;
+    size_t stride_;
+};
+
+
+class Matrix : public Expr<Matrix>
+{
+public:
+    Matrix() = default;
+
+    // uninitialised, the pages are touched by the first kernel
+    explicit Matrix(uint32_t width)
+        : width_(width), data_(static_cast<double *>(mat_alloc(bytes(width))))
+    {
+        if (!data_)
+            throw std::runtime_error("Out of memory");
+    }
+
+    template <class E>
+    Matrix(const Expr<E> &e) : Matrix()
+    {
+        assign(e.self());
+    }
+
+    Matrix(Matrix &&other) noexcept
+        : width_(std::exchange(other.width_, 0)), data_(std::exchange(other.data_, nullptr)) {}
+
+    Matrix &operator=(Matrix &&other) noexcept
+    {
+        std::swap(width_, other.width_);
+        std::swap(data_, other.data_);
+        return *this;
+    }
+
+    Matrix(const Matrix &) = delete;
+    Matrix &operator=(const Matrix &) = delete;
+
+    ~Matrix()
+    {
+        if (data_)
+            mat_free(data_);
+    }
+
+    template <class E>
+    Matrix &operator=(const Expr<E> &e)
+    {
+        assign(e.self());
+        return *this;
+    }
+
+    static Matrix zeros(uint32_t width)
+    {
+        Matrix M(width);
+        std::memset(M.data_, 0, bytes(width));
+        return M;
+    }
+
+    // width x width numbers in the driver text format
+    static Matrix read(FILE *file, uint32_t width)
+    {
+        Matrix M(width);
+        for (size_t i = 0; i < (size_t) width * width; i++)
+        {
+            if (std::fscanf(file, "%lf", M.data_ + i) != 1)
+                throw std::runtime_error("Could not read a matrix");
+        }
+        return M;
+    }
+
+    Matrix clone() const
+    {
+        Matrix M(width_);
+        std::memcpy(M.data_, data_, bytes(width_));
+        return M;
+    }
+
+    uint32_t width() const { return width_; }
+    uint32_t rows() const { return width_; }
+    uint32_t cols() const { return width_; }
+    double *data() { return data_; }
+    const double *data() const { return data_; }
+    double &operator()(size_t row, size_t col) { return data_[row * width_ + col]; }
+    double at(size_t row, size_t col) const { return data_[row * width_ + col]; }
+    bool overlaps(const double *begin, const double *end) const
+    {
+        return data_ && data_ < end && data_ + (size_t) width_ * width_ > begin;
+    }
+    void prepare(double **) const {}
+
+    MatrixView view(uint32_t row, uint32_t col, uint32_t rows, uint32_t cols)
+    {
+        return MatrixView(data_, width_, width_, width_).view(row, col, rows, cols);
+    }
+    MatrixView row(uint32_t row) { return view(row, 0, 1, width_); }
+    MatrixView col(uint32_t col) { return view(0, col, width_, 1); }
+
+    // in place on a named matrix, or on a temporary that is handed on
+    Matrix &eliminate() &
+    {
+        kernel_check(eliminate_kernel(data_, width_), "Elimination");
+        return *this;
+    }
+    Matrix eliminate() && { eliminate(); return std::move(*this); }
+    Matrix &lu_factor() &
+    {
+        kernel_check(lu_factor_inplace_omp(data_, width_), "LU factorisation");
+        return *this;
+    }
+    Matrix lu_factor() && { lu_factor(); return std::move(*this); }
+
+private:
+    static size_t bytes(uint32_t width) { return (size_t) width * width * sizeof(double); }
+
+    template <class E>
+    void assign(const E &e);
+
+    uint32_t width_ = 0;
+    double *data_ = nullptr;
+};
+
+
+// dest(row, col) = e.at(row, col) for all entries, in one parallel pass
+template <class E>
+inline void
+evaluate_into(const E &e, double *dest, size_t stride)
+{
+    const uint32_t rows = e.rows(), cols = e.cols();
+#   ifdef _OPENMP
+#   pragma omp parallel for schedule(static)
+#   endif
+    for (uint32_t row = 0; row < rows; row++)
+    {
+        for (uint32_t col = 0; col < cols; col++)
+            dest[row * stride + col] = e.at(row, col);
+    }
+}
+
+
+template <class T>
+struct is_product : std::false_type {};
+
+template <class L, class R>
+struct is_product<Product<L, R>> : std::true_type {};
+
+
+template <class E>
+void
+Matrix::assign(const E &e)
+{
+    if (e.rows() != e.cols())
+        throw std::runtime_error("Only square matrices");
+    if (e.overlaps(data_, data_ + (size_t) width_ * width_))
+    {
+        // the destination is read by the expression, evaluated aside
+        Matrix result(e);
+        *this = std::move(result);
+        return;
+    }
+    if (width_ != e.rows())
+        *this = Matrix(e.rows());
+    double *dest = data_;
+    e.prepare(&dest);
+    // a bare product is already in place
+    if (is_product<E>::value)
+        return;
+    evaluate_into(e, data_, width_);
+}
+
+
+template <class E>
+const MatrixView &
+MatrixView::operator=(const Expr<E> &expr) const
+{
+    const E &e = expr.self();
+    if (e.rows() != rows_ || e.cols() != cols_)
+        throw std::runtime_error("Assignment to a view of another size");
+    double *dest = nullptr;
+    e.prepare(&dest);
+    if (e.overlaps(data_, data_ + (rows_ - 1) * stride_ + cols_))
+    {
+        // a block moved onto itself, evaluated aside first
+        std::unique_ptr<double[]> aside(new double[(size_t) rows_ * cols_]);
+        evaluate_into(e, aside.get(), cols_);
+        evaluate_into(MatrixView(aside.get(), rows_, cols_, cols_), data_, stride_);
+        return *this;
+    }
+    evaluate_into(e, data_, stride_);
+    return *this;
+}
+
+
+// the square contiguous matrix of an operand: a matrix as it is,
+// anything else evaluated into a temporary
+inline const double *
+operand_data(const Matrix &M, std::shared_ptr<Matrix> &)
+{
+    return M.data();
+}
+
+template <class E>
+inline const double *
+operand_data(const E &e, std::shared_ptr<Matrix> &temp)
+{
+    temp = std::make_shared<Matrix>(e);
+    return temp->data();
+}
+
+
+template <class L, class R>
+Product<L, R>::Product(const L &l, const R &r) : l_(l), r_(r)
+{
+    if (l.rows() != l.cols() || r.rows() != r.cols() || l.rows() != r.rows())
+        throw std::runtime_error("Products need square operands of one width");
+}
+
+
+template <class L, class R>
+void
+Product<L, R>::prepare(double **dest) const
+{
+    std::shared_ptr<Matrix> left_temp, right_temp;
+    const double *left = operand_data(l_, left_temp);
+    const double *right = operand_data(r_, right_temp);
+    const uint32_t width = l_.rows();
+    double *out = *dest;
+    if (out)
+        *dest = nullptr;
+    else
+    {
+        temp_ = std::make_shared<Matrix>(width);
+        out = temp_->data();
+    }
+    kernel_check(matmul_kernel(left, right, out, width), "Matrix multiplication");
+    result_ = out;
+}
+
+
+template <class D>
+Matrix
+Expr<D>::eliminate() const
+{
+    return Matrix(self()).eliminate();
+}
+
+template <class D>
+Matrix
+Expr<D>::lu_factor() const
+{
+    return Matrix(self()).lu_factor();
+}
+
+
+template <class L, class R>
+inline Product<L, R>
+operator*(const Expr<L> &l, const Expr<R> &r)
+{
+    return Product<L, R>(l.self(), r.self());
+}
+
+template <class L, class R>
+inline Elementwise<L, R, Add>
+operator+(const Expr<L> &l, const Expr<R> &r)
+{
+    return Elementwise<L, R, Add>(l.self(), r.self());
+}
+
+template <class L, class R>
+inline Elementwise<L, R, Subtract>
+operator-(const Expr<L> &l, const Expr<R> &r)
+{
+    return Elementwise<L, R, Subtract>(l.self(), r.self());
+}
+
+template <class E>
+inline Scaled<E>
+operator*(double alpha, const Expr<E> &e)
+{
+    return Scaled<E>(alpha, e.self());
+}
+
+template <class E>
+inline Scaled<E>
+operator*(const Expr<E> &e, double alpha)
+{
+    return Scaled<E>(alpha, e.self());
+}
+
+} // namespace hpsc
+
+#endif
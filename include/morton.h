@@ -0,0 +1,64 @@
+#ifndef _MORTON_H
+#define _MORTON_H
+
+/* Tiled matrix storage in Morton (Z) order.
+ *
+ * The matrix is cut into MORTON_TILE x MORTON_TILE tiles, each stored
+ * contiguously and row-major and page aligned (8 KB, two pages, for
+ * doubles), and the tiles are laid out along the Z curve over the tile
+ * grid, so that tiles close in the grid are close in memory at every
+ * scale. The last tile row and column are padded with zeros up to a
+ * whole tile, grids that are not a power of two are packed without
+ * holes.
+ *
+ * The kernels work tile by tile: the matmul computes every tile of
+ * the product as one task, the elimination is the right looking tile
+ * LU (factor the diagonal tile, solve the tiles right of and below it,
+ * update the trailing tiles), without pivoting as the row-major
+ * kernels. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MORTON_TILE 32
+
+typedef struct {
+    uint32_t width;     // of the matrix
+    uint32_t tiles;     // per side of the tile grid
+    uint32_t *offset;   // tile row * tiles + tile col -> tile index in Z order
+    double *data;       // tiles * tiles tiles of MORTON_TILE^2 elements
+} morton_matrix_t;
+
+int
+morton_alloc(morton_matrix_t *T, uint32_t width);
+
+void
+morton_free(morton_matrix_t *T);
+
+static inline double *
+morton_tile(const morton_matrix_t *T, uint32_t tile_row, uint32_t tile_col)
+{
+    return T->data + (size_t) T->offset[tile_row * T->tiles + tile_col]
+        * MORTON_TILE * MORTON_TILE;
+}
+
+int
+morton_from_rowmajor_omp(morton_matrix_t *T, const double *M);
+
+int
+morton_to_rowmajor_omp(const morton_matrix_t *T, double *M);
+
+/* C = A B, all three of the same width */
+int
+matMulSquare_morton_omp(const morton_matrix_t *A, const morton_matrix_t *B,
+        morton_matrix_t *C);
+
+/* as lu_factor_inplace_omp, L below and U on and above the diagonal */
+int
+lu_factor_morton_omp(morton_matrix_t *T);
+
+/* as gaussian_elimination_naive_inplace_omp, zeros below the diagonal */
+int
+gaussian_elimination_morton_omp(morton_matrix_t *T);
+
+#endif
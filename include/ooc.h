@@ -0,0 +1,78 @@
+#ifndef _OOC_H
+#define _OOC_H
+
+/* Out-of-core kernels on binary matrix files.
+ *
+ * A matrix file is an ooc_header_t followed by the rows x cols doubles
+ * row-major in native byte order. The kernels keep only row panels of
+ * the operands in memory, as many rows as fit in the given budget, and
+ * stream the rest from the file in panels: while the threads work on
+ * one panel, one of them reads the next into the second buffer with
+ * pread, so disk and compute overlap once a panel takes longer to
+ * compute than to read.
+ *
+ * matMulSquare_ooc_omp holds a row panel of the left operand and of
+ * the product, and streams the right operand past it once per panel.
+ * gaussian_elimination_ooc_omp works in place on the file: each row
+ * panel in turn is loaded, has the eliminated rows above it streamed
+ * past it, is eliminated within itself and written back, which is the
+ * update order of the in-memory kernel. */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#define OOC_MAGIC "DMATRIX1"
+
+typedef struct {
+    char magic[8];
+    uint64_t rows;
+    uint64_t cols;
+    uint64_t reserved;
+} ooc_header_t;
+
+typedef struct {
+    int fd;
+    uint64_t rows;
+    uint64_t cols;
+} ooc_matrix_t;
+
+/* creates (or truncates) path for a rows x cols matrix */
+int
+ooc_create(ooc_matrix_t *F, const char *path, uint64_t rows, uint64_t cols);
+
+int
+ooc_open(ooc_matrix_t *F, const char *path, int writable);
+
+int
+ooc_close(ooc_matrix_t *F);
+
+/* count rows from row on, to or from the row-major buf */
+int
+ooc_read_rows(const ooc_matrix_t *F, double *buf, uint64_t row, uint64_t count);
+
+int
+ooc_write_rows(const ooc_matrix_t *F, const double *buf, uint64_t row, uint64_t count);
+
+/* whole width x width matrices */
+int
+ooc_write_matrix(const char *path, const double *M, uint32_t width);
+
+int
+ooc_read_matrix(const char *path, double *M, uint32_t width);
+
+/* reads a width x width matrix in the format of read_matrix from text
+ * and writes it to path, one row in memory at a time */
+int
+ooc_convert_text(FILE *text, const char *path, uint32_t width);
+
+/* product = left right, using about memory bytes */
+int
+matMulSquare_ooc_omp(const char *left, const char *right, const char *product,
+        size_t memory);
+
+/* as gaussian_elimination_naive_inplace_omp on the matrix in path */
+int
+gaussian_elimination_ooc_omp(const char *path, size_t memory);
+
+#endif
@@ -0,0 +1,43 @@
+#ifndef _PERF_COUNTERS_H
+#define _PERF_COUNTERS_H
+
+/* Hardware performance counters around kernel invocations.
+ *
+ * Built in with -DPERF_COUNTERS (`make omp PERF=1`), otherwise the
+ * macros below expand to nothing. When built in, counting is switched
+ * on at run time by the PERF_COUNTERS environment variable: "1" writes
+ * to stderr, anything else is taken as a file to append to, unset or
+ * "0" leaves the counters off.
+ *
+ * PERF_KERNEL_BEGIN()/PERF_KERNEL_END(name) go around a kernel call,
+ * outside of any parallel region. Every thread of the OpenMP team
+ * snapshots its own counters at both ends and one CSV line is written
+ * per invocation and thread:
+ *
+ *   kernel,invocation,rank,thread,cycles,instructions,l1d_misses,llc_misses,dtlb_misses
+ *
+ * Counters the machine does not provide are reported as -1. */
+
+#ifdef PERF_COUNTERS
+
+void
+perf_set_rank(int rank);
+
+void
+perf_kernel_begin(void);
+
+void
+perf_kernel_end(const char *name);
+
+#define PERF_SET_RANK(R) perf_set_rank(R)
+#define PERF_KERNEL_BEGIN() perf_kernel_begin()
+#define PERF_KERNEL_END(NAME) perf_kernel_end(NAME)
+
+#else
+
+#define PERF_SET_RANK(R)
+#define PERF_KERNEL_BEGIN()
+#define PERF_KERNEL_END(NAME)
+
+#endif
+#endif
@@ -0,0 +1,101 @@
+#ifndef _SPARSE_H
+#define _SPARSE_H
+
+/* Compressed sparse row matrices.
+ *
+ * Row r holds the entries row_ptr[r] to row_ptr[r+1]-1 of col_idx and
+ * val, with the columns in increasing order. The compressed sparse
+ * column form of A is the CSR form of A^T, sparse_transpose converts
+ * between the two.
+ *
+ * The products split the rows into ranges of about equal nonzero
+ * count (plus one per row, so that empty rows are not free) between
+ * the threads, or the processes for the _mpi ones, instead of equal
+ * row counts, so that a few dense rows do not stall one worker. The
+ * elimination reorders the matrix by reverse Cuthill-McKee, which
+ * keeps the fill inside the narrow band it produces, and factorises
+ * it row by row touching only the nonzeros of L and U. Like the dense
+ * kernels it does not pivot, the symmetric permutation keeps the
+ * diagonal on the diagonal. */
+
+#include <stdint.h>
+#include <stdio.h>
+
+typedef struct {
+    uint32_t rows;
+    uint32_t cols;
+    uint32_t nnz;
+    uint32_t *row_ptr;  // rows + 1
+    uint32_t *col_idx;  // nnz
+    double *val;        // nnz
+} sparse_matrix_t;
+
+int
+sparse_alloc(sparse_matrix_t *S, uint32_t rows, uint32_t cols, uint32_t nnz);
+
+void
+sparse_free(sparse_matrix_t *S);
+
+/* S = the nonzeros of the rows x cols row-major M */
+int
+sparse_from_dense(sparse_matrix_t *S, const double *M, uint32_t rows, uint32_t cols);
+
+/* M = S, the zeros included */
+int
+sparse_to_dense(const sparse_matrix_t *S, double *M);
+
+/* reads a width x width matrix in the format of read_matrix, only
+ * its nonzeros are kept */
+int
+sparse_read_matrix(FILE *file, sparse_matrix_t *S, uint32_t width);
+
+/* T = S^T, that is the CSC form of S */
+int
+sparse_transpose(const sparse_matrix_t *S, sparse_matrix_t *T);
+
+/* y = A x */
+int
+spmv_omp(const sparse_matrix_t *A, const double *x, double *y);
+
+/* C = A B for the row-major A->cols x ncols B and A->rows x ncols C */
+int
+spmm_omp(const sparse_matrix_t *A, const double *B, double *C, uint32_t ncols);
+
+/* the rows of A in parts ranges of about equal weight, part p is
+ * bounds[p] to bounds[p+1]-1 */
+void
+sparse_partition(const sparse_matrix_t *A, uint32_t parts, uint32_t *bounds);
+
+/* as spmv_omp and spmm_omp, A, B (x) and C (y) are only read from or
+ * written to on process 0 */
+int
+spmv_mpi(const sparse_matrix_t *A, const double *x, double *y,
+        int proc_rank, int num_procs);
+
+int
+spmm_mpi(const sparse_matrix_t *A, const double *B, double *C, uint32_t ncols,
+        int proc_rank, int num_procs);
+
+/* reverse Cuthill-McKee order of the pattern of A + A^T, row new of
+ * the reordered matrix is row perm[new] of A */
+int
+sparse_rcm_order(const sparse_matrix_t *A, uint32_t *perm);
+
+/* B = P A P^T for the order perm of sparse_rcm_order */
+int
+sparse_permute(const sparse_matrix_t *A, const uint32_t *perm, sparse_matrix_t *B);
+
+/* LU factorisation without pivoting, L (unit diagonal) below the
+ * diagonal of LU and U on and above it, the fill included */
+int
+sparse_lu_factor(const sparse_matrix_t *A, sparse_matrix_t *LU);
+
+/* solves LU x = b in place */
+int
+sparse_lu_solve(const sparse_matrix_t *LU, double *b);
+
+/* orders, factorises and solves A x = b, overwriting b with x */
+int
+sparse_solve(const sparse_matrix_t *A, double *b);
+
+#endif
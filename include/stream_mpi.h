@@ -0,0 +1,26 @@
+#ifndef _STREAM_MPI_H
+#define _STREAM_MPI_H
+
+/* Matmul that overlaps reading the input with the computation.
+ *
+ * Process 0 parses the driver format (the width, then M_1 and M_2
+ * row-major) in chunks of rows. The chunks of M_1 go to the process
+ * that owns the rows (rows split as in the kernels) with nonblocking
+ * sends, the chunks of M_2 to everyone with nonblocking broadcasts,
+ * and every process adds the contribution of each chunk of M_2 to its
+ * rows of the product as soon as the chunk is in, while process 0
+ * parses the next one. Only process 0 ever holds a whole matrix, the
+ * product it gathers at the end. */
+
+#include <stdio.h>
+
+/* STREAM_CHUNK_DOUBLES / width rows per chunk, at least one */
+#define STREAM_CHUNK_DOUBLES 65536
+
+/* reads from file on process 0, sets width on every process and
+ * allocates P on process 0 for the product (NULL elsewhere) */
+int
+matMulSquare_stream_mpi(FILE *file, double **P, int *width,
+        int proc_rank, int num_procs);
+
+#endif
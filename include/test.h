@@ -26,7 +26,6 @@ validate_matrix(double *v, double *a, uint32_t matsize)
             log_err("Erroneous value at index %d, expected close to %lf, found %lf", index, a[index], v[index]);
             return -1;
         }
-        index++;
     }
     return 0;
 }
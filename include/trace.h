@@ -0,0 +1,63 @@
+#ifndef _TRACE_H
+#define _TRACE_H
+
+/* Timeline tracing of kernel phases, written as Chrome trace JSON
+ * (chrome://tracing, ui.perfetto.dev).
+ *
+ * Built in with -DTRACE (`make omp TRACE=1`), otherwise the macros
+ * below expand to nothing. When built in, recording is switched on at
+ * run time by the TRACE_FILE environment variable naming the output.
+ *
+ * TRACE_BEGIN(name)/TRACE_END(name) go around a phase in the same
+ * scope, name is a plain identifier (scatter, pivot_bcast, ...). Every
+ * thread records into its own ring buffer, no locks are taken, and the
+ * oldest events are overwritten once TRACE_EVENTS_PER_THREAD is
+ * reached.
+ *
+ * MPI programs include trace_mpi.h and call TRACE_SYNC_MPI(rank, procs)
+ * after MPI_Init, which estimates the clock offset of every rank to
+ * rank 0 by ping-pong, and TRACE_DUMP_MPI(rank, procs) before
+ * MPI_Finalize, which has the ranks append their events to the one
+ * file in turn (pid is the rank, tid the thread). Other programs call TRACE_DUMP() at the end. Both dumps
+ * are collective over the threads recorded so far and must be called
+ * outside of any parallel region. */
+
+#define TRACE_EVENTS_PER_THREAD (1 << 16)
+#define TRACE_MAX_THREADS 256
+
+#ifdef TRACE
+
+#include <stdio.h>
+
+int
+trace_enabled(void);
+
+double
+trace_now(void);
+
+void
+trace_event(const char *name, double begin);
+
+void
+trace_set_rank(int rank, double clock_offset);
+
+/* writes the events of this process to file without the enclosing
+ * brackets, a comma is put in front of the first one unless first */
+void
+trace_write(FILE *file, int first);
+
+int
+trace_dump(void);
+
+#define TRACE_BEGIN(NAME) const double trace_begin_##NAME = trace_now()
+#define TRACE_END(NAME) trace_event(#NAME, trace_begin_##NAME)
+#define TRACE_DUMP() trace_dump()
+
+#else
+
+#define TRACE_BEGIN(NAME)
+#define TRACE_END(NAME)
+#define TRACE_DUMP()
+
+#endif
+#endif
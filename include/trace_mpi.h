@@ -0,0 +1,86 @@
+#ifndef _TRACE_MPI_H
+#define _TRACE_MPI_H
+
+/* Clock synchronisation and dump of the traces of all ranks into one
+ * file, see trace.h */
+
+#include "trace.h"
+
+#ifdef TRACE
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TRACE_SYNC_ROUNDS 16
+
+/* the offset is taken from the round trip with the least latency,
+ * local time + offset is then rank 0's time */
+static inline void
+trace_sync_mpi(int rank, int num_procs)
+{
+    double offset = 0.0, best = -1.0, t_root = 0.0;
+    for (int peer = 1; peer < num_procs; peer++)
+    {
+        for (int round = 0; round < TRACE_SYNC_ROUNDS; round++)
+        {
+            if (rank == 0)
+            {
+                MPI_Recv(&t_root, 1, MPI_DOUBLE, peer, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                t_root = trace_now();
+                MPI_Send(&t_root, 1, MPI_DOUBLE, peer, 0, MPI_COMM_WORLD);
+            }
+            else if (rank == peer)
+            {
+                const double t_send = trace_now();
+                MPI_Send(&t_send, 1, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD);
+                MPI_Recv(&t_root, 1, MPI_DOUBLE, 0, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+                const double t_recv = trace_now();
+                if (best < 0.0 || t_recv - t_send < best)
+                {
+                    best = t_recv - t_send;
+                    offset = t_root - 0.5 * (t_send + t_recv);
+                }
+            }
+        }
+    }
+    trace_set_rank(rank, offset);
+}
+
+/* rank r appends its events once rank r-1 passes the token */
+static inline void
+trace_dump_mpi(int rank, int num_procs)
+{
+    int token = 0;
+    if (!trace_enabled())
+        return;
+    if (rank > 0)
+        MPI_Recv(&token, 1, MPI_INT, rank - 1, 0, MPI_COMM_WORLD, MPI_STATUS_IGNORE);
+    FILE *file = fopen(getenv("TRACE_FILE"), rank == 0 ? "w" : "a");
+    if (file)
+    {
+        if (rank == 0)
+            fputs("[\n", file);
+        trace_write(file, rank == 0);
+        if (rank == num_procs - 1)
+            fputs("\n]\n", file);
+        fclose(file);
+    }
+    else
+    {
+        fprintf(stderr, "[WARN] Could not open trace file %s\n", getenv("TRACE_FILE"));
+    }
+    if (rank < num_procs - 1)
+        MPI_Send(&token, 1, MPI_INT, rank + 1, 0, MPI_COMM_WORLD);
+}
+
+#define TRACE_SYNC_MPI(RANK, PROCS) trace_sync_mpi(RANK, PROCS)
+#define TRACE_DUMP_MPI(RANK, PROCS) trace_dump_mpi(RANK, PROCS)
+
+#else
+
+#define TRACE_SYNC_MPI(RANK, PROCS)
+#define TRACE_DUMP_MPI(RANK, PROCS)
+
+#endif
+#endif
@@ -0,0 +1,42 @@
+#ifndef _TRANSPOSE_H
+#define _TRANSPOSE_H
+
+/* Matrix transposition.
+ *
+ * transpose_omp splits the matrix into TRANSPOSE_TILE x TRANSPOSE_TILE
+ * tiles that are handed to the threads, and each tile is halved along
+ * its longer side until a TRANSPOSE_LEAF x TRANSPOSE_LEAF block is
+ * left. The recursion makes the copy cache oblivious: at some level
+ * of it both the source and the destination block fit in every level
+ * of cache (and the TLB), whatever their sizes. Without OpenMP
+ * (the MPI only build) it runs on the calling thread.
+ *
+ * transpose_mpi transposes a matrix distributed by rows over all
+ * processes, rows split as in the kernels (width / num_procs rows
+ * each, one more for the first width % num_procs processes). Every
+ * process transposes the blocks it sends locally, and one
+ * MPI_Alltoallw with strided receive datatypes puts them into place,
+ * so no process ever holds the whole matrix. */
+
+#include <stdint.h>
+
+#define TRANSPOSE_TILE 256
+#define TRANSPOSE_LEAF 32
+
+/* B = A^T for the rows x cols matrix A with row stride lda, B is
+ * cols x rows with row stride ldb. A and B must not overlap */
+int
+transpose_omp(const double *A, uint32_t lda, double *B, uint32_t ldb,
+        uint32_t rows, uint32_t cols);
+
+/* A = A^T for the square matrix A */
+int
+transpose_inplace_omp(double *A, uint32_t width);
+
+/* B_rows = the local rows of A^T, given the local rows A_rows of A.
+ * Both are local_rows x width with the partition described above */
+int
+transpose_mpi(const double *A_rows, double *B_rows, int width,
+        int proc_rank, int num_procs);
+
+#endif
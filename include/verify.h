@@ -0,0 +1,66 @@
+#ifndef _VERIFY_H
+#define _VERIFY_H
+
+/* Verification of results in O(width^2), without a reference.
+ *
+ * verify_matmul checks P = A B by Freivalds' test: for a block X of
+ * trials random vectors, A (B X) against P X, entry by entry relative
+ * to |A| (|B| |X|) + |P| |X|, the size that rounding errors scale
+ * with. A wrong P passes one vector with probability close to zero
+ * (at most 1/2 even for the most unlucky choice of vectors), trials
+ * of them make a false pass vanishingly unlikely.
+ *
+ * verify_lu checks M = L U the same way, through L (U X), and
+ * verify_solve the residual M X - B of solved systems against
+ * |M| |X| + |B|.
+ *
+ * All return 0 when the check passes and -1 (with the worst entry
+ * logged) when it does not. The _omp ones split the rows between the
+ * threads, the _mpi one scatters the rows from process 0 and returns
+ * the verdict on every process. */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define VERIFY_TRIALS 8
+#define VERIFY_TOL 1.0e-9
+
+/* Y = op(M) X for the width x width M and width x trials X and Y,
+ * op(M) = M^T when transposed, with the absolute values of M when
+ * absolute */
+int
+verify_block_omp(const double *M, const double *X, double *Y, uint32_t width,
+        uint32_t trials, int transposed, int absolute);
+
+/* fills the width x trials X from seed, the same on every process */
+void
+verify_random_block(double *X, uint32_t width, uint32_t trials, uint64_t seed);
+
+/* the largest |Z - W| / S of count entries (infinite for a NaN), its
+ * index in where */
+double
+verify_worst_ratio(const double *Z, const double *W, const double *S, size_t count,
+        size_t *where);
+
+/* P = A B, or P = A B^T when transposed_b (the pretranspose kernels) */
+int
+verify_matmul_omp(const double *A, const double *B, const double *P, uint32_t width,
+        int transposed_b, uint32_t trials, uint64_t seed, double tol);
+
+/* M = L U for LU as written by lu_factor_inplace_omp */
+int
+verify_lu_omp(const double *M, const double *LU, uint32_t width,
+        uint32_t trials, uint64_t seed, double tol);
+
+/* M X = B for the width x nrhs row-major X and B */
+int
+verify_solve_omp(const double *M, const double *X, const double *B, uint32_t width,
+        uint32_t nrhs, double tol);
+
+/* as verify_matmul_omp, A, B and P are only read on process 0 */
+int
+verify_matmul_mpi(const double *A, const double *B, const double *P, int width,
+        int transposed_b, int trials, uint64_t seed, double tol,
+        int proc_rank, int num_procs);
+
+#endif
@@ -0,0 +1,147 @@
+#include "dbg.h"
+#include "autotune.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The tuning cache, shared by the OpenMP and the MPI dispatch. The file
+ * is read once, entries tuned later are kept in memory and appended to
+ * it. */
+
+#define AUTOTUNE_MAX_ENTRIES 256
+#define CPU_MODEL_LEN 128
+
+typedef struct {
+    char backend[8];
+    int bucket;
+    int threads;
+    int ranks;
+    autotune_choice_t choice;
+} autotune_entry_t;
+
+static autotune_entry_t entries[AUTOTUNE_MAX_ENTRIES];
+static int num_entries = 0;
+static int loaded = 0;
+static char cpu_model[CPU_MODEL_LEN] = "";
+
+
+static const char *
+cache_path(void)
+{
+    const char *env = getenv("AUTOTUNE_CACHE");
+    return (env && strcmp(env, "")) ? env : "autotune.cache";
+}
+
+
+static const char *
+get_cpu_model(void)
+{
+    char line[256];
+    if (cpu_model[0])
+        return cpu_model;
+    strcpy(cpu_model, "unknown");
+    FILE *file = fopen("/proc/cpuinfo", "r");
+    if (!file)
+        return cpu_model;
+    while (fgets(line, sizeof(line), file))
+    {
+        char *colon = strchr(line, ':');
+        if (!strncmp(line, "model name", 10) && colon)
+        {
+            colon += 1 + strspn(colon + 1, " \t");
+            colon[strcspn(colon, "\n")] = '\0';
+            snprintf(cpu_model, CPU_MODEL_LEN, "%s", colon);
+            break;
+        }
+    }
+    fclose(file);
+    return cpu_model;
+}
+
+
+static void
+load_cache(void)
+{
+    char line[512];
+    loaded = 1;
+    FILE *file = fopen(cache_path(), "r");
+    if (!file)
+        return;
+    while (num_entries < AUTOTUNE_MAX_ENTRIES && fgets(line, sizeof(line), file))
+    {
+        autotune_entry_t *e = &entries[num_entries];
+        char model[CPU_MODEL_LEN] = "";
+        int offset = 0;
+        if (sscanf(line, "%7s %d %d %d %31s %d %n", e->backend, &e->bucket,
+                    &e->threads, &e->ranks, e->choice.method, &e->choice.tile,
+                    &offset) != 6)
+            continue;
+        snprintf(model, CPU_MODEL_LEN, "%s", line + offset);
+        model[strcspn(model, "\n")] = '\0';
+        // entries of other machines are left alone
+        if (!strcmp(model, get_cpu_model()))
+            num_entries++;
+    }
+    fclose(file);
+}
+
+
+int
+autotune_bucket(int width)
+{
+    int bucket = 1;
+    while (bucket < width)
+        bucket *= 2;
+    return bucket;
+}
+
+
+int
+autotune_lookup(const char *backend, int width, int threads, int ranks,
+        autotune_choice_t *choice)
+{
+    if (!loaded)
+        load_cache();
+    const int bucket = autotune_bucket(width);
+    // the latest entry wins if the file has duplicates
+    for (int i = num_entries - 1; i >= 0; i--)
+    {
+        const autotune_entry_t *e = &entries[i];
+        if (!strcmp(e->backend, backend) && e->bucket == bucket
+                && e->threads == threads && e->ranks == ranks)
+        {
+            *choice = e->choice;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+
+int
+autotune_store(const char *backend, int width, int threads, int ranks,
+        const autotune_choice_t *choice)
+{
+    FILE *file = NULL;
+    if (!loaded)
+        load_cache();
+    const int bucket = autotune_bucket(width);
+    if (num_entries < AUTOTUNE_MAX_ENTRIES)
+    {
+        autotune_entry_t *e = &entries[num_entries++];
+        snprintf(e->backend, sizeof(e->backend), "%s", backend);
+        e->bucket = bucket;
+        e->threads = threads;
+        e->ranks = ranks;
+        e->choice = *choice;
+    }
+    file = fopen(cache_path(), "a");
+    check(file, "Could not open the autotuning cache %s", cache_path());
+    fprintf(file, "%s %d %d %d %s %d %s\n", backend, bucket, threads, ranks,
+            choice->method, choice->tile, get_cpu_model());
+    fclose(file);
+    return 0;
+error:
+    return -1;
+}
@@ -0,0 +1,111 @@
+#include "dbg.h"
+#include "autotune.h"
+#include "impl_mpi.h"
+#include "matalloc.h"
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Process 0 looks the key up and decides, the others follow the
+ * broadcast candidate index. Candidates are timed between barriers,
+ * so process 0 sees the slowest process's time. */
+
+typedef struct {
+    const char *method;
+    impl_mpi_t kernel;
+} candidate_t;
+
+static const candidate_t candidates[] = {
+    {"baseline", matMulSquare_baseline_mpi},
+    {"balanced", matMulSquare_balanced_mpi},
+    {"transpose", matMulSquare_transpose_mpi},
+};
+
+static const int num_candidates = sizeof(candidates)/sizeof(candidate_t);
+
+
+static int
+find_candidate(const autotune_choice_t *choice)
+{
+    for (int i = 0; i < num_candidates; i++)
+    {
+        if (!strcmp(candidates[i].method, choice->method))
+            return i;
+    }
+    return -1;
+}
+
+
+static int
+tune(const double *M_1, double *M_2, double *P, int width,
+        int proc_rank, int num_procs)
+{
+    int best = -1;
+    double best_time = 0.0;
+    size_t held[NUM_SCRATCH_SLOTS];
+    mat_scratch_sizes(held);
+    for (int i = 0; i < num_candidates; i++)
+    {
+        double fastest = -1.0;
+        for (int rep = 0; rep < AUTOTUNE_REPS; rep++)
+        {
+            MPI_Barrier(MPI_COMM_WORLD);
+            const double start = MPI_Wtime();
+            int my_err = candidates[i].kernel(M_1, M_2, P, width, proc_rank, num_procs);
+            MPI_Barrier(MPI_COMM_WORLD);
+            const double elapsed = MPI_Wtime() - start;
+            if (my_err)
+            {
+                fastest = -1.0;
+                break;
+            }
+            fastest = (fastest < 0.0 || elapsed < fastest) ? elapsed : fastest;
+        }
+        // the next candidate does not inherit the scratch this one grew
+        mat_scratch_trim(held);
+        if (proc_rank == 0)
+        {
+            debug("autotune mpi width %d: %s %.3e s", width, candidates[i].method, fastest);
+        }
+        if (fastest >= 0.0 && (best < 0 || fastest < best_time))
+        {
+            best = i;
+            best_time = fastest;
+        }
+    }
+    return best;
+}
+
+
+int
+matMulSquare_auto_mpi(const double *M_1, double *M_2, double *P,
+        int width, int proc_rank, int num_procs)
+{
+    autotune_choice_t choice;
+    int index = -1;
+    if (proc_rank == 0 && !autotune_lookup("mpi", width, 1, num_procs, &choice))
+        index = find_candidate(&choice);
+    int mpi_err = MPI_Bcast(&index, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Broadcasting the tuned method failed");
+
+    if (index < 0)
+    {
+        index = tune(M_1, M_2, P, width, proc_rank, num_procs);
+        // process 0's times decide
+        mpi_err = MPI_Bcast(&index, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        check(!mpi_err, "Broadcasting the tuned method failed");
+        check(index >= 0, "No matmul candidate ran successfully");
+        if (proc_rank == 0)
+        {
+            snprintf(choice.method, AUTOTUNE_METHOD_LEN, "%s", candidates[index].method);
+            choice.tile = 0;
+            if (autotune_store("mpi", width, 1, num_procs, &choice))
+                log_warn("Could not store the tuning result");
+        }
+    }
+    return candidates[index].kernel(M_1, M_2, P, width, proc_rank, num_procs);
+error:
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,114 @@
+#include "dbg.h"
+#include "autotune.h"
+#include "fixed_kernels.h"
+#include "impl_omp.h"
+#include "matalloc.h"
+
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+typedef struct {
+    const char *method;
+    impl_omp_t kernel;  // NULL for the tiled kernel
+    int tile;
+} candidate_t;
+
+static const candidate_t candidates[] = {
+    {"baseline", matMulSquare_baseline_omp, 0},
+    {"transpose", matMulSquare_transpose_omp, 0},
+#   define TILED_CANDIDATE(T) {"tiled", NULL, T},
+    AUTOTUNE_TILES(TILED_CANDIDATE)
+#   undef TILED_CANDIDATE
+};
+
+static const int num_candidates = sizeof(candidates)/sizeof(candidate_t);
+
+
+static int
+run_candidate(const candidate_t *c, const double *M_1, const double *M_2,
+        double *P, uint32_t width)
+{
+    if (c->kernel)
+        return c->kernel(M_1, M_2, P, width);
+    return matMulSquare_tiled_omp(M_1, M_2, P, width, (uint32_t) c->tile);
+}
+
+
+static const candidate_t *
+find_candidate(const autotune_choice_t *choice)
+{
+    for (int i = 0; i < num_candidates; i++)
+    {
+        if (!strcmp(candidates[i].method, choice->method) && candidates[i].tile == choice->tile)
+            return candidates + i;
+    }
+    return NULL;
+}
+
+
+/* times every candidate on the arguments, the best of AUTOTUNE_REPS
+ * runs each, and returns the fastest */
+static const candidate_t *
+tune(const double *M_1, const double *M_2, double *P, uint32_t width)
+{
+    const candidate_t *best = NULL;
+    double best_time = 0.0;
+    size_t held[NUM_SCRATCH_SLOTS];
+    mat_scratch_sizes(held);
+    for (int i = 0; i < num_candidates; i++)
+    {
+        double fastest = -1.0;
+        for (int rep = 0; rep < AUTOTUNE_REPS; rep++)
+        {
+            const double start = omp_get_wtime();
+            if (run_candidate(candidates + i, M_1, M_2, P, width))
+            {
+                fastest = -1.0;
+                break;
+            }
+            const double elapsed = omp_get_wtime() - start;
+            fastest = (fastest < 0.0 || elapsed < fastest) ? elapsed : fastest;
+        }
+        // the next candidate does not inherit the scratch this one grew
+        mat_scratch_trim(held);
+        debug("autotune omp width %u: %s %d %.3e s", width, candidates[i].method,
+                candidates[i].tile, fastest);
+        if (fastest >= 0.0 && (!best || fastest < best_time))
+        {
+            best = candidates + i;
+            best_time = fastest;
+        }
+    }
+    return best;
+}
+
+
+int
+matMulSquare_auto_omp(const double *M_1, const double *M_2, double *P,
+        uint32_t width)
+{
+    autotune_choice_t choice;
+    // nothing to choose between for the specialised widths
+    check_mem(M_1); check_mem(M_2); check_mem(P);
+    if (matmul_fixed(M_1, M_2, P, width))
+        return 0;
+    const int threads = omp_get_max_threads();
+
+    const candidate_t *c = NULL;
+    if (!autotune_lookup("omp", (int) width, threads, 1, &choice))
+        c = find_candidate(&choice);
+    if (!c)
+    {
+        c = tune(M_1, M_2, P, width);
+        check(c, "No matmul candidate ran successfully");
+        snprintf(choice.method, AUTOTUNE_METHOD_LEN, "%s", c->method);
+        choice.tile = c->tile;
+        if (autotune_store("omp", (int) width, threads, 1, &choice))
+            log_warn("Could not store the tuning result");
+    }
+    return run_candidate(c, M_1, M_2, P, width);
+error:
+    return -1;
+}
@@ -0,0 +1,331 @@
+#include "dbg.h"
+#include "banded.h"
+#include "impl_omp.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// updates per elimination step below which it stays on one thread
+#define BAND_PARALLEL_MIN (1 << 14)
+
+
+int
+band_detect(const double *M, uint32_t width, uint32_t *lower, uint32_t *upper)
+{
+    check_mem(M); check_mem(lower); check_mem(upper);
+    uint32_t max_lower = 0, max_upper = 0;
+#   pragma omp parallel for schedule(static) reduction(max: max_lower, max_upper)
+    for (uint32_t row = 0; row < width; row++)
+    {
+        const double *M_row = M + (size_t) row * width;
+        for (uint32_t col = 0; col < row; col++)
+        {
+            if (M_row[col] != 0.0)
+            {
+                if (row - col > max_lower)
+                    max_lower = row - col;
+                break;
+            }
+        }
+        for (uint32_t col = width - 1; col > row; col--)
+        {
+            if (M_row[col] != 0.0)
+            {
+                if (col - row > max_upper)
+                    max_upper = col - row;
+                break;
+            }
+        }
+    }
+    *lower = max_lower;
+    *upper = max_upper;
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+band_alloc(band_matrix_t *B, uint32_t width, uint32_t lower, uint32_t upper)
+{
+    check_mem(B);
+    check(width > 0, "Non-positive width");
+    check(lower < width && upper < width, "Band wider than the matrix");
+    B->width = width;
+    B->lower = lower;
+    B->upper = upper;
+    B->data = (double *) calloc((size_t) width * BAND_LD(B), sizeof(double));
+    check_mem(B->data);
+    return 0;
+error:
+    if (B)
+        B->data = NULL;
+    return -1;
+}
+
+
+void
+band_free(band_matrix_t *B)
+{
+    if (B && B->data)
+        free(B->data);
+    if (B)
+        B->data = NULL;
+}
+
+
+int
+band_from_dense(band_matrix_t *B, const double *M)
+{
+    check_mem(B); check_mem(M);
+    const uint32_t width = B->width;
+#   pragma omp parallel for schedule(static)
+    for (uint32_t row = 0; row < width; row++)
+    {
+        const uint32_t col_begin = row > B->lower ? row - B->lower : 0;
+        const uint32_t col_end = width - row > B->upper ? row + B->upper + 1 : width;
+        memcpy(band_at(B, row, col_begin), M + (size_t) row * width + col_begin,
+                (col_end - col_begin) * sizeof(double));
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+band_to_dense(const band_matrix_t *B, double *M)
+{
+    check_mem(B); check_mem(M);
+    const uint32_t width = B->width;
+#   pragma omp parallel for schedule(static)
+    for (uint32_t row = 0; row < width; row++)
+    {
+        const uint32_t col_begin = row > B->lower ? row - B->lower : 0;
+        const uint32_t col_end = width - row > B->upper ? row + B->upper + 1 : width;
+        double *M_row = M + (size_t) row * width;
+        memset(M_row, 0, width * sizeof(double));
+        memcpy(M_row + col_begin, band_at(B, row, col_begin),
+                (col_end - col_begin) * sizeof(double));
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+band_lu_factor_omp(band_matrix_t *B)
+{
+    check_mem(B);
+    const uint32_t width = B->width;
+    for (uint32_t k = 0; k < width; k++)
+    {
+        const double *pivot_row = band_at(B, k, k);
+        const double pivot = pivot_row[0];
+        check(pivot != 0.0, "Zero pivot found! Use partial pivoting algo.");
+        const uint32_t row_end = width - k > B->lower ? k + B->lower + 1 : width;
+        const uint32_t cols = (width - k > B->upper ? B->upper + 1 : width - k);
+
+        // the rows below the pivot within the band, each from its
+        // element in the pivot column on
+#       pragma omp parallel for schedule(static) if ((row_end - k) * cols > BAND_PARALLEL_MIN)
+        for (uint32_t row = k + 1; row < row_end; row++)
+        {
+            double *elmt = band_at(B, row, k);
+            const double factor = elmt[0] / pivot;
+            elmt[0] = factor;
+            for (uint32_t col = 1; col < cols; col++)
+                elmt[col] -= factor * pivot_row[col];
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+band_lu_solve(const band_matrix_t *LU, double *X, uint32_t nrhs)
+{
+    check_mem(LU); check_mem(X);
+    const uint32_t width = LU->width;
+    // forward substitution with the unit lower triangle
+    for (uint32_t row = 0; row < width; row++)
+    {
+        const uint32_t col_begin = row > LU->lower ? row - LU->lower : 0;
+        const double *L_row = band_at(LU, row, col_begin);
+        for (uint32_t col = col_begin; col < row; col++)
+        {
+            for (uint32_t c = 0; c < nrhs; c++)
+                X[(size_t) row * nrhs + c] -= L_row[col - col_begin] * X[(size_t) col * nrhs + c];
+        }
+    }
+    // back substitution with the upper triangle
+    for (uint32_t row = width; row-- > 0;)
+    {
+        const uint32_t col_end = width - row > LU->upper ? row + LU->upper + 1 : width;
+        const double *U_row = band_at(LU, row, row);
+        for (uint32_t col = row + 1; col < col_end; col++)
+        {
+            for (uint32_t c = 0; c < nrhs; c++)
+                X[(size_t) row * nrhs + c] -= U_row[col - row] * X[(size_t) col * nrhs + c];
+        }
+        for (uint32_t c = 0; c < nrhs; c++)
+            X[(size_t) row * nrhs + c] /= U_row[0];
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+gaussian_elimination_banded_omp(double *M, uint32_t width)
+{
+    band_matrix_t B = {0};
+    uint32_t lower, upper;
+    check(!band_detect(M, width, &lower, &upper), "Band detection failed");
+    if ((uint64_t) (lower + upper + 1) * BAND_DENSE_FRACTION > width)
+        return gaussian_elimination_naive_inplace_omp(M, width);
+    check(!band_alloc(&B, width, lower, upper), "Out of memory.");
+    check(!band_from_dense(&B, M), "Packing the band failed");
+    check(!band_lu_factor_omp(&B), "Banded LU failed");
+
+    // U is the same as the one of the elimination, drop L. Outside
+    // the band M is zero already
+    for (uint32_t row = 0; row < width; row++)
+    {
+        const uint32_t col_begin = row > lower ? row - lower : 0;
+        const uint32_t col_end = width - row > upper ? row + upper + 1 : width;
+        double *M_row = M + (size_t) row * width;
+        memset(M_row + col_begin, 0, (row - col_begin) * sizeof(double));
+        memcpy(M_row + row, band_at(&B, row, row), (col_end - row) * sizeof(double));
+    }
+    band_free(&B);
+    return 0;
+error:
+    band_free(&B);
+    return -1;
+}
+
+
+int
+tridiag_solve_thomas(const double *a, const double *b, const double *c,
+        double *D, uint32_t n, uint32_t nrhs)
+{
+    double *c_prime = NULL;
+    check_mem(a); check_mem(b); check_mem(c); check_mem(D);
+    check(n > 0, "Empty system");
+    c_prime = (double *) malloc(n * sizeof(double));
+    check_mem(c_prime);
+
+    double denom = b[0];
+    for (uint32_t row = 0; row < n; row++)
+    {
+        if (row > 0)
+            denom = b[row] - a[row] * c_prime[row - 1];
+        check(denom != 0.0, "Zero pivot found! Use partial pivoting algo.");
+        c_prime[row] = row + 1 < n ? c[row] / denom : 0.0;
+        for (uint32_t col = 0; col < nrhs; col++)
+        {
+            double elmt = D[(size_t) row * nrhs + col];
+            if (row > 0)
+                elmt -= a[row] * D[(size_t) (row - 1) * nrhs + col];
+            D[(size_t) row * nrhs + col] = elmt / denom;
+        }
+    }
+    for (uint32_t row = n - 1; row-- > 0;)
+    {
+        for (uint32_t col = 0; col < nrhs; col++)
+            D[(size_t) row * nrhs + col] -= c_prime[row] * D[(size_t) (row + 1) * nrhs + col];
+    }
+    free(c_prime);
+    return 0;
+error:
+    if (c_prime)
+        free(c_prime);
+    return -1;
+}
+
+
+int
+tridiag_solve_cr_omp(const double *a, const double *b, const double *c,
+        double *d, uint32_t n)
+{
+    double *work = NULL;
+    int zero_pivot = 0;
+    check_mem(a); check_mem(b); check_mem(c); check_mem(d);
+    check(n > 0, "Empty system");
+    work = (double *) malloc(3 * (size_t) n * sizeof(double));
+    check_mem(work);
+    double *A = work, *B = work + n, *C = work + 2 * (size_t) n;
+    memcpy(A, a, n * sizeof(double));
+    memcpy(B, b, n * sizeof(double));
+    memcpy(C, c, n * sizeof(double));
+    A[0] = 0.0;
+    C[n - 1] = 0.0;
+
+    // every level eliminates the neighbours at distance stride from
+    // the equations 2 stride - 1 apart, which only read the ones left
+    // over from the level before
+    uint32_t stride = 1;
+    for (; 2 * stride - 1 < n; stride *= 2)
+    {
+#       pragma omp parallel for schedule(static) reduction(|:zero_pivot)
+        for (uint32_t row = 2 * stride - 1; row < n; row += 2 * stride)
+        {
+            // no way out of a parallel loop, the level is finished and
+            // the flag checked after it
+            if (B[row - stride] == 0.0 || (row + stride < n && B[row + stride] == 0.0))
+            {
+                zero_pivot = 1;
+                continue;
+            }
+            const double alpha = -A[row] / B[row - stride];
+            const double gamma = row + stride < n ? -C[row] / B[row + stride] : 0.0;
+            B[row] += alpha * C[row - stride];
+            d[row] += alpha * d[row - stride];
+            A[row] = alpha * A[row - stride];
+            if (row + stride < n)
+            {
+                B[row] += gamma * A[row + stride];
+                d[row] += gamma * d[row + stride];
+                C[row] = gamma * C[row + stride];
+            }
+            else
+            {
+                C[row] = 0.0;
+            }
+        }
+        check(!zero_pivot, "Zero pivot found! Use partial pivoting algo.");
+    }
+
+    // and back, the unknowns of a level from the ones of the level above
+    for (; stride > 0; stride /= 2)
+    {
+#       pragma omp parallel for schedule(static) reduction(|:zero_pivot)
+        for (uint32_t row = stride - 1; row < n; row += 2 * stride)
+        {
+            if (B[row] == 0.0)
+            {
+                zero_pivot = 1;
+                continue;
+            }
+            double elmt = d[row];
+            if (row >= stride)
+                elmt -= A[row] * d[row - stride];
+            if (row + stride < n)
+                elmt -= C[row] * d[row + stride];
+            d[row] = elmt / B[row];
+        }
+        check(!zero_pivot, "Zero pivot found! Use partial pivoting algo.");
+    }
+    free(work);
+    return 0;
+error:
+    if (work)
+        free(work);
+    return -1;
+}
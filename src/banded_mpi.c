@@ -0,0 +1,126 @@
+#include "dbg.h"
+#include "banded.h"
+
+#include <mpi.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+int
+tridiag_solve_mpi(const double *a, const double *b, const double *c,
+        double *d, int n, int proc_rank, int num_procs)
+{
+    int *counts = NULL;
+    double *local = NULL, *ends = NULL;
+    band_matrix_t R = {0};
+    int mpi_err;
+    check(n >= 2 * num_procs, "Poorly balanced problem: (%d rows, %d processes)", n, num_procs);
+
+    counts = (int *) malloc(2 * num_procs * sizeof(int));
+    check_mem(counts);
+    int *displacements = counts + num_procs;
+    for (int i = 0, offset = 0; i < num_procs; i++)
+    {
+        counts[i] = n / num_procs + (i < n % num_procs);
+        displacements[i] = offset;
+        offset += counts[i];
+    }
+    const int my_rows = counts[proc_rank];
+
+    // the three diagonals and the right hand side of the block, then
+    // the block solved for it and the two spikes, row-major
+    local = (double *) malloc(7 * (size_t) my_rows * sizeof(double));
+    check_mem(local);
+    double *la = local, *lb = local + my_rows, *lc = local + 2 * my_rows;
+    double *ld = local + 3 * my_rows, *Y = local + 4 * my_rows;
+    const double *diagonals[] = {a, b, c, d};
+    for (int i = 0; i < 4; i++)
+    {
+        mpi_err = MPI_Scatterv(diagonals[i], counts, displacements, MPI_DOUBLE,
+                local + i * my_rows, my_rows, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        check(!mpi_err, "Scattering the system failed");
+    }
+
+    /* x = y - v x_left - w x_right, for the unknowns x_left before and
+     * x_right after the block, T y = d, T v = a_0 e_0 and T w =
+     * c_last e_last for the block T without its couplings */
+    for (int row = 0; row < my_rows; row++)
+    {
+        Y[3 * row] = ld[row];
+        Y[3 * row + 1] = row == 0 && proc_rank > 0 ? la[0] : 0.0;
+        Y[3 * row + 2] = row == my_rows - 1 && proc_rank < num_procs - 1 ? lc[row] : 0.0;
+    }
+    check(!tridiag_solve_thomas(la, lb, lc, Y, (uint32_t) my_rows, 3),
+            "Local solve failed");
+
+    // the equations of the first and last unknown of every block
+    // only involve block ends
+    if (proc_rank == 0)
+    {
+        ends = (double *) malloc(8 * num_procs * sizeof(double));
+        check_mem(ends);
+    }
+    double my_ends[6] = {Y[0], Y[1], Y[2],
+        Y[3 * (my_rows - 1)], Y[3 * (my_rows - 1) + 1], Y[3 * (my_rows - 1) + 2]};
+    mpi_err = MPI_Gather(my_ends, 6, MPI_DOUBLE, ends, 6, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Gathering the block ends failed");
+
+    double *neighbours = NULL;
+    if (proc_rank == 0)
+    {
+        // unknowns first_0, last_0, first_1, ...: first_p and last_p
+        // couple to last_(p-1) and first_(p+1), two off either way
+        const uint32_t m = 2 * (uint32_t) num_procs;
+        double *z = ends + 6 * num_procs;
+        const uint32_t reach = m > 2 ? 2 : 1;
+        check(!band_alloc(&R, m, reach, reach), "Out of memory.");
+        for (uint32_t p = 0; p < (uint32_t) num_procs; p++)
+        {
+            for (uint32_t end = 0; end < 2; end++)
+            {
+                const uint32_t row = 2 * p + end;
+                const double *e = ends + 6 * p + 3 * end;
+                *band_at(&R, row, row) = 1.0;
+                if (p > 0)
+                    *band_at(&R, row, 2 * p - 1) = e[1];
+                if (p + 1 < (uint32_t) num_procs)
+                    *band_at(&R, row, 2 * p + 2) = e[2];
+                z[row] = e[0];
+            }
+        }
+        check(!band_lu_factor_omp(&R), "Reduced system factorisation failed");
+        check(!band_lu_solve(&R, z, 1), "Reduced system solve failed");
+
+        // x_left and x_right of every process, in place of its ends
+        neighbours = ends;
+        for (int p = 0; p < num_procs; p++)
+        {
+            neighbours[2 * p] = p > 0 ? z[2 * p - 1] : 0.0;
+            neighbours[2 * p + 1] = p + 1 < num_procs ? z[2 * p + 2] : 0.0;
+        }
+        band_free(&R);
+    }
+    double x_lr[2];
+    mpi_err = MPI_Scatter(neighbours, 2, MPI_DOUBLE, x_lr, 2, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Scattering the block ends failed");
+
+    for (int row = 0; row < my_rows; row++)
+        ld[row] = Y[3 * row] - Y[3 * row + 1] * x_lr[0] - Y[3 * row + 2] * x_lr[1];
+    mpi_err = MPI_Gatherv(ld, my_rows, MPI_DOUBLE, d, counts, displacements,
+            MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Gathering the solution failed");
+
+    free(counts); free(local);
+    if (ends)
+        free(ends);
+    return EXIT_SUCCESS;
+error:
+    band_free(&R);
+    if (counts)
+        free(counts);
+    if (local)
+        free(local);
+    if (ends)
+        free(ends);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,128 @@
+#include "dbg.h"
+#include "fixed_kernels.h"
+#include "impl_mpi.h"
+
+#include <mpi.h>
+#include <stdlib.h>
+
+/* Batched kernels for many small independent matrices, distributed
+ * across processes by whole matrices. The batches are contiguous
+ * (matrix b starts at b*width*width) and only need to be valid on
+ * process 0. */
+
+
+static int
+batch_counts(int batch_count, int mat_size, int num_procs,
+        int **send_counts, int **displacements)
+{
+    *send_counts = (int *) malloc(num_procs * sizeof(int));
+    check_mem(*send_counts);
+    *displacements = (int *) malloc(num_procs * sizeof(int));
+    check_mem(*displacements);
+
+    int mats_per_proc = batch_count / num_procs;
+    int unbalanced_num_mats = batch_count - mats_per_proc * num_procs;
+    for (int i = 0; i < num_procs; i++)
+    {
+        (*send_counts)[i] = (mats_per_proc + (i < unbalanced_num_mats)) * mat_size;
+        (*displacements)[i] = i ? (*displacements)[i-1] + (*send_counts)[i-1] : 0;
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+matMulBatched_mpi(const double *M_1, const double *M_2, double *P,
+        int width, int batch_count, int proc_rank, int num_procs)
+{
+    int *send_counts = NULL, *displacements = NULL;
+    double *m1_buf = NULL, *m2_buf = NULL, *p_buf = NULL;
+    const int mat_size = width * width;
+    if (proc_rank == 0)
+    {
+        check_mem(M_1); check_mem(M_2); check_mem(P);
+    }
+    check(!batch_counts(batch_count, mat_size, num_procs, &send_counts, &displacements),
+            "Could not partition the batch");
+
+    const int my_count = send_counts[proc_rank];
+    m1_buf = (double *) malloc((my_count + 1) * sizeof(double));
+    check_mem(m1_buf);
+    m2_buf = (double *) malloc((my_count + 1) * sizeof(double));
+    check_mem(m2_buf);
+    p_buf = (double *) malloc((my_count + 1) * sizeof(double));
+    check_mem(p_buf);
+
+    int mpi_err = MPI_Scatterv(M_1, send_counts, displacements, MPI_DOUBLE,
+            m1_buf, my_count, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Scattering M_1 failed");
+    mpi_err = MPI_Scatterv(M_2, send_counts, displacements, MPI_DOUBLE,
+            m2_buf, my_count, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Scattering M_2 failed");
+
+    for (int b = 0; b < my_count / mat_size; b++)
+        matmul_serial(m1_buf + b * mat_size, m2_buf + b * mat_size, p_buf + b * mat_size,
+                (uint32_t) width);
+
+    mpi_err = MPI_Gatherv(p_buf, my_count, MPI_DOUBLE,
+            P, send_counts, displacements, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Gathering P failed");
+
+    free(m1_buf); free(m2_buf); free(p_buf);
+    free(send_counts); free(displacements);
+    return 0;
+error:
+    if (m1_buf) free(m1_buf);
+    if (m2_buf) free(m2_buf);
+    if (p_buf) free(p_buf);
+    if (send_counts) free(send_counts);
+    if (displacements) free(displacements);
+    return -1;
+}
+
+
+int
+gaussian_elimination_batched_mpi(double *M, int width, int batch_count,
+        int proc_rank, int num_procs)
+{
+    int *send_counts = NULL, *displacements = NULL;
+    double *m_buf = NULL;
+    int num_failed = 0, total_failed = 0;
+    const int mat_size = width * width;
+    if (proc_rank == 0)
+    {
+        check_mem(M);
+    }
+    check(!batch_counts(batch_count, mat_size, num_procs, &send_counts, &displacements),
+            "Could not partition the batch");
+
+    const int my_count = send_counts[proc_rank];
+    m_buf = (double *) malloc((my_count + 1) * sizeof(double));
+    check_mem(m_buf);
+
+    int mpi_err = MPI_Scatterv(M, send_counts, displacements, MPI_DOUBLE,
+            m_buf, my_count, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Scattering M failed");
+
+    for (int b = 0; b < my_count / mat_size; b++)
+        num_failed += (eliminate_serial(m_buf + b * mat_size, (uint32_t) width) != 0);
+
+    mpi_err = MPI_Gatherv(m_buf, my_count, MPI_DOUBLE,
+            M, send_counts, displacements, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Gathering M failed");
+    mpi_err = MPI_Allreduce(&num_failed, &total_failed, 1, MPI_INT,
+            MPI_SUM, MPI_COMM_WORLD);
+    check(!mpi_err, "Reducing failure count failed");
+    check(total_failed == 0, "Zero pivot in %d matrices of the batch", total_failed);
+
+    free(m_buf);
+    free(send_counts); free(displacements);
+    return 0;
+error:
+    if (m_buf) free(m_buf);
+    if (send_counts) free(send_counts);
+    if (displacements) free(displacements);
+    return -1;
+}
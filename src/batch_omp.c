@@ -0,0 +1,207 @@
+#include "dbg.h"
+#include "fixed_kernels.h"
+#include "impl_omp.h"
+
+#include <inttypes.h>
+#include <omp.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+/* Batched kernels for many small independent matrices. Parallelism
+ * is across the batch: every matrix is handled by a single thread
+ * (specialised kernel if there is one for the width) instead of
+ * forking a team inside each tiny product. */
+
+#define INTERLEAVE_CHUNK 64  // matrices per thread in the interleaved kernels
+
+
+int
+matMulBatched_strided_omp(const double *M_1, const double *M_2, double *P,
+        uint32_t width, size_t stride, size_t batch_count)
+{
+    check_mem(M_1); check_mem(M_2); check_mem(P);
+    check(stride >= (size_t) width * width, "Stride %zu overlaps %u x %u matrices", stride, width, width);
+#   pragma omp parallel for schedule(static)
+    for (size_t b = 0; b < batch_count; b++)
+    {
+        matmul_serial(M_1 + b*stride, M_2 + b*stride, P + b*stride, width);
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+matMulBatched_omp(const double *const *M_1, const double *const *M_2,
+        double *const *P, uint32_t width, size_t batch_count)
+{
+    check_mem(M_1); check_mem(M_2); check_mem(P);
+    for (size_t b = 0; b < batch_count; b++)
+        check(M_1[b] && M_2[b] && P[b], "Matrix %zu of the batch is NULL", b);
+#   pragma omp parallel for schedule(static)
+    for (size_t b = 0; b < batch_count; b++)
+    {
+        matmul_serial(M_1[b], M_2[b], P[b], width);
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+gaussian_elimination_batched_strided_omp(double *M, uint32_t width,
+        size_t stride, size_t batch_count)
+{
+    int num_failed = 0;
+    check_mem(M);
+    check(stride >= (size_t) width * width, "Stride %zu overlaps %u x %u matrices", stride, width, width);
+#   pragma omp parallel for schedule(static) reduction(+:num_failed)
+    for (size_t b = 0; b < batch_count; b++)
+    {
+        num_failed += (eliminate_serial(M + b*stride, width) != 0);
+    }
+    check(num_failed == 0, "Zero pivot in %d matrices of the batch", num_failed);
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+gaussian_elimination_batched_omp(double *const *M, uint32_t width,
+        size_t batch_count)
+{
+    int num_failed = 0;
+    check_mem(M);
+    for (size_t b = 0; b < batch_count; b++)
+        check(M[b], "Matrix %zu of the batch is NULL", b);
+#   pragma omp parallel for schedule(static) reduction(+:num_failed)
+    for (size_t b = 0; b < batch_count; b++)
+    {
+        num_failed += (eliminate_serial(M[b], width) != 0);
+    }
+    check(num_failed == 0, "Zero pivot in %d matrices of the batch", num_failed);
+    return 0;
+error:
+    return -1;
+}
+
+
+/* Interleaved ("batch innermost") layout: element (row, col) of
+ * matrix b lives at A[(row*width + col)*batch_count + b], so the
+ * innermost loop runs over matrices and every SIMD lane works on a
+ * different matrix with unit stride loads. */
+
+int
+batch_interleave(const double *A, double *A_il, uint32_t width, size_t batch_count)
+{
+    check_mem(A); check_mem(A_il);
+    const size_t mat_size = (size_t) width * width;
+#   pragma omp parallel for schedule(static)
+    for (size_t b = 0; b < batch_count; b++)
+    {
+        for (size_t i = 0; i < mat_size; i++)
+            A_il[i*batch_count + b] = A[b*mat_size + i];
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+batch_deinterleave(const double *A_il, double *A, uint32_t width, size_t batch_count)
+{
+    check_mem(A_il); check_mem(A);
+    const size_t mat_size = (size_t) width * width;
+#   pragma omp parallel for schedule(static)
+    for (size_t b = 0; b < batch_count; b++)
+    {
+        for (size_t i = 0; i < mat_size; i++)
+            A[b*mat_size + i] = A_il[i*batch_count + b];
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+matMulBatched_interleaved_omp(const double *M_1, const double *M_2, double *P,
+        uint32_t width, size_t batch_count)
+{
+    check_mem(M_1); check_mem(M_2); check_mem(P);
+    const size_t n = batch_count;
+#   pragma omp parallel for schedule(static)
+    for (size_t b0 = 0; b0 < n; b0 += INTERLEAVE_CHUNK)
+    {
+        const size_t b1 = (b0 + INTERLEAVE_CHUNK < n) ? b0 + INTERLEAVE_CHUNK : n;
+        for (uint32_t row = 0; row < width; row++)
+        {
+            for (uint32_t col = 0; col < width; col++)
+            {
+                double *p = P + ((size_t) row*width + col)*n;
+                for (size_t b = b0; b < b1; b++)
+                    p[b] = 0.0l;
+                for (uint32_t i = 0; i < width; i++)
+                {
+                    const double *a = M_1 + ((size_t) row*width + i)*n;
+                    const double *c = M_2 + ((size_t) i*width + col)*n;
+#                   pragma omp simd
+                    for (size_t b = b0; b < b1; b++)
+                        p[b] += a[b] * c[b];
+                }
+            }
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+gaussian_elimination_batched_interleaved_omp(double *M, uint32_t width,
+        size_t batch_count)
+{
+    int num_failed = 0;
+    check_mem(M);
+    const size_t n = batch_count;
+#   pragma omp parallel for schedule(static) reduction(+:num_failed)
+    for (size_t b0 = 0; b0 < n; b0 += INTERLEAVE_CHUNK)
+    {
+        const size_t b1 = (b0 + INTERLEAVE_CHUNK < n) ? b0 + INTERLEAVE_CHUNK : n;
+        double factor[INTERLEAVE_CHUNK];
+        for (uint32_t iter = 0; iter + 1 < width; iter++)
+        {
+            const double *pivot = M + ((size_t) iter*width + iter)*n;
+            for (size_t b = b0; b < b1; b++)
+                num_failed += (pivot[b] == 0);
+            for (uint32_t row = iter + 1; row < width; row++)
+            {
+                double *lead = M + ((size_t) row*width + iter)*n;
+#               pragma omp simd
+                for (size_t b = b0; b < b1; b++)
+                {
+                    factor[b - b0] = lead[b] / pivot[b];
+                    lead[b] = 0.0l;
+                }
+                for (uint32_t col = iter + 1; col < width; col++)
+                {
+                    double *m = M + ((size_t) row*width + col)*n;
+                    const double *u = M + ((size_t) iter*width + col)*n;
+#                   pragma omp simd
+                    for (size_t b = b0; b < b1; b++)
+                        m[b] -= factor[b - b0] * u[b];
+                }
+            }
+        }
+    }
+    check(num_failed == 0, "%d zero pivots in the batch", num_failed);
+    return 0;
+error:
+    return -1;
+}
@@ -0,0 +1,493 @@
+#include "dbg.h"
+#include "autotune.h"
+#include "impl_mpi.h"
+#include "impl_omp.h"
+#include "matalloc.h"
+#include "matrixio.h"
+#include "morton.h"
+#include "ooc.h"
+#include "perf_counters.h"
+#include "trace_mpi.h"
+
+#include <inttypes.h>
+#include <math.h>
+#include <mpi.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Benchmark driver for the OpenMP and MPI kernels.
+ *
+ *   bench.out [-b omp|mpi] [-k matmul|elim] [-m method] [-w width]
+ *             [-t threads] [-n repetitions] [-x warmup] [-s seed]
+ *             [-i input | -l left -r right] [-f csv|json] [-N]
+ *             [-p touch|interleave|malloc] [-T tile] [-M megabytes]
+ *
+ * -i reads the driver format (width, then both matrices, "-" for
+ * stdin), -l/-r read bare matrices of width -w as written by
+ * test/generate_matrices.py, or binary matrix files from gen.out.
+ * Without either, diagonally dominant random matrices of width -w are
+ * generated from -s. Every repetition is timed separately after the
+ * warmup runs, for MPI as the slowest process's time between two
+ * barriers. One line of statistics is printed per run, -N leaves out
+ * the CSV header. -p places the matrices of process 0 on the NUMA
+ * nodes, first touch by the kernels' row schedule (default),
+ * interleaved or plain malloc.
+ * -m auto runs the autotuned kernel (see autotune.h), whose first
+ * call, a warmup run unless -x 0, does the tuning, -T sets the tile of
+ * -m tiled and the panel columns of -m lowmem. -m morton times the
+ * conversions to and from Morton order with the tile kernel. -m ooc
+ * writes the operands to files under $TMPDIR (or /tmp) on its first
+ * call and times the out-of-core matmul (see ooc.h) with a memory
+ * budget of -M megabytes (default 64), reading the product back from
+ * its file.
+ * -k elim -m persistent times the OpenMP elimination in one parallel
+ * region, any other method the naive one. */
+
+typedef struct {
+    const char *name;
+    impl_omp_t omp;
+    impl_mpi_t mpi;
+} bench_method_t;
+
+// tile size of the tiled kernel, set with -T
+static uint32_t bench_tile = 64;
+
+static int
+tiled_omp(const double *M_1, const double *M_2, double *P, uint32_t width)
+{
+    return matMulSquare_tiled_omp(M_1, M_2, P, width, bench_tile);
+}
+
+static int
+morton_omp(const double *M_1, const double *M_2, double *P, uint32_t width)
+{
+    morton_matrix_t A = {0}, B = {0}, C = {0};
+    check(!morton_alloc(&A, width) && !morton_alloc(&B, width) && !morton_alloc(&C, width),
+            "Morton allocation failed");
+    check(!morton_from_rowmajor_omp(&A, M_1) && !morton_from_rowmajor_omp(&B, M_2),
+            "Conversion to Morton order failed");
+    check(!matMulSquare_morton_omp(&A, &B, &C), "Morton matmul failed");
+    check(!morton_to_rowmajor_omp(&C, P), "Conversion from Morton order failed");
+    morton_free(&A); morton_free(&B); morton_free(&C);
+    return 0;
+error:
+    morton_free(&A); morton_free(&B); morton_free(&C);
+    return -1;
+}
+
+// memory of the out-of-core kernel, set with -M, and its files
+static size_t bench_ooc_memory = (size_t) 64 << 20;
+static char bench_ooc_paths[3][256];
+static const double *bench_ooc_staged = NULL;
+
+static int
+ooc_omp(const double *M_1, const double *M_2, double *P, uint32_t width)
+{
+    if (bench_ooc_staged != M_1)
+    {
+        const char *dir = getenv("TMPDIR") ? getenv("TMPDIR") : "/tmp";
+        const char *names[] = {"left", "right", "product"};
+        for (int i = 0; i < 3; i++)
+            snprintf(bench_ooc_paths[i], sizeof(bench_ooc_paths[i]), "%s/bench_ooc_%s_%ld.bin",
+                    dir, names[i], (long) getpid());
+        check(!ooc_write_matrix(bench_ooc_paths[0], M_1, width), "Could not stage the left operand");
+        check(!ooc_write_matrix(bench_ooc_paths[1], M_2, width), "Could not stage the right operand");
+        bench_ooc_staged = M_1;
+    }
+    check(!matMulSquare_ooc_omp(bench_ooc_paths[0], bench_ooc_paths[1], bench_ooc_paths[2],
+                bench_ooc_memory), "Out-of-core matmul failed");
+    return ooc_read_matrix(bench_ooc_paths[2], P, width);
+error:
+    return -1;
+}
+
+static void
+ooc_cleanup(void)
+{
+    if (!bench_ooc_staged)
+        return;
+    for (int i = 0; i < 3; i++)
+        unlink(bench_ooc_paths[i]);
+    bench_ooc_staged = NULL;
+}
+
+static int
+lowmem_mpi(const double *M_1, double *M_2, double *P, int width,
+        int proc_rank, int num_procs)
+{
+    return matMulSquare_lowmem_mpi(M_1, M_2, P, width, proc_rank, num_procs, (int) bench_tile);
+}
+
+static const bench_method_t bench_methods[] = {
+    {"baseline", matMulSquare_baseline_omp, matMulSquare_baseline_mpi},
+    {"transpose", matMulSquare_transpose_omp, matMulSquare_transpose_mpi},
+    {"pretranspose", matMulSquare_pretranspose_omp, matMulSquare_pretranspose_mpi},
+    {"balanced", NULL, matMulSquare_balanced_mpi},
+    {"tiled", tiled_omp, NULL},
+    {"morton", morton_omp, NULL},
+    {"ooc", ooc_omp, NULL},
+    {"auto", matMulSquare_auto_omp, matMulSquare_auto_mpi},
+    {"lowmem", NULL, lowmem_mpi},
+};
+
+static const int num_bench_methods = sizeof(bench_methods)/sizeof(bench_method_t);
+
+typedef struct {
+    const char *backend;
+    const char *kernel;
+    const char *method;
+    const char *format;
+    const char *input;
+    const char *left;
+    const char *right;
+    const char *placement;
+    int width;
+    int threads;
+    int reps;
+    int warmup;
+    int header;
+    unsigned long seed;
+} bench_opts_t;
+
+
+static int
+compare_doubles(const void *a, const void *b)
+{
+    double x = *(const double *) a, y = *(const double *) b;
+    return (x > y) - (x < y);
+}
+
+
+static void
+fill_random(double *m, int width, unsigned long seed)
+{
+    // xorshift64*, diagonally dominant so that elimination without
+    // pivoting is well behaved
+    uint64_t state = seed * 2685821657736338717ull + 1;
+    for (int i = 0; i < width * width; i++)
+    {
+        state ^= state >> 12; state ^= state << 25; state ^= state >> 27;
+        m[i] = (double) ((state * 2685821657736338717ull) >> 11) / 9007199254740992.0;
+    }
+    for (int i = 0; i < width; i++)
+        m[i * width + i] += width;
+}
+
+
+static int
+placement_policy(const bench_opts_t *opts)
+{
+    if (!strcmp(opts->placement, "interleave"))
+        return NUMA_INTERLEAVE;
+    return strcmp(opts->placement, "malloc") ? NUMA_FIRST_TOUCH : NUMA_NONE;
+}
+
+
+// a bare text matrix, or a binary matrix file (include/ooc.h) as
+// written by gen.out
+static int
+load_matrix(const char *path, double *M, int width)
+{
+    char magic[sizeof(OOC_MAGIC) - 1];
+    FILE *file = fopen(path, "r");
+    check(file, "Could not open %s", path);
+    const int binary = fread(magic, 1, sizeof(magic), file) == sizeof(magic)
+        && !memcmp(magic, OOC_MAGIC, sizeof(magic));
+    if (binary)
+    {
+        fclose(file);
+        return ooc_read_matrix(path, M, (uint32_t) width);
+    }
+    rewind(file);
+    int my_err = read_matrix(file, M, width);
+    fclose(file);
+    return my_err;
+error:
+    return -1;
+}
+
+
+static int
+load_inputs(const bench_opts_t *opts, int *width, double **m1, double **m2)
+{
+    FILE *file = NULL;
+    *width = opts->width;
+    if (opts->input)
+    {
+        file = strcmp(opts->input, "-") ? fopen(opts->input, "r") : stdin;
+        check(file, "Could not open %s", opts->input);
+        check(fscanf(file, "%d", width) == 1, "Could not read width from %s", opts->input);
+    }
+    check(*width > 0, "Non-positive width %d", *width);
+
+    // placed before anything is read into them
+    *m1 = numa_alloc_matrix_omp(*width, placement_policy(opts));
+    check_mem(*m1);
+    *m2 = numa_alloc_matrix_omp(*width, placement_policy(opts));
+    check_mem(*m2);
+
+    if (file)
+    {
+        check(!read_matrices(*m1, *m2, *width, file), "Could not read matrices");
+        if (file != stdin)
+            fclose(file);
+        file = NULL;
+    }
+    else if (opts->left && opts->right)
+    {
+        check(!load_matrix(opts->left, *m1, *width), "Could not read %s", opts->left);
+        check(!load_matrix(opts->right, *m2, *width), "Could not read %s", opts->right);
+    }
+    else
+    {
+        fill_random(*m1, *width, opts->seed);
+        fill_random(*m2, *width, opts->seed + 1);
+    }
+    return 0;
+error:
+    if (file && file != stdin)
+        fclose(file);
+    return -1;
+}
+
+
+static int
+run_once(const bench_opts_t *opts, const bench_method_t *method,
+        const double *m1, double *m2, double *p, double *work, int width,
+        int proc_rank, int num_procs, double *elapsed)
+{
+    const int use_mpi = !strcmp(opts->backend, "mpi");
+    const int is_matmul = !strcmp(opts->kernel, "matmul");
+    int my_err = 0;
+    double start = 0.0l;
+
+    // elimination works in place, every run starts from a fresh copy
+    if (!is_matmul && proc_rank == 0)
+        memcpy(work, m1, (size_t) width * width * sizeof(double));
+
+    if (use_mpi)
+    {
+        MPI_Barrier(MPI_COMM_WORLD);
+        PERF_KERNEL_BEGIN();
+        start = MPI_Wtime();
+        if (is_matmul)
+            my_err = method->mpi(m1, m2, p, width, proc_rank, num_procs);
+        else
+            my_err = gaussian_elimination_naive_inplace_mpi(work, width, proc_rank, num_procs);
+        double local = MPI_Wtime() - start;
+        PERF_KERNEL_END(opts->kernel);
+        MPI_Reduce(&local, elapsed, 1, MPI_DOUBLE, MPI_MAX, 0, MPI_COMM_WORLD);
+    }
+    else if (proc_rank == 0)
+    {
+        PERF_KERNEL_BEGIN();
+        start = omp_get_wtime();
+        if (is_matmul)
+            my_err = method->omp(m1, m2, p, (uint32_t) width);
+        else
+            my_err = strcmp(opts->method, "persistent")
+                ? gaussian_elimination_naive_inplace_omp(work, (uint32_t) width)
+                : gaussian_elimination_persistent_omp(work, (uint32_t) width);
+        *elapsed = omp_get_wtime() - start;
+        PERF_KERNEL_END(opts->kernel);
+    }
+    return my_err;
+}
+
+
+static void
+report(const bench_opts_t *opts, int width, int threads, int num_procs,
+        double *times)
+{
+    const int n = opts->reps;
+    qsort(times, n, sizeof(double), compare_doubles);
+    double mean = 0.0l, var = 0.0l;
+    for (int i = 0; i < n; i++)
+        mean += times[i];
+    mean /= n;
+    for (int i = 0; i < n; i++)
+        var += (times[i] - mean) * (times[i] - mean);
+    const double stddev = n > 1 ? sqrt(var / (n - 1)) : 0.0l;
+    const double median = (n % 2) ? times[n/2] : 0.5 * (times[n/2 - 1] + times[n/2]);
+
+    // flops and the minimum traffic (every operand read once,
+    // the result written once) of the kernel
+    const double w = (double) width;
+    const int is_matmul = !strcmp(opts->kernel, "matmul");
+    const double flops = is_matmul ? 2.0 * w * w * w : 2.0 * w * w * w / 3.0;
+    const double bytes = (is_matmul ? 3.0 : 2.0) * w * w * sizeof(double);
+    const double gflops = flops / times[0] * 1.0e-9;
+    const double gbps = bytes / times[0] * 1.0e-9;
+
+    if (!strcmp(opts->format, "json"))
+    {
+        printf("{\"backend\": \"%s\", \"kernel\": \"%s\", \"method\": \"%s\", "
+                "\"width\": %d, \"threads\": %d, \"ranks\": %d, \"reps\": %d, "
+                "\"warmup\": %d, \"min\": %.9e, \"median\": %.9e, \"mean\": %.9e, "
+                "\"stddev\": %.9e, \"gflops\": %.6f, \"gbytes_per_s\": %.6f}\n",
+                opts->backend, opts->kernel, opts->method, width, threads,
+                num_procs, n, opts->warmup, times[0], median, mean, stddev,
+                gflops, gbps);
+    }
+    else
+    {
+        if (opts->header)
+            printf("backend,kernel,method,width,threads,ranks,reps,warmup,"
+                    "min,median,mean,stddev,gflops,gbytes_per_s\n");
+        printf("%s,%s,%s,%d,%d,%d,%d,%d,%.9e,%.9e,%.9e,%.9e,%.6f,%.6f\n",
+                opts->backend, opts->kernel, opts->method, width, threads,
+                num_procs, n, opts->warmup, times[0], median, mean, stddev,
+                gflops, gbps);
+    }
+}
+
+
+static int
+parse_args(int argc, char *argv[], bench_opts_t *opts)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "b:k:m:w:t:n:x:s:i:l:r:f:p:T:M:N")) != -1)
+    {
+        switch (opt)
+        {
+            case 'b': opts->backend = optarg; break;
+            case 'k': opts->kernel = optarg; break;
+            case 'm': opts->method = optarg; break;
+            case 'w': opts->width = (int) strtol(optarg, NULL, 10); break;
+            case 't': opts->threads = (int) strtol(optarg, NULL, 10); break;
+            case 'n': opts->reps = (int) strtol(optarg, NULL, 10); break;
+            case 'x': opts->warmup = (int) strtol(optarg, NULL, 10); break;
+            case 's': opts->seed = strtoul(optarg, NULL, 10); break;
+            case 'i': opts->input = optarg; break;
+            case 'l': opts->left = optarg; break;
+            case 'r': opts->right = optarg; break;
+            case 'f': opts->format = optarg; break;
+            case 'p': opts->placement = optarg; break;
+            case 'T': bench_tile = (uint32_t) strtoul(optarg, NULL, 10); break;
+            case 'M': bench_ooc_memory = (size_t) strtoul(optarg, NULL, 10) << 20; break;
+            case 'N': opts->header = 0; break;
+            default: return -1;
+        }
+    }
+    check(!strcmp(opts->backend, "omp") || !strcmp(opts->backend, "mpi"),
+            "Unknown backend %s", opts->backend);
+    check(!strcmp(opts->kernel, "matmul") || !strcmp(opts->kernel, "elim"),
+            "Unknown kernel %s", opts->kernel);
+    check(!strcmp(opts->format, "csv") || !strcmp(opts->format, "json"),
+            "Unknown output format %s", opts->format);
+    check(!strcmp(opts->placement, "touch") || !strcmp(opts->placement, "interleave")
+            || !strcmp(opts->placement, "malloc"), "Unknown placement %s", opts->placement);
+    check(bench_tile > 0, "Tile size must be positive");
+    check(opts->reps > 0, "Need at least one repetition");
+    check(opts->warmup >= 0, "Negative number of warmup runs");
+    return 0;
+error:
+    return -1;
+}
+
+
+static const bench_method_t *
+find_method(const char *name, const char *backend)
+{
+    const int use_mpi = !strcmp(backend, "mpi");
+    char *end;
+    long index = strtol(name, &end, 10);
+    for (int i = 0; i < num_bench_methods; i++)
+    {
+        const bench_method_t *m = bench_methods + i;
+        if ((*end == '\0' && index == i) || !strcmp(name, m->name))
+            return (use_mpi ? m->mpi != NULL : m->omp != NULL) ? m : NULL;
+    }
+    return NULL;
+}
+
+
+int main(int argc, char *argv[])
+{
+    double *m1 = NULL, *m2 = NULL, *p = NULL, *work = NULL, *times = NULL;
+    int proc_rank = 0, num_procs = 1, width = 0, mpi_init_flag;
+    bench_opts_t opts = {
+        .backend = "omp", .kernel = "matmul", .method = "transpose",
+        .format = "csv", .input = NULL, .left = NULL, .right = NULL,
+        .placement = "touch",
+        .width = 0, .threads = 0, .reps = 5, .warmup = 1, .header = 1,
+        .seed = 1,
+    };
+
+    int mpi_err = MPI_Init(&argc, &argv);
+    check(!mpi_err, "MPI failed to initialize.");
+    MPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+    MPI_Comm_rank(MPI_COMM_WORLD, &proc_rank);
+    PERF_SET_RANK(proc_rank);
+    TRACE_SYNC_MPI(proc_rank, num_procs);
+
+    // every process parses the same command line
+    check(!parse_args(argc, argv, &opts), "Invalid arguments");
+    const bench_method_t *method = find_method(opts.method, opts.backend);
+    check(method || strcmp(opts.kernel, "matmul"),
+            "No %s method called %s", opts.backend, opts.method);
+    // the elimination has the naive and, with OpenMP, the persistent kernel
+    if (strcmp(opts.kernel, "matmul"))
+        opts.method = strcmp(opts.method, "persistent") || strcmp(opts.backend, "omp")
+            ? "naive" : "persistent";
+    else
+        opts.method = method->name;
+    if (opts.threads > 0)
+        omp_set_num_threads(opts.threads);
+    const int threads = omp_get_max_threads();
+    if (!strcmp(opts.backend, "omp") && proc_rank == 0)
+        numa_check_binding_omp();
+    if (!strcmp(opts.backend, "omp") && num_procs > 1 && proc_rank == 0)
+        log_warn("OpenMP backend only runs on process 0 of %d", num_procs);
+
+    if (proc_rank == 0)
+    {
+        check(!load_inputs(&opts, &width, &m1, &m2), "Could not set up inputs");
+        p = numa_alloc_matrix_omp(width, placement_policy(&opts));
+        check_mem(p);
+        work = numa_alloc_matrix_omp(width, placement_policy(&opts));
+        check_mem(work);
+        times = (double *) malloc(opts.reps * sizeof(double));
+        check_mem(times);
+    }
+    mpi_err = MPI_Bcast(&width, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Broadcasting width failed");
+    check(width > 0, "No valid input");
+
+    for (int i = 0; i < opts.warmup + opts.reps; i++)
+    {
+        double elapsed = 0.0l;
+        int my_err = run_once(&opts, method, m1, m2, p, work, width,
+                proc_rank, num_procs, &elapsed);
+        check(!my_err, "Kernel returned with error");
+        if (proc_rank == 0 && i >= opts.warmup)
+            times[i - opts.warmup] = elapsed;
+    }
+
+    if (proc_rank == 0)
+    {
+        report(&opts, width, threads, num_procs, times);
+        ooc_cleanup();
+        free(m1); free(m2); free(p); free(work); free(times);
+    }
+    mat_scratch_release();
+    TRACE_DUMP_MPI(proc_rank, num_procs);
+    MPI_Finalize();
+    return EXIT_SUCCESS;
+error:
+    ooc_cleanup();
+    if (m1) free(m1);
+    if (m2) free(m2);
+    if (p) free(p);
+    if (work) free(work);
+    if (times) free(times);
+    mat_scratch_release();
+    mpi_err = MPI_Initialized(&mpi_init_flag);
+    if (!mpi_err && mpi_init_flag)
+        MPI_Abort(MPI_COMM_WORLD, EXIT_FAILURE);
+    return EXIT_FAILURE;
+}
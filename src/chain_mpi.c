@@ -0,0 +1,226 @@
+#include "dbg.h"
+#include "chain.h"
+#include "matalloc.h"
+
+#include <limits.h>
+#include <mpi.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* The chain on MPI communicators. Process 0 of a communicator holds
+ * the operands and the result of every product on it: the rows of the
+ * left operand are scattered from it in place and the right operand
+ * broadcast, and the rows of the result gathered back in place. The
+ * two halves of a concurrent subchain go to the two parts of a split
+ * of the communicator, the matrices of the right half are sent to its
+ * first process and its result back to process 0. */
+
+
+static size_t
+result_size(const uint32_t *dims, uint32_t i, uint32_t j)
+{
+    return (size_t) dims[i] * dims[j + 1];
+}
+
+
+// C = A B with the rows split between the processes of comm
+static int
+product_mpi(const double *A, const double *B, double *C,
+        uint32_t m, uint32_t k, uint32_t n, MPI_Comm comm)
+{
+    int rank, size, mpi_err;
+    mpi_err = MPI_Comm_rank(comm, &rank);
+    check(!mpi_err, "MPI_Comm_rank returned with error");
+    mpi_err = MPI_Comm_size(comm, &size);
+    check(!mpi_err, "MPI_Comm_size returned with error");
+    if (size == 1)
+        return matmul_rect_omp(A, B, C, m, k, n);
+    check((size_t) m * k <= INT_MAX && (size_t) k * n <= INT_MAX
+            && (size_t) m * n <= INT_MAX, "A %u x %u times %u x %u product is too large",
+            m, k, k, n);
+
+    // rows of A, their offsets, rows of C and their offsets
+    int *counts = (int *) mat_scratch(SCRATCH_COUNTS, 4 * (size_t) size * sizeof(int));
+    check_mem(counts);
+    int *A_counts = counts, *A_displs = counts + size;
+    int *C_counts = counts + 2 * size, *C_displs = counts + 3 * size;
+    const uint32_t base = m / size, extra = m % size;
+    for (int p = 0; p < size; p++)
+    {
+        const uint32_t first = p * base + ((uint32_t) p < extra ? (uint32_t) p : extra);
+        const uint32_t rows = base + ((uint32_t) p < extra);
+        A_counts[p] = (int) (rows * k);
+        A_displs[p] = (int) (first * k);
+        C_counts[p] = (int) (rows * n);
+        C_displs[p] = (int) (first * n);
+    }
+    const uint32_t my_rows = base + ((uint32_t) rank < extra);
+
+    // process 0 keeps its rows, the first ones, where they are
+    double *A_local = (double *) A, *B_local = (double *) B, *C_local = C;
+    if (rank != 0)
+    {
+        A_local = (double *) mat_scratch(SCRATCH_RECV, (size_t) A_counts[rank] * sizeof(double));
+        check_mem(A_local);
+        B_local = (double *) mat_scratch(SCRATCH_OPERAND, (size_t) k * n * sizeof(double));
+        check_mem(B_local);
+        C_local = (double *) mat_scratch(SCRATCH_SEND, (size_t) C_counts[rank] * sizeof(double));
+        check_mem(C_local);
+    }
+    mpi_err = MPI_Scatterv(A, A_counts, A_displs, MPI_DOUBLE,
+            rank == 0 ? MPI_IN_PLACE : A_local, A_counts[rank], MPI_DOUBLE, 0, comm);
+    check(!mpi_err, "Scattering the left operand failed");
+    mpi_err = MPI_Bcast(B_local, (int) (k * n), MPI_DOUBLE, 0, comm);
+    check(!mpi_err, "Broadcasting the right operand failed");
+    if (my_rows > 0)
+        check(!matmul_rect_omp(A_local, B_local, C_local, my_rows, k, n), "Local product failed");
+    mpi_err = MPI_Gatherv(rank == 0 ? MPI_IN_PLACE : C_local, C_counts[rank], MPI_DOUBLE,
+            C, C_counts, C_displs, MPI_DOUBLE, 0, comm);
+    check(!mpi_err, "Gathering the product failed");
+    return 0;
+error:
+    return -1;
+}
+
+
+static int
+evaluate_mpi(const chain_plan_t *plan, const double *const *M, double *W,
+        uint32_t i, uint32_t j, double *out, MPI_Comm comm)
+{
+    const double **shipped = NULL;
+    double *received = NULL;
+    MPI_Comm half = MPI_COMM_NULL;
+    int rank, size, mpi_err;
+    mpi_err = MPI_Comm_rank(comm, &rank);
+    check(!mpi_err, "MPI_Comm_rank returned with error");
+    mpi_err = MPI_Comm_size(comm, &size);
+    check(!mpi_err, "MPI_Comm_size returned with error");
+
+    const uint32_t count = plan->count, at = i*count + j, k = plan->split[at];
+    const uint32_t left = i*count + k, right = (k + 1)*count + j;
+    double *L = W + plan->offset[left], *R = W + plan->offset[right];
+    if (plan->concurrent[at] && size > 1)
+    {
+        // processes by the flops of each half, at least one each
+        const double share = plan->flops[left] / (plan->flops[left] + plan->flops[right]);
+        int left_procs = (int) (share * size + 0.5l);
+        left_procs = left_procs < 1 ? 1 : (left_procs > size - 1 ? size - 1 : left_procs);
+        const int in_left = rank < left_procs;
+        mpi_err = MPI_Comm_split(comm, !in_left, rank, &half);
+        check(!mpi_err, "Splitting the communicator failed");
+
+        if (rank == 0)
+        {
+            for (uint32_t p = k + 1; p <= j; p++)
+            {
+                mpi_err = MPI_Send(M[p], (int) result_size(plan->dims, p, p), MPI_DOUBLE,
+                        left_procs, (int) p, comm);
+                check(!mpi_err, "Sending matrix %u failed", p);
+            }
+        }
+        else if (rank == left_procs)
+        {
+            size_t total = 0;
+            for (uint32_t p = k + 1; p <= j; p++)
+                total += result_size(plan->dims, p, p);
+            received = (double *) malloc(total * sizeof(double));
+            check_mem(received);
+            shipped = (const double **) calloc(count, sizeof(double *));
+            check_mem(shipped);
+            for (uint32_t p = k + 1, from = 0; p <= j; from += result_size(plan->dims, p, p), p++)
+            {
+                shipped[p] = received + from;
+                mpi_err = MPI_Recv(received + from, (int) result_size(plan->dims, p, p),
+                        MPI_DOUBLE, 0, (int) p, comm, MPI_STATUS_IGNORE);
+                check(!mpi_err, "Receiving matrix %u failed", p);
+            }
+        }
+
+        if (in_left)
+        {
+            check(!evaluate_mpi(plan, M, W, i, k, L, half), "Left half failed");
+        }
+        else
+        {
+            check(!evaluate_mpi(plan, shipped, W, k + 1, j, R, half), "Right half failed");
+        }
+        MPI_Comm_free(&half);
+
+        const int result_count = (int) result_size(plan->dims, k + 1, j);
+        if (rank == left_procs)
+        {
+            mpi_err = MPI_Send(R, result_count, MPI_DOUBLE, 0, (int) count, comm);
+            check(!mpi_err, "Sending the right half failed");
+        }
+        else if (rank == 0)
+        {
+            mpi_err = MPI_Recv(R, result_count, MPI_DOUBLE, left_procs, (int) count, comm,
+                    MPI_STATUS_IGNORE);
+            check(!mpi_err, "Receiving the right half failed");
+        }
+    }
+    else
+    {
+        if (k > i)
+            check(!evaluate_mpi(plan, M, W, i, k, L, comm), "Left half failed");
+        if (j > k + 1)
+            check(!evaluate_mpi(plan, M, W, k + 1, j, R, comm), "Right half failed");
+    }
+
+    // only process 0 reads the operands
+    const double *A = NULL, *B = NULL;
+    if (rank == 0)
+    {
+        A = k > i ? L : M[i];
+        B = j > k + 1 ? R : M[k + 1];
+    }
+    check(!product_mpi(A, B, out, plan->dims[i], plan->dims[k + 1], plan->dims[j + 1], comm),
+            "Product of %u..%u failed", i, j);
+    if (received)
+        free(received);
+    if (shipped)
+        free(shipped);
+    return 0;
+error:
+    if (half != MPI_COMM_NULL)
+        MPI_Comm_free(&half);
+    if (received)
+        free(received);
+    if (shipped)
+        free(shipped);
+    return -1;
+}
+
+
+int
+matmul_chain_mpi(const chain_plan_t *plan, const double *const *M, double *P,
+        int proc_rank, int num_procs)
+{
+    check_mem(plan);
+    check(plan->count > 0 && plan->split, "Not a plan");
+    check(proc_rank >= 0 && proc_rank < num_procs, "Bad rank %d of %d", proc_rank, num_procs);
+    const uint32_t count = plan->count;
+    if (proc_rank == 0)
+    {
+        check_mem(M); check_mem(P);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            check(M[i], "Matrix %u of the chain is NULL", i);
+            check(result_size(plan->dims, i, i) <= INT_MAX, "Matrix %u is too large", i);
+        }
+        if (count == 1)
+            memcpy(P, M[0], result_size(plan->dims, 0, 0) * sizeof(double));
+    }
+    if (count == 1)
+        return 0;
+
+    // every process has the workspace, any may hold a half's results
+    double *W = (double *) mat_scratch(SCRATCH_CHAIN, plan->workspace * sizeof(double));
+    check_mem(W);
+    check(!evaluate_mpi(plan, M, W, 0, count - 1, P, MPI_COMM_WORLD), "Chain product failed");
+    return 0;
+error:
+    return -1;
+}
@@ -0,0 +1,337 @@
+#include "dbg.h"
+#include "chain.h"
+#include "matalloc.h"
+
+#include <omp.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+// flops of the rows handed to one task of a product
+#define CHAIN_GRAIN_FLOPS (1u << 18)
+
+// a placed result that is still read, or pinned by a concurrent half
+#define SLOT_LIVE 1
+#define SLOT_PINNED 2
+
+typedef struct {
+    chain_plan_t *plan;
+    uint8_t *state;         // per subchain, SLOT_LIVE | SLOT_PINNED
+    uint32_t *placed;       // the subchains placed so far, in order
+    uint32_t num_placed;
+} layout_t;
+
+
+static size_t
+result_size(const uint32_t *dims, uint32_t i, uint32_t j)
+{
+    return (size_t) dims[i] * dims[j + 1];
+}
+
+
+// the lowest offset where size doubles overlap no live or pinned result
+static size_t
+first_fit(const layout_t *L, size_t size)
+{
+    const size_t *offset = L->plan->offset;
+    size_t best = SIZE_MAX;
+    for (uint32_t c = 0; c <= L->num_placed; c++)
+    {
+        // the candidates are 0 and the end of every placed result
+        size_t at = 0;
+        if (c > 0)
+        {
+            const uint32_t node = L->placed[c - 1];
+            if (!L->state[node])
+                continue;
+            const uint32_t i = node / L->plan->count, j = node % L->plan->count;
+            at = offset[node] + result_size(L->plan->dims, i, j);
+        }
+        int fits = at < best;
+        for (uint32_t p = 0; fits && p < L->num_placed; p++)
+        {
+            const uint32_t node = L->placed[p];
+            const uint32_t i = node / L->plan->count, j = node % L->plan->count;
+            fits = !L->state[node] || offset[node] >= at + size
+                || offset[node] + result_size(L->plan->dims, i, j) <= at;
+        }
+        if (fits)
+            best = at;
+    }
+    return best;
+}
+
+
+// replays the evaluation of i..j, placing the results as they are made
+static void
+layout(layout_t *L, uint32_t i, uint32_t j)
+{
+    chain_plan_t *plan = L->plan;
+    const uint32_t count = plan->count, at = i*count + j, k = plan->split[at];
+    const uint32_t left = i*count + k, right = (k + 1)*count + j;
+    if (plan->concurrent[at])
+    {
+        // the right half may run at any time during the left one
+        const uint32_t from = L->num_placed;
+        layout(L, i, k);
+        const uint32_t to = L->num_placed;
+        for (uint32_t p = from; p < to; p++)
+            L->state[L->placed[p]] |= SLOT_PINNED;
+        layout(L, k + 1, j);
+        for (uint32_t p = from; p < to; p++)
+            L->state[L->placed[p]] &= ~SLOT_PINNED;
+    }
+    else
+    {
+        if (k > i)
+            layout(L, i, k);
+        if (j > k + 1)
+            layout(L, k + 1, j);
+    }
+    // the whole chain goes to P
+    if (i > 0 || j + 1 < count)
+    {
+        const size_t size = result_size(plan->dims, i, j);
+        plan->offset[at] = first_fit(L, size);
+        if (plan->offset[at] + size > plan->workspace)
+            plan->workspace = plan->offset[at] + size;
+        L->state[at] = SLOT_LIVE;
+        L->placed[L->num_placed++] = at;
+    }
+    L->state[left] &= ~SLOT_LIVE;
+    L->state[right] &= ~SLOT_LIVE;
+}
+
+
+static int
+plan_build(chain_plan_t *plan, const uint32_t *dims, uint32_t count,
+        double byte_weight, int left_only)
+{
+    double *cost = NULL;
+    size_t *need = NULL;
+    layout_t L = {0};
+    check_mem(plan);
+    *plan = (chain_plan_t) {.count = count};
+    check_mem(dims);
+    check(count > 0, "Empty chain");
+    const size_t nodes = (size_t) count * count;
+
+    plan->dims = (uint32_t *) malloc(((size_t) count + 1) * sizeof(uint32_t));
+    check_mem(plan->dims);
+    for (uint32_t i = 0; i <= count; i++)
+    {
+        check(dims[i] > 0, "Dimension %u is zero", i);
+        plan->dims[i] = dims[i];
+    }
+    plan->split = (uint32_t *) calloc(nodes, sizeof(uint32_t));
+    check_mem(plan->split);
+    plan->flops = (double *) calloc(nodes, sizeof(double));
+    check_mem(plan->flops);
+    plan->concurrent = (uint8_t *) calloc(nodes, sizeof(uint8_t));
+    check_mem(plan->concurrent);
+    plan->offset = (size_t *) calloc(nodes, sizeof(size_t));
+    check_mem(plan->offset);
+    cost = (double *) calloc(nodes, sizeof(double));
+    check_mem(cost);
+    need = (size_t *) calloc(nodes, sizeof(size_t));
+    check_mem(need);
+
+    // subchains by length, each from its cheapest split
+    for (uint32_t len = 2; len <= count; len++)
+    {
+        for (uint32_t i = 0; i + len <= count; i++)
+        {
+            const uint32_t j = i + len - 1, at = i*count + j;
+            const uint32_t first = left_only ? j - 1 : i;
+            for (uint32_t k = first; k < j; k++)
+            {
+                const uint32_t left = i*count + k, right = (k + 1)*count + j;
+                const size_t size_l = k > i ? result_size(dims, i, k) : 0;
+                const size_t size_r = j > k + 1 ? result_size(dims, k + 1, j) : 0;
+                const double flops = plan->flops[left] + plan->flops[right]
+                    + 2.0l * dims[i] * dims[k + 1] * dims[j + 1];
+                const int concurrent = size_l && size_r
+                    && plan->flops[left] >= CHAIN_TASK_FLOPS
+                    && plan->flops[right] >= CHAIN_TASK_FLOPS;
+                // both halves at once, or the left one first with its
+                // scratch over the slot of the right one
+                size_t bytes = size_l + size_r + need[right];
+                if (concurrent)
+                    bytes += need[left];
+                else if (size_l + need[left] > bytes)
+                    bytes = size_l + need[left];
+                const double c = flops + byte_weight * (double) (bytes * sizeof(double));
+                if (k == first || c < cost[at] || (c == cost[at] && bytes < need[at]))
+                {
+                    cost[at] = c;
+                    need[at] = bytes;
+                    plan->split[at] = k;
+                    plan->flops[at] = flops;
+                    plan->concurrent[at] = (uint8_t) concurrent;
+                }
+            }
+        }
+    }
+
+    if (count > 1)
+    {
+        L.plan = plan;
+        L.state = (uint8_t *) calloc(nodes, sizeof(uint8_t));
+        check_mem(L.state);
+        L.placed = (uint32_t *) malloc((size_t) count * sizeof(uint32_t));
+        check_mem(L.placed);
+        layout(&L, 0, count - 1);
+        free(L.state);
+        free(L.placed);
+    }
+    free(cost);
+    free(need);
+    return 0;
+error:
+    if (cost)
+        free(cost);
+    if (need)
+        free(need);
+    if (L.state)
+        free(L.state);
+    if (L.placed)
+        free(L.placed);
+    chain_plan_free(plan);
+    return -1;
+}
+
+
+int
+chain_plan(chain_plan_t *plan, const uint32_t *dims, uint32_t count,
+        double byte_weight)
+{
+    return plan_build(plan, dims, count, byte_weight, 0);
+}
+
+
+int
+chain_plan_left(chain_plan_t *plan, const uint32_t *dims, uint32_t count)
+{
+    return plan_build(plan, dims, count, 0.0l, 1);
+}
+
+
+void
+chain_plan_free(chain_plan_t *plan)
+{
+    if (!plan)
+        return;
+    if (plan->dims)
+        free(plan->dims);
+    if (plan->split)
+        free(plan->split);
+    if (plan->flops)
+        free(plan->flops);
+    if (plan->concurrent)
+        free(plan->concurrent);
+    if (plan->offset)
+        free(plan->offset);
+    *plan = (chain_plan_t) {0};
+}
+
+
+// rows of C = A B, streaming along the rows of B and C
+static void
+product_rows(const double *restrict A, const double *restrict B, double *restrict C,
+        uint32_t rows, uint32_t k, uint32_t n)
+{
+    for (uint32_t row = 0; row < rows; row++)
+    {
+        double *c = C + (size_t) row * n;
+        for (uint32_t col = 0; col < n; col++)
+            c[col] = 0.0l;
+        for (uint32_t i = 0; i < k; i++)
+        {
+            const double a = A[(size_t) row * k + i];
+            const double *b = B + (size_t) i * n;
+#           pragma omp simd
+            for (uint32_t col = 0; col < n; col++)
+                c[col] += a * b[col];
+        }
+    }
+}
+
+
+int
+matmul_rect_omp(const double *A, const double *B, double *C,
+        uint32_t m, uint32_t k, uint32_t n)
+{
+    check_mem(A); check_mem(B); check_mem(C);
+    check(m > 0 && k > 0 && n > 0, "Empty %u x %u times %u x %u product", m, k, k, n);
+#   pragma omp parallel for schedule(static)
+    for (uint32_t row = 0; row < m; row++)
+        product_rows(A + (size_t) row * k, B, C + (size_t) row * n, 1, k, n);
+    return 0;
+error:
+    return -1;
+}
+
+
+// a product inside the chain's tasks, its rows as tasks of their own
+static void
+product_tasks(const double *A, const double *B, double *C,
+        uint32_t m, uint32_t k, uint32_t n)
+{
+    const uint64_t row_flops = 2 * (uint64_t) k * n;
+    const uint32_t grain = row_flops >= CHAIN_GRAIN_FLOPS
+        ? 1 : (uint32_t) (CHAIN_GRAIN_FLOPS / row_flops);
+#   pragma omp taskloop grainsize(grain)
+    for (uint32_t row = 0; row < m; row++)
+        product_rows(A + (size_t) row * k, B, C + (size_t) row * n, 1, k, n);
+}
+
+
+static void
+evaluate_omp(const chain_plan_t *plan, const double *const *M, double *W,
+        uint32_t i, uint32_t j, double *out)
+{
+    const uint32_t count = plan->count, at = i*count + j, k = plan->split[at];
+    double *L = W + plan->offset[i*count + k], *R = W + plan->offset[(k + 1)*count + j];
+    if (plan->concurrent[at])
+    {
+#       pragma omp task
+        evaluate_omp(plan, M, W, i, k, L);
+        evaluate_omp(plan, M, W, k + 1, j, R);
+#       pragma omp taskwait
+    }
+    else
+    {
+        if (k > i)
+            evaluate_omp(plan, M, W, i, k, L);
+        if (j > k + 1)
+            evaluate_omp(plan, M, W, k + 1, j, R);
+    }
+    product_tasks(k > i ? L : M[i], j > k + 1 ? R : M[k + 1], out,
+            plan->dims[i], plan->dims[k + 1], plan->dims[j + 1]);
+}
+
+
+int
+matmul_chain_omp(const chain_plan_t *plan, const double *const *M, double *P)
+{
+    check_mem(plan); check_mem(M); check_mem(P);
+    check(plan->count > 0 && plan->split, "Not a plan");
+    const uint32_t count = plan->count;
+    for (uint32_t i = 0; i < count; i++)
+        check(M[i], "Matrix %u of the chain is NULL", i);
+    if (count == 1)
+    {
+        memcpy(P, M[0], result_size(plan->dims, 0, 0) * sizeof(double));
+        return 0;
+    }
+
+    double *W = (double *) mat_scratch(SCRATCH_CHAIN, plan->workspace * sizeof(double));
+    check_mem(W);
+#   pragma omp parallel
+#   pragma omp single
+    evaluate_omp(plan, M, W, 0, count - 1, P);
+    return 0;
+error:
+    return -1;
+}
@@ -0,0 +1,135 @@
+#include "dbg.h"
+#include "matgen.h"
+
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* Test matrix generator, see include/matgen.h.
+ *
+ *   gen.out -w width [-k uniform|dominant|spectrum] [-c cond] [-s seed]
+ *           [-i id] [-l low] [-u high] [-f bin|text] [-n count]
+ *           [-M megabytes] [-o path]
+ *
+ * -f bin (default) writes matrix -i of seed -s as a binary matrix file
+ * (include/ooc.h) to -o, the threads writing panels of rows of about
+ * -M megabytes in all. -f text writes the width and then -n matrices
+ * (default 2, ids -i on) to -o or stdout, which is the input of the
+ * drivers without the reference product they no longer read. The
+ * same seed and ids give the same matrices on any number of threads. */
+
+typedef struct {
+    uint32_t width;
+    const char *kind;
+    double cond;
+    uint64_t seed;
+    uint32_t id;
+    double low;
+    double high;
+    const char *format;
+    int count;
+    size_t memory;
+    const char *path;
+} gen_opts_t;
+
+
+static int
+parse_args(int argc, char *argv[], gen_opts_t *opts)
+{
+    int opt;
+    while ((opt = getopt(argc, argv, "w:k:c:s:i:l:u:f:n:M:o:")) != -1)
+    {
+        switch (opt)
+        {
+            case 'w': opts->width = (uint32_t) strtoul(optarg, NULL, 10); break;
+            case 'k': opts->kind = optarg; break;
+            case 'c': opts->cond = strtod(optarg, NULL); break;
+            case 's': opts->seed = strtoull(optarg, NULL, 10); break;
+            case 'i': opts->id = (uint32_t) strtoul(optarg, NULL, 10); break;
+            case 'l': opts->low = strtod(optarg, NULL); break;
+            case 'u': opts->high = strtod(optarg, NULL); break;
+            case 'f': opts->format = optarg; break;
+            case 'n': opts->count = (int) strtol(optarg, NULL, 10); break;
+            case 'M': opts->memory = (size_t) strtoul(optarg, NULL, 10) << 20; break;
+            case 'o': opts->path = optarg; break;
+            default: return -1;
+        }
+    }
+    check(opts->width > 0, "Need a positive width (-w)");
+    check(!strcmp(opts->format, "bin") || !strcmp(opts->format, "text"),
+            "Unknown output format %s", opts->format);
+    check(strcmp(opts->format, "bin") || opts->path, "Binary output needs a path (-o)");
+    check(opts->count > 0, "Need at least one matrix");
+    return 0;
+error:
+    return -1;
+}
+
+
+static int
+parse_kind(const char *name, matgen_kind_t *kind)
+{
+    if (!strcmp(name, "uniform"))
+        *kind = MATGEN_UNIFORM;
+    else if (!strcmp(name, "dominant"))
+        *kind = MATGEN_DOMINANT;
+    else if (!strcmp(name, "spectrum"))
+        *kind = MATGEN_SPECTRUM;
+    else
+        return -1;
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    matgen_t G = {0};
+    FILE *file = NULL;
+    matgen_kind_t kind;
+    gen_opts_t opts = {
+        .width = 0, .kind = "dominant", .cond = 100.0l, .seed = 1, .id = 0,
+        .low = 0.0l, .high = 1.0l, .format = "bin", .count = 2,
+        .memory = (size_t) 256 << 20, .path = NULL,
+    };
+
+    check(!parse_args(argc, argv, &opts), "Invalid arguments");
+    check(!parse_kind(opts.kind, &kind), "Unknown kind %s", opts.kind);
+
+    double start_time = omp_get_wtime();
+    if (!strcmp(opts.format, "bin"))
+    {
+        check(!matgen_init(&G, kind, opts.width, opts.seed, opts.id, opts.cond,
+                    opts.low, opts.high), "Bad generator settings");
+        check(!matgen_write_omp(&G, opts.path, opts.memory), "Could not write %s", opts.path);
+        matgen_free(&G);
+    }
+    else
+    {
+        file = opts.path && strcmp(opts.path, "-") ? fopen(opts.path, "w") : stdout;
+        check(file, "Could not open %s", opts.path);
+        check(fprintf(file, "%u\n", opts.width) > 0, "Could not write the width");
+        for (int i = 0; i < opts.count; i++)
+        {
+            check(!matgen_init(&G, kind, opts.width, opts.seed, opts.id + i, opts.cond,
+                        opts.low, opts.high), "Bad generator settings");
+            check(!matgen_write_text_omp(&G, file), "Could not write matrix %d", i);
+            matgen_free(&G);
+        }
+        if (file != stdout)
+            check(!fclose(file), "Could not close %s", opts.path);
+        file = NULL;
+    }
+    double end_time = omp_get_wtime();
+
+    // width threads seconds
+    fprintf(stderr, "%u %d %lf\n", opts.width, omp_get_max_threads(), end_time - start_time);
+    return 0;
+error:
+    matgen_free(&G);
+    if (file && file != stdout)
+        fclose(file);
+    return -1;
+}
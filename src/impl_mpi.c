@@ -1,8 +1,14 @@
 #include "dbg.h"
 #include "impl_mpi.h"
+#include "matalloc.h"
+#include "transpose.h"
+#include "trace.h"
 
+#include <float.h>
+#include <math.h>
 #include <mpi.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define NOT_IMPLEMENTED 30
 
@@ -34,15 +40,16 @@ matMulSquare_baseline_mpi(const double *M_1, double *M_2,
     // all processes will need a copy of process 2
     if (proc_rank != 0)
     {
-        M_2 = (double *)malloc(mat_size * sizeof(double));
+        M_2 = (double *) mat_scratch(SCRATCH_OPERAND, mat_size * sizeof(double));
         check_mem(M_2);
     }
 
     MPI_Bcast(M_2, mat_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
     // send_counts for scatter_v
-    int *send_counts = (int *)malloc(num_procs * sizeof(int));
-    int *displacements = (int *)malloc(num_procs * sizeof(int));
+    int *send_counts = (int *) mat_scratch(SCRATCH_COUNTS, 2 * num_procs * sizeof(int));
+    check_mem(send_counts);
+    int *displacements = send_counts + num_procs;
     displacements[0] = 0;
 
     for (int i = 0; i < num_procs-1; i++)
@@ -60,10 +67,10 @@ matMulSquare_baseline_mpi(const double *M_1, double *M_2,
     }
 
     double *recv_buf = NULL, *send_buf = NULL;  
-    recv_buf = (double *)malloc(num_elements_per_proc * sizeof(double));
-    check_mem(recv_buf);
-    send_buf = (double *)malloc(num_elements_per_proc * sizeof(double));
+    recv_buf = (double *) mat_scratch(SCRATCH_RECV, num_elements_per_proc * sizeof(double));
     check_mem(recv_buf);
+    send_buf = (double *) mat_scratch(SCRATCH_SEND, num_elements_per_proc * sizeof(double));
+    check_mem(send_buf);
      
 
     // scattering M_1
@@ -91,19 +98,8 @@ matMulSquare_baseline_mpi(const double *M_1, double *M_2,
             P, send_counts, displacements, MPI_DOUBLE,
             0, MPI_COMM_WORLD);
 
-    free(send_buf);
-    free(recv_buf);
-
-    
-    if (proc_rank != 0)
-    {
-        free(M_2);
-    }
-
     return EXIT_SUCCESS;
 error:
-    if (proc_rank != 0 && M_2)
-        free(M_2);
     return EXIT_FAILURE;
 }
 
@@ -129,7 +125,7 @@ matMulSquare_balanced_mpi(const double *M_1, double *M_2,
     // all processes will need a copy of process M2
     if (proc_rank != 0)
     {
-        M_2 = (double *)malloc(mat_size * sizeof(double));
+        M_2 = (double *) mat_scratch(SCRATCH_OPERAND, mat_size * sizeof(double));
         check_mem(M_2);
     }
 
@@ -137,8 +133,9 @@ matMulSquare_balanced_mpi(const double *M_1, double *M_2,
     MPI_Bcast(M_2, mat_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
     // send_counts for scatter_v
-    int *send_counts = (int *)malloc(num_procs * sizeof(int));
-    int *displacements = (int *)malloc(num_procs * sizeof(int));
+    int *send_counts = (int *) mat_scratch(SCRATCH_COUNTS, 2 * num_procs * sizeof(int));
+    check_mem(send_counts);
+    int *displacements = send_counts + num_procs;
     displacements[0] = 0;
 
     // determine number of rows of M_1 to send to each process
@@ -152,7 +149,7 @@ matMulSquare_balanced_mpi(const double *M_1, double *M_2,
         }
         displacements[i+1] = displacements[i] + send_counts[i];
     }
-    send_counts[num_procs-1] = mat_size / num_procs;
+    send_counts[num_procs-1] = num_elements_per_proc;
 
 #ifndef DNDEBUG
     if (proc_rank == 0)
@@ -166,10 +163,10 @@ matMulSquare_balanced_mpi(const double *M_1, double *M_2,
     
 #endif
     double *recv_buf = NULL, *send_buf = NULL;  
-    recv_buf = (double *)malloc(send_counts[proc_rank] * sizeof(double));
-    check_mem(recv_buf);
-    send_buf = (double *)malloc(send_counts[proc_rank] * sizeof(double));
+    recv_buf = (double *) mat_scratch(SCRATCH_RECV, send_counts[proc_rank] * sizeof(double));
     check_mem(recv_buf);
+    send_buf = (double *) mat_scratch(SCRATCH_SEND, send_counts[proc_rank] * sizeof(double));
+    check_mem(send_buf);
      
 
     // scattering M_1
@@ -200,20 +197,8 @@ matMulSquare_balanced_mpi(const double *M_1, double *M_2,
             0, MPI_COMM_WORLD);
     check(!mpi_err, "MPI_Gatherv returned with error");
 
-    free(send_buf);
-    free(recv_buf);
-
-    
-    if (proc_rank != 0)
-    {
-        free(M_2);
-    }
-    debug_mpi(proc_rank,"All memory resources freed");
-
     return 0;
 error:
-    if (proc_rank != 0 && M_2)
-        free(M_2);
     return EXIT_FAILURE;
 }
 
@@ -239,22 +224,26 @@ matMulSquare_transpose_mpi(const double *M_1, double *M_2,
 
     int num_elements_per_proc = num_rows_per_proc * width;
     
-    double *M_2tr = (double *)malloc(mat_size * sizeof(double)); 
+    // every process transposes its copy, rather than all of them
+    // waiting for process 0 to do it before the broadcast. The others
+    // receive M_2 where its transpose goes and transpose it in place,
+    // so they hold one copy of it as in the baseline
+    double *M_2tr = (double *) mat_scratch(SCRATCH_TRANSPOSE, mat_size * sizeof(double));
+    check_mem(M_2tr);
+    MPI_Bcast(proc_rank == 0 ? M_2 : M_2tr, mat_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
     if (proc_rank == 0)
     {
-        for (int i = 0; i < mat_size; i++)
-        {
-            const int row = i/width;
-            const int col = i%width;
-            M_2tr[col*width + row] = M_2[row*width + col];
-        }
+        check(!transpose_omp(M_2, width, M_2tr, width, width, width), "Transposing M_2 failed");
+    }
+    else
+    {
+        check(!transpose_inplace_omp(M_2tr, width), "Transposing M_2 failed");
     }
-
-    MPI_Bcast(M_2tr, mat_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
     // send_counts for scatter_v
-    int *send_counts = (int *)malloc(num_procs * sizeof(int));
-    int *displacements = (int *)malloc(num_procs * sizeof(int));
+    int *send_counts = (int *) mat_scratch(SCRATCH_COUNTS, 2 * num_procs * sizeof(int));
+    check_mem(send_counts);
+    int *displacements = send_counts + num_procs;
     displacements[0] = 0;
 
     // determine number of rows of M_1 to send to each process
@@ -268,14 +257,14 @@ matMulSquare_transpose_mpi(const double *M_1, double *M_2,
         }
         displacements[i+1] = displacements[i] + send_counts[i];
     }
-    send_counts[num_procs-1] = mat_size / num_procs;
+    send_counts[num_procs-1] = num_elements_per_proc;
 
 
     double *recv_buf = NULL, *send_buf = NULL;  
-    recv_buf = (double *)malloc(send_counts[proc_rank] * sizeof(double));
-    check_mem(recv_buf);
-    send_buf = (double *)malloc(send_counts[proc_rank] * sizeof(double));
+    recv_buf = (double *) mat_scratch(SCRATCH_RECV, send_counts[proc_rank] * sizeof(double));
     check_mem(recv_buf);
+    send_buf = (double *) mat_scratch(SCRATCH_SEND, send_counts[proc_rank] * sizeof(double));
+    check_mem(send_buf);
      
 
     // scattering M_1
@@ -304,14 +293,8 @@ matMulSquare_transpose_mpi(const double *M_1, double *M_2,
             P, send_counts, displacements, MPI_DOUBLE,
             0, MPI_COMM_WORLD);
 
-    free(M_2tr);
-    free(send_buf);
-    free(recv_buf);
-
     return EXIT_SUCCESS;
 error:
-    if (proc_rank != 0 && M_2)
-        free(M_2);
     return EXIT_FAILURE;
 }
 
@@ -337,7 +320,7 @@ matMulSquare_pretranspose_mpi(const double *M_1, double *M_2,
     int num_elements_per_proc = num_rows_per_proc * width;
     if (proc_rank != 0)
     {
-        M_2 = (double *)malloc(mat_size * sizeof(double));
+        M_2 = (double *) mat_scratch(SCRATCH_OPERAND, mat_size * sizeof(double));
         check_mem(M_2);
     }
 
@@ -345,8 +328,9 @@ matMulSquare_pretranspose_mpi(const double *M_1, double *M_2,
     MPI_Bcast(M_2, mat_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
 
     // send_counts for scatter_v
-    int *send_counts = (int *)malloc(num_procs * sizeof(int));
-    int *displacements = (int *)malloc(num_procs * sizeof(int));
+    int *send_counts = (int *) mat_scratch(SCRATCH_COUNTS, 2 * num_procs * sizeof(int));
+    check_mem(send_counts);
+    int *displacements = send_counts + num_procs;
     displacements[0] = 0;
 
     // determine number of rows of M_1 to send to each process
@@ -360,14 +344,14 @@ matMulSquare_pretranspose_mpi(const double *M_1, double *M_2,
         }
         displacements[i+1] = displacements[i] + send_counts[i];
     }
-    send_counts[num_procs-1] = mat_size / num_procs;
+    send_counts[num_procs-1] = num_elements_per_proc;
 
 
     double *recv_buf = NULL, *send_buf = NULL;  
-    recv_buf = (double *)malloc(send_counts[proc_rank] * sizeof(double));
-    check_mem(recv_buf);
-    send_buf = (double *)malloc(send_counts[proc_rank] * sizeof(double));
+    recv_buf = (double *) mat_scratch(SCRATCH_RECV, send_counts[proc_rank] * sizeof(double));
     check_mem(recv_buf);
+    send_buf = (double *) mat_scratch(SCRATCH_SEND, send_counts[proc_rank] * sizeof(double));
+    check_mem(send_buf);
      
 
     // scattering M_1
@@ -396,26 +380,173 @@ matMulSquare_pretranspose_mpi(const double *M_1, double *M_2,
             P, send_counts, displacements, MPI_DOUBLE,
             0, MPI_COMM_WORLD);
 
-    if (proc_rank != 0)
-        free(M_2);
-    free(send_buf);
-    free(recv_buf);
-
     return EXIT_SUCCESS;
 error:
-    if (send_buf)
-        free(send_buf);
-    if (recv_buf)
-        free(recv_buf);
-    if (proc_rank != 0 && M_2)
-        free(M_2);
     return EXIT_FAILURE;
 }
 
 
+// C = A B[:, 0:cols] for rows rows of A, B and C with leading
+// dimensions ldb and ldc, along the rows of B and C
+static void
+panel_product(const double *A, const double *B, double *C, int rows, int width,
+        int cols, int ldb, int ldc)
+{
+    for (int row = 0; row < rows; row++)
+    {
+        double *c = C + (size_t) row * ldc;
+        for (int col = 0; col < cols; col++)
+            c[col] = 0.0l;
+        for (int i = 0; i < width; i++)
+        {
+            const double a = A[(size_t) row * width + i];
+            const double *b = B + (size_t) i * ldb;
+            for (int col = 0; col < cols; col++)
+                c[col] += a * b[col];
+        }
+    }
+}
+
+
 int
-gaussian_elimination_naive_inplace_mpi(double *M, /*double *P,*/ int width,
-        int proc_rank, int num_procs)
+matMulSquare_lowmem_mpi(const double *M_1, double *M_2,
+        double *P, int width,
+        int proc_rank, int num_procs, int panel)
+{
+    MPI_Datatype panel_type = MPI_DATATYPE_NULL, segment = MPI_DATATYPE_NULL;
+    MPI_Datatype row_type = MPI_DATATYPE_NULL;
+    int mpi_err;
+    if (proc_rank == 0)
+    {
+        check_mem(M_1); check_mem(M_2); check_mem(P);
+    }
+    check(width > 0, "Non-positive width %d", width);
+    check(panel >= 0, "Negative panel width %d", panel);
+    if (panel == 0 || panel > width)
+        panel = width;
+
+    // entries and rows of each process with their offsets, the first
+    // rows on process 0 as in the balanced kernel
+    int *send_counts = (int *) mat_scratch(SCRATCH_COUNTS, 4 * num_procs * sizeof(int));
+    check_mem(send_counts);
+    int *displacements = send_counts + num_procs;
+    int *row_counts = send_counts + 2 * num_procs, *row_displs = send_counts + 3 * num_procs;
+    for (int i = 0; i < num_procs; i++)
+    {
+        row_counts[i] = width / num_procs + (i < width % num_procs);
+        row_displs[i] = i == 0 ? 0 : row_displs[i-1] + row_counts[i-1];
+        send_counts[i] = row_counts[i] * width;
+        displacements[i] = row_displs[i] * width;
+    }
+    const int my_rows = row_counts[proc_rank];
+
+    // process 0 keeps its rows of M_1, and of P, where they are
+    double *recv_buf = NULL;
+    if (proc_rank != 0)
+    {
+        recv_buf = (double *) mat_scratch(SCRATCH_RECV, send_counts[proc_rank] * sizeof(double));
+        check_mem(recv_buf);
+    }
+    mpi_err = MPI_Scatterv(M_1, send_counts, displacements, MPI_DOUBLE,
+            proc_rank == 0 ? MPI_IN_PLACE : recv_buf, send_counts[proc_rank], MPI_DOUBLE,
+            0, MPI_COMM_WORLD);
+    check(!mpi_err, "MPI_Scatterv returned with error");
+
+    if (panel == width)
+    {
+        // all of M_2, each row of the product through a one row
+        // temporary back into the storage of its row of M_1
+        if (proc_rank != 0)
+        {
+            M_2 = (double *) mat_scratch(SCRATCH_OPERAND, (size_t) width * width * sizeof(double));
+            check_mem(M_2);
+        }
+        mpi_err = MPI_Bcast(M_2, width * width, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        check(!mpi_err, "MPI_Bcast returned with error");
+        if (proc_rank == 0)
+            panel_product(M_1, M_2, P, my_rows, width, width, width, width);
+        else
+        {
+            double *row_buf = (double *) mat_scratch(SCRATCH_SEND, width * sizeof(double));
+            check_mem(row_buf);
+            for (int row = 0; row < my_rows; row++)
+            {
+                panel_product(recv_buf + (size_t) row * width, M_2, row_buf, 1, width,
+                        width, width, width);
+                memcpy(recv_buf + (size_t) row * width, row_buf, width * sizeof(double));
+            }
+        }
+        mpi_err = MPI_Gatherv(proc_rank == 0 ? MPI_IN_PLACE : recv_buf, send_counts[proc_rank],
+                MPI_DOUBLE, P, send_counts, displacements, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        check(!mpi_err, "MPI_Gatherv returned with error");
+        return EXIT_SUCCESS;
+    }
+
+    // M_2 a panel of columns at a time, sent by process 0 straight out
+    // of M_2 and each panel of the product gathered straight into P
+    double *panel_buf = NULL, *send_buf = NULL;
+    if (proc_rank != 0)
+    {
+        panel_buf = (double *) mat_scratch(SCRATCH_OPERAND, (size_t) width * panel * sizeof(double));
+        check_mem(panel_buf);
+        send_buf = (double *) mat_scratch(SCRATCH_SEND, (size_t) my_rows * panel * sizeof(double));
+        check_mem(send_buf);
+    }
+    for (int col = 0; col < width; col += panel)
+    {
+        const int cols = width - col < panel ? width - col : panel;
+        if (proc_rank == 0)
+        {
+            // cols entries of every row of M_2, and of a row of P
+            mpi_err = MPI_Type_vector(width, cols, width, MPI_DOUBLE, &panel_type);
+            check(!mpi_err, "MPI_Type_vector returned with error");
+            mpi_err = MPI_Type_commit(&panel_type);
+            check(!mpi_err, "MPI_Type_commit returned with error");
+            mpi_err = MPI_Type_contiguous(cols, MPI_DOUBLE, &segment);
+            check(!mpi_err, "MPI_Type_contiguous returned with error");
+            mpi_err = MPI_Type_create_resized(segment, 0, (MPI_Aint) width * sizeof(double), &row_type);
+            check(!mpi_err, "MPI_Type_create_resized returned with error");
+            mpi_err = MPI_Type_commit(&row_type);
+            check(!mpi_err, "MPI_Type_commit returned with error");
+            MPI_Type_free(&segment);
+        }
+
+        if (proc_rank == 0)
+            mpi_err = MPI_Bcast(M_2 + col, 1, panel_type, 0, MPI_COMM_WORLD);
+        else
+            mpi_err = MPI_Bcast(panel_buf, width * cols, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        check(!mpi_err, "MPI_Bcast returned with error");
+
+        if (proc_rank == 0)
+            panel_product(M_1, M_2 + col, P + col, my_rows, width, cols, width, width);
+        else
+            panel_product(recv_buf, panel_buf, send_buf, my_rows, width, cols, cols, cols);
+
+        mpi_err = MPI_Gatherv(proc_rank == 0 ? MPI_IN_PLACE : send_buf, my_rows * cols, MPI_DOUBLE,
+                proc_rank == 0 ? P + col : NULL, row_counts, row_displs, proc_rank == 0 ? row_type : MPI_DOUBLE,
+                0, MPI_COMM_WORLD);
+        check(!mpi_err, "MPI_Gatherv returned with error");
+
+        if (proc_rank == 0)
+        {
+            MPI_Type_free(&panel_type);
+            MPI_Type_free(&row_type);
+        }
+    }
+    return EXIT_SUCCESS;
+error:
+    if (panel_type != MPI_DATATYPE_NULL)
+        MPI_Type_free(&panel_type);
+    if (segment != MPI_DATATYPE_NULL)
+        MPI_Type_free(&segment);
+    if (row_type != MPI_DATATYPE_NULL)
+        MPI_Type_free(&row_type);
+    return EXIT_FAILURE;
+}
+
+static int
+eliminate_rows_mpi(double *M, int width, int proc_rank,
+        int num_procs, int keep_multipliers)
 {
     double *pivot_buf = NULL, *proc_buf = NULL;
     int *send_counts = NULL, *displacements = NULL;
@@ -425,10 +556,9 @@ gaussian_elimination_naive_inplace_mpi(double *M, /*double *P,*/ int width,
         debug("mem_check'd");
     }
 
-    send_counts = (int *) malloc(sizeof(int) * num_procs);
-    check_mem(send_counts);
-    displacements = (int *) malloc(sizeof(int) * num_procs);
+    send_counts = (int *) mat_scratch(SCRATCH_COUNTS, 2 * num_procs * sizeof(int));
     check_mem(send_counts);
+    displacements = send_counts + num_procs;
 
     int rows_per_proc = width / num_procs;
     int unbalanced_num_rows = width - num_procs * (width / num_procs);
@@ -453,15 +583,17 @@ gaussian_elimination_naive_inplace_mpi(double *M, /*double *P,*/ int width,
     }
 #   endif
 
-    pivot_buf = (double *) malloc(width * sizeof(double));
+    pivot_buf = (double *) mat_scratch(SCRATCH_PIVOT, width * sizeof(double));
     check_mem(pivot_buf);
-    proc_buf = (double *) malloc(send_counts[proc_rank] * sizeof(double));
+    proc_buf = (double *) mat_scratch(SCRATCH_RECV, send_counts[proc_rank] * sizeof(double));
     check_mem(proc_buf);
 
     // scattering the matrix to all processes
+    TRACE_BEGIN(scatter);
     int mpi_err = MPI_Scatterv(M, send_counts, displacements,
             MPI_DOUBLE, proc_buf, send_counts[proc_rank],
             MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    TRACE_END(scatter);
     check(!mpi_err, "Call to `MPI_Scatterv` returned with error");
     debug_mpi(proc_rank, "Scattered!");
 
@@ -480,9 +612,12 @@ gaussian_elimination_naive_inplace_mpi(double *M, /*double *P,*/ int width,
         }
 
         debug_mpi(proc_rank, "Broadcasting pivot row %d from process %d", pivot_row, pivot_proc);
+        TRACE_BEGIN(pivot_bcast);
         MPI_Bcast(pivot_buf, width, MPI_DOUBLE,
                 pivot_proc, MPI_COMM_WORLD);
+        TRACE_END(pivot_bcast);
 
+        TRACE_BEGIN(update);
         int num_rows = send_counts[proc_rank]/width;
         for (int row = 0; row < num_rows; row++)
         {
@@ -493,15 +628,16 @@ gaussian_elimination_naive_inplace_mpi(double *M, /*double *P,*/ int width,
                 double pivot = pivot_buf[pivot_row];
                 check(pivot != 0, "Singular pivot");
                 double leverage = proc_buf[width*row + pivot_row];
-                proc_buf[width * row + pivot_row] = 0.0l;
                 double factor = leverage / pivot;
+                proc_buf[width * row + pivot_row] = keep_multipliers ? factor : 0.0l;
                 for (int col = pivot_row + 1; col < width; col++)
                 {
                     int index = row * width + col;
-                    proc_buf[index] -=  pivot_buf[index] * factor;
+                    proc_buf[index] -=  pivot_buf[col] * factor;
                 }
             }
         }
+        TRACE_END(update);
         pivot_row++; 
         if (proc_rank == pivot_proc)
         {
@@ -512,7 +648,7 @@ gaussian_elimination_naive_inplace_mpi(double *M, /*double *P,*/ int width,
 
         if (pivot_proc < num_procs-1) 
         {
-            if ((pivot_row * width)%(displacements[pivot_proc+1]) ==  0)
+            if (pivot_row * width == displacements[pivot_proc+1])
             {
                 pivot_proc++;
             }
@@ -520,16 +656,395 @@ gaussian_elimination_naive_inplace_mpi(double *M, /*double *P,*/ int width,
     }
 
     debug_mpi(proc_rank, "Gathering into main matrix");
+    TRACE_BEGIN(gather);
     mpi_err = MPI_Gatherv(proc_buf, send_counts[proc_rank],
             MPI_DOUBLE, M, send_counts,
             displacements, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    TRACE_END(gather);
+    check(!mpi_err, "Gathering to root failed");
+
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+gaussian_elimination_naive_inplace_mpi(double *M, int width,
+        int proc_rank, int num_procs)
+{
+    return eliminate_rows_mpi(M, width, proc_rank, num_procs, 0);
+}
+
+
+int
+lu_factor_inplace_mpi(double *M, int width,
+        int proc_rank, int num_procs)
+{
+    return eliminate_rows_mpi(M, width, proc_rank, num_procs, 1);
+}
+
+
+#define TRSM_BLOCK 64  // rows per diagonal block in the triangular solves
+
+static void
+lu_solve_local(const double *LU, double *X, int width, int ncols)
+{
+    // blocked forward/back substitution on a width x ncols
+    // row-major block, see lu_solve_omp
+    for (int kb = 0; kb < width; kb += TRSM_BLOCK)
+    {
+        const int kend = (kb + TRSM_BLOCK < width) ? kb + TRSM_BLOCK : width;
+        for (int row = kb + 1; row < kend; row++)
+        {
+            for (int k = kb; k < row; k++)
+            {
+                const double l = LU[row*width + k];
+                for (int col = 0; col < ncols; col++)
+                {
+                    X[row*ncols + col] -= l * X[k*ncols + col];
+                }
+            }
+        }
+        for (int row = kend; row < width; row++)
+        {
+            for (int k = kb; k < kend; k++)
+            {
+                const double l = LU[row*width + k];
+                for (int col = 0; col < ncols; col++)
+                {
+                    X[row*ncols + col] -= l * X[k*ncols + col];
+                }
+            }
+        }
+    }
+
+    const int last_block = ((width - 1) / TRSM_BLOCK) * TRSM_BLOCK;
+    for (int kb = last_block; kb >= 0; kb -= TRSM_BLOCK)
+    {
+        const int kend = (kb + TRSM_BLOCK < width) ? kb + TRSM_BLOCK : width;
+        for (int row = kend - 1; row >= kb; row--)
+        {
+            for (int k = row + 1; k < kend; k++)
+            {
+                const double u = LU[row*width + k];
+                for (int col = 0; col < ncols; col++)
+                {
+                    X[row*ncols + col] -= u * X[k*ncols + col];
+                }
+            }
+            const double diag = LU[row*width + row];
+            for (int col = 0; col < ncols; col++)
+            {
+                X[row*ncols + col] /= diag;
+            }
+        }
+        for (int row = 0; row < kb; row++)
+        {
+            for (int k = kb; k < kend; k++)
+            {
+                const double u = LU[row*width + k];
+                for (int col = 0; col < ncols; col++)
+                {
+                    X[row*ncols + col] -= u * X[k*ncols + col];
+                }
+            }
+        }
+    }
+}
+
+
+int
+lu_solve_mpi(double *LU, double *B, int width, int nrhs,
+        int proc_rank, int num_procs)
+{
+    // every process gets the factors and a contiguous slice of the
+    // columns of B, so the substitutions need no communication
+    int *send_counts = NULL, *displacements = NULL;
+    double *packed = NULL, *local = NULL;
+    const int mat_size = width * width;
+    if (proc_rank == 0)
+    {
+        check_mem(LU); check_mem(B);
+    }
+    check(nrhs > 0, "No right hand sides");
+
+    if (proc_rank != 0)
+    {
+        LU = (double *)malloc(mat_size * sizeof(double));
+        check_mem(LU);
+    }
+    int mpi_err = MPI_Bcast(LU, mat_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Broadcasting factors failed");
+
+    send_counts = (int *)malloc(num_procs * sizeof(int));
+    check_mem(send_counts);
+    displacements = (int *)malloc(num_procs * sizeof(int));
+    check_mem(displacements);
+
+    int cols_per_proc = nrhs / num_procs;
+    int unbalanced_num_cols = nrhs - cols_per_proc * num_procs;
+    displacements[0] = 0;
+    for (int i = 0; i < num_procs; i++)
+    {
+        send_counts[i] = (cols_per_proc + (i < unbalanced_num_cols)) * width;
+        if (i > 0)
+            displacements[i] = displacements[i-1] + send_counts[i-1];
+    }
+    const int my_cols = send_counts[proc_rank] / width;
+
+    // root packs each process's columns into a contiguous
+    // width x cols block so that a plain Scatterv can be used
+    if (proc_rank == 0)
+    {
+        packed = (double *)malloc(width * nrhs * sizeof(double));
+        check_mem(packed);
+        for (int i = 0, col0 = 0; i < num_procs; i++)
+        {
+            const int cols = send_counts[i] / width;
+            for (int row = 0; row < width; row++)
+            {
+                for (int c = 0; c < cols; c++)
+                {
+                    packed[displacements[i] + row*cols + c] = B[row*nrhs + col0 + c];
+                }
+            }
+            col0 += cols;
+        }
+    }
+
+    if (my_cols > 0)
+    {
+        local = (double *)malloc(send_counts[proc_rank] * sizeof(double));
+        check_mem(local);
+    }
+    mpi_err = MPI_Scatterv(packed, send_counts, displacements, MPI_DOUBLE,
+            local, send_counts[proc_rank], MPI_DOUBLE,
+            0, MPI_COMM_WORLD);
+    check(!mpi_err, "Scattering right hand sides failed");
+
+    if (my_cols > 0)
+        lu_solve_local(LU, local, width, my_cols);
+
+    mpi_err = MPI_Gatherv(local, send_counts[proc_rank], MPI_DOUBLE,
+            packed, send_counts, displacements, MPI_DOUBLE,
+            0, MPI_COMM_WORLD);
+    check(!mpi_err, "Gathering solutions failed");
+
+    if (proc_rank == 0)
+    {
+        for (int i = 0, col0 = 0; i < num_procs; i++)
+        {
+            const int cols = send_counts[i] / width;
+            for (int row = 0; row < width; row++)
+            {
+                for (int c = 0; c < cols; c++)
+                {
+                    B[row*nrhs + col0 + c] = packed[displacements[i] + row*cols + c];
+                }
+            }
+            col0 += cols;
+        }
+        free(packed);
+    }
+    else
+    {
+        free(LU);
+    }
+    if (local)
+        free(local);
+    free(send_counts);
+    free(displacements);
+    return 0;
+error:
+    if (proc_rank != 0 && LU)
+        free(LU);
+    if (packed)
+        free(packed);
+    if (local)
+        free(local);
+    if (send_counts)
+        free(send_counts);
+    if (displacements)
+        free(displacements);
+    return -1;
+}
+
+
+int
+solve_mpi(double *M, double *B, int width, int nrhs,
+        int proc_rank, int num_procs)
+{
+    int my_err = lu_factor_inplace_mpi(M, width, proc_rank, num_procs);
+    check(!my_err, "LU factorisation failed");
+    my_err = lu_solve_mpi(M, B, width, nrhs, proc_rank, num_procs);
+    check(!my_err, "Triangular solves failed");
+    return 0;
+error:
+    return -1;
+}
+
+
+/* single precision kernels, these move half as many bytes per
+ * message as their double counterparts above */
+
+int
+matMulSquare_balanced_mpi_f(const float *M_1, float *M_2,
+        float *P, int width,
+        int proc_rank, int num_procs)
+{
+    int *send_counts = NULL, *displacements = NULL;
+    float *recv_buf = NULL, *send_buf = NULL;
+    const int mat_size = width * width;
+    int num_rows_per_proc = width / num_procs;
+    int unbalanced_num_rows = width - (num_rows_per_proc * num_procs);
+    if (proc_rank == 0)
+    {
+        check_mem(M_1); check_mem(M_2); check_mem(P);
+    }
+    check(num_rows_per_proc > 0, "Poorly balanced problem: (%d rows, %d processes)", width, num_procs);
+
+    if (proc_rank != 0)
+    {
+        M_2 = (float *)malloc(mat_size * sizeof(float));
+        check_mem(M_2);
+    }
+    int mpi_err = MPI_Bcast(M_2, mat_size, MPI_FLOAT, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Broadcasting M_2 failed");
+
+    send_counts = (int *)malloc(num_procs * sizeof(int));
+    check_mem(send_counts);
+    displacements = (int *)malloc(num_procs * sizeof(int));
+    check_mem(displacements);
+    displacements[0] = 0;
+    for (int i = 0; i < num_procs; i++)
+    {
+        send_counts[i] = (num_rows_per_proc + (i < unbalanced_num_rows)) * width;
+        if (i > 0)
+            displacements[i] = displacements[i-1] + send_counts[i-1];
+    }
+
+    recv_buf = (float *)malloc(send_counts[proc_rank] * sizeof(float));
+    check_mem(recv_buf);
+    send_buf = (float *)malloc(send_counts[proc_rank] * sizeof(float));
+    check_mem(send_buf);
+
+    mpi_err = MPI_Scatterv(M_1, send_counts, displacements, MPI_FLOAT,
+            recv_buf, send_counts[proc_rank], MPI_FLOAT,
+            0, MPI_COMM_WORLD);
+    check(!mpi_err, "Scattering M_1 failed");
+
+    num_rows_per_proc = send_counts[proc_rank]/width;
+    for (int row = 0; row < num_rows_per_proc; row++)
+    {
+        for (int col = 0; col < width; col++)
+        {
+            float sum = 0.0f;
+            for (int i = 0; i < width; i++)
+            {
+                sum += recv_buf[row * width + i] * M_2[i * width + col];
+            }
+            send_buf[row * width + col] = sum;
+        }
+    }
+
+    mpi_err = MPI_Gatherv(send_buf, send_counts[proc_rank], MPI_FLOAT,
+            P, send_counts, displacements, MPI_FLOAT,
+            0, MPI_COMM_WORLD);
+    check(!mpi_err, "MPI_Gatherv returned with error");
+
+    free(send_buf);
+    free(recv_buf);
+    free(send_counts);
+    free(displacements);
+    if (proc_rank != 0)
+        free(M_2);
+    return EXIT_SUCCESS;
+error:
+    if (send_buf) free(send_buf);
+    if (recv_buf) free(recv_buf);
+    if (send_counts) free(send_counts);
+    if (displacements) free(displacements);
+    if (proc_rank != 0 && M_2)
+        free(M_2);
+    return EXIT_FAILURE;
+}
+
+
+static int
+eliminate_rows_mpi_f(float *M, int width, int proc_rank,
+        int num_procs, int keep_multipliers)
+{
+    float *pivot_buf = NULL, *proc_buf = NULL;
+    int *send_counts = NULL, *displacements = NULL;
+    if (proc_rank == 0)
+    {
+        check_mem(M);
+    }
+
+    send_counts = (int *) malloc(sizeof(int) * num_procs);
+    check_mem(send_counts);
+    displacements = (int *) malloc(sizeof(int) * num_procs);
+    check_mem(displacements);
+
+    int rows_per_proc = width / num_procs;
+    int unbalanced_num_rows = width - num_procs * rows_per_proc;
+    displacements[0] = 0;
+    for (int i = 0; i < num_procs; i++)
+    {
+        send_counts[i] = (rows_per_proc + (i < unbalanced_num_rows)) * width;
+        if (i > 0)
+            displacements[i] = displacements[i-1] + send_counts[i-1];
+    }
+
+    pivot_buf = (float *) malloc(width * sizeof(float));
+    check_mem(pivot_buf);
+    proc_buf = (float *) malloc((send_counts[proc_rank] + 1) * sizeof(float));
+    check_mem(proc_buf);
+
+    int mpi_err = MPI_Scatterv(M, send_counts, displacements,
+            MPI_FLOAT, proc_buf, send_counts[proc_rank],
+            MPI_FLOAT, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Call to `MPI_Scatterv` returned with error");
+
+    const int first_row = displacements[proc_rank] / width;
+    const int num_rows = send_counts[proc_rank] / width;
+    int pivot_proc = 0;
+    for (int pivot_row = 0; pivot_row < width - 1; pivot_row++)
+    {
+        while (pivot_row * width >= displacements[pivot_proc] + send_counts[pivot_proc])
+            pivot_proc++;
+
+        // the owner broadcasts straight out of its block
+        float *pivot = pivot_buf;
+        if (proc_rank == pivot_proc)
+            pivot = proc_buf + (pivot_row - first_row) * width;
+        mpi_err = MPI_Bcast(pivot, width, MPI_FLOAT,
+                pivot_proc, MPI_COMM_WORLD);
+        check(!mpi_err, "Broadcasting pivot row failed");
+        check(pivot[pivot_row] != 0, "Singular pivot");
+
+        const int start = (pivot_row + 1 > first_row) ? pivot_row + 1 - first_row : 0;
+        for (int row = start; row < num_rows; row++)
+        {
+            float factor = proc_buf[width * row + pivot_row] / pivot[pivot_row];
+            proc_buf[width * row + pivot_row] = keep_multipliers ? factor : 0.0f;
+            for (int col = pivot_row + 1; col < width; col++)
+            {
+                proc_buf[width * row + col] -= pivot[col] * factor;
+            }
+        }
+    }
+
+    mpi_err = MPI_Gatherv(proc_buf, send_counts[proc_rank],
+            MPI_FLOAT, M, send_counts,
+            displacements, MPI_FLOAT, 0, MPI_COMM_WORLD);
     check(!mpi_err, "Gathering to root failed");
 
     free(pivot_buf);
     free(proc_buf);
     free(displacements);
     free(send_counts);
-    debug("Intermediate memory resources freed");
     return 0;
 error:
     if (pivot_buf)
@@ -542,3 +1057,256 @@ error:
         free(displacements);
     return -1;
 }
+
+
+int
+gaussian_elimination_naive_inplace_mpi_f(float *M, int width,
+        int proc_rank, int num_procs)
+{
+    return eliminate_rows_mpi_f(M, width, proc_rank, num_procs, 0);
+}
+
+
+int
+lu_factor_inplace_mpi_f(float *M, int width,
+        int proc_rank, int num_procs)
+{
+    return eliminate_rows_mpi_f(M, width, proc_rank, num_procs, 1);
+}
+
+
+static void
+lu_solve_local_f(const float *LU, float *X, int width, int ncols)
+{
+    // unblocked, only used on the root for the O(width^2)
+    // correction solves of the iterative refinement
+    for (int row = 1; row < width; row++)
+    {
+        for (int k = 0; k < row; k++)
+        {
+            const float l = LU[row*width + k];
+            for (int col = 0; col < ncols; col++)
+            {
+                X[row*ncols + col] -= l * X[k*ncols + col];
+            }
+        }
+    }
+    for (int row = width - 1; row >= 0; row--)
+    {
+        for (int k = row + 1; k < width; k++)
+        {
+            const float u = LU[row*width + k];
+            for (int col = 0; col < ncols; col++)
+            {
+                X[row*ncols + col] -= u * X[k*ncols + col];
+            }
+        }
+        for (int col = 0; col < ncols; col++)
+        {
+            X[row*ncols + col] /= LU[row*width + row];
+        }
+    }
+}
+
+
+#define REFINE_MAX_ITER 30
+
+enum { REFINE_CONTINUE, REFINE_CONVERGED, REFINE_FALLBACK };
+
+int
+solve_mixed_mpi(double *M, double *B, int width, int nrhs,
+        int proc_rank, int num_procs, int *iter)
+{
+    // the O(width^3) factorisation runs distributed in single
+    // precision. Residuals are computed in double, each process
+    // multiplying its own block of rows of M, and the correction
+    // solves run on the root.
+    float *LU = NULL, *C = NULL;
+    double *X = NULL, *R = NULL, *M_loc = NULL, *B_loc = NULL, *R_loc = NULL;
+    double *M_copy = NULL;
+    int *row_counts = NULL, *row_displs = NULL, *rhs_counts = NULL, *rhs_displs = NULL;
+    const int mat_size = width * width;
+    const int rhs_size = width * nrhs;
+    int status = REFINE_CONTINUE, num_iter = 0, mpi_err;
+    double m_norm = 0.0l;
+    if (proc_rank == 0)
+    {
+        check_mem(M); check_mem(B);
+    }
+    check(nrhs > 0, "No right hand sides");
+
+    row_counts = (int *) malloc(num_procs * sizeof(int));
+    check_mem(row_counts);
+    row_displs = (int *) malloc(num_procs * sizeof(int));
+    check_mem(row_displs);
+    rhs_counts = (int *) malloc(num_procs * sizeof(int));
+    check_mem(rhs_counts);
+    rhs_displs = (int *) malloc(num_procs * sizeof(int));
+    check_mem(rhs_displs);
+    int rows_per_proc = width / num_procs;
+    int unbalanced_num_rows = width - num_procs * rows_per_proc;
+    for (int i = 0; i < num_procs; i++)
+    {
+        const int rows = rows_per_proc + (i < unbalanced_num_rows);
+        row_counts[i] = rows * width;
+        rhs_counts[i] = rows * nrhs;
+        row_displs[i] = i ? row_displs[i-1] + row_counts[i-1] : 0;
+        rhs_displs[i] = i ? rhs_displs[i-1] + rhs_counts[i-1] : 0;
+    }
+    const int my_rows = row_counts[proc_rank] / width;
+
+    X = (double *) calloc(rhs_size, sizeof(double));
+    check_mem(X);
+    M_loc = (double *) malloc((row_counts[proc_rank] + 1) * sizeof(double));
+    check_mem(M_loc);
+    B_loc = (double *) malloc((rhs_counts[proc_rank] + 1) * sizeof(double));
+    check_mem(B_loc);
+    R_loc = (double *) malloc((rhs_counts[proc_rank] + 1) * sizeof(double));
+    check_mem(R_loc);
+    if (proc_rank == 0)
+    {
+        LU = (float *) malloc(mat_size * sizeof(float));
+        check_mem(LU);
+        C = (float *) malloc(rhs_size * sizeof(float));
+        check_mem(C);
+        R = (double *) malloc(rhs_size * sizeof(double));
+        check_mem(R);
+        // M in single precision unless an element is out of its range
+        // (as dlag2s)
+        for (int row = 0; row < width; row++)
+        {
+            double row_sum = 0.0l;
+            for (int col = 0; col < width; col++)
+            {
+                const double m = M[row*width + col];
+                if (!(fabs(m) <= FLT_MAX))
+                    status = REFINE_FALLBACK;
+                row_sum += fabs(m);
+                LU[row*width + col] = (float) m;
+            }
+            m_norm = row_sum > m_norm ? row_sum : m_norm;
+        }
+    }
+    const double tolerance = m_norm * sqrt((double) width) * DBL_EPSILON;
+    double prev_r_norm = HUGE_VAL;
+
+    mpi_err = MPI_Scatterv(M, row_counts, row_displs, MPI_DOUBLE,
+            M_loc, row_counts[proc_rank], MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Scattering rows of M failed");
+    mpi_err = MPI_Scatterv(B, rhs_counts, rhs_displs, MPI_DOUBLE,
+            B_loc, rhs_counts[proc_rank], MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Scattering rows of B failed");
+
+    // a zero pivot is seen by every process, so all of them
+    // take the fallback together
+    mpi_err = MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Broadcasting refinement status failed");
+    if (status == REFINE_FALLBACK)
+    {
+        debug_mpi_root(proc_rank, "M does not fit in single precision");
+    }
+    else if (lu_factor_inplace_mpi_f(LU, width, proc_rank, num_procs) != 0)
+    {
+        debug_mpi_root(proc_rank, "Single precision factorisation failed");
+        status = REFINE_FALLBACK;
+    }
+
+    while (status == REFINE_CONTINUE)
+    {
+        mpi_err = MPI_Bcast(X, rhs_size, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        check(!mpi_err, "Broadcasting X failed");
+        for (int row = 0; row < my_rows; row++)
+        {
+            for (int col = 0; col < nrhs; col++)
+                R_loc[row*nrhs + col] = B_loc[row*nrhs + col];
+            for (int k = 0; k < width; k++)
+            {
+                const double m = M_loc[row*width + k];
+                for (int col = 0; col < nrhs; col++)
+                {
+                    R_loc[row*nrhs + col] -= m * X[k*nrhs + col];
+                }
+            }
+        }
+        mpi_err = MPI_Gatherv(R_loc, rhs_counts[proc_rank], MPI_DOUBLE,
+                R, rhs_counts, rhs_displs, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+        check(!mpi_err, "Gathering residuals failed");
+
+        if (proc_rank == 0)
+        {
+            // fmax drops NaNs, so the elements are checked on their
+            // own, and the residual has to fit in single precision
+            double r_norm = 0.0l, x_norm = 0.0l;
+            int not_finite = 0;
+            for (int i = 0; i < rhs_size; i++)
+            {
+                not_finite |= !(fabs(R[i]) <= FLT_MAX) || !isfinite(X[i]);
+                r_norm = fmax(r_norm, fabs(R[i]));
+                x_norm = fmax(x_norm, fabs(X[i]));
+                C[i] = (float) R[i];
+            }
+            if (not_finite)
+                status = REFINE_FALLBACK;
+            else if (num_iter > 0 && r_norm <= x_norm * tolerance)
+                status = REFINE_CONVERGED;
+            else if (r_norm >= prev_r_norm
+                    || num_iter == REFINE_MAX_ITER)
+                status = REFINE_FALLBACK;
+            else
+            {
+                lu_solve_local_f(LU, C, width, nrhs);
+                for (int i = 0; i < rhs_size; i++)
+                    X[i] += (double) C[i];
+            }
+            prev_r_norm = r_norm;
+        }
+        mpi_err = MPI_Bcast(&status, 1, MPI_INT, 0, MPI_COMM_WORLD);
+        check(!mpi_err, "Broadcasting refinement status failed");
+        if (status == REFINE_CONTINUE)
+            num_iter++;
+    }
+
+    if (status == REFINE_FALLBACK)
+    {
+        debug_mpi_root(proc_rank, "Iterative refinement did not converge, solving in double");
+        if (proc_rank == 0)
+        {
+            M_copy = (double *) malloc(mat_size * sizeof(double));
+            check_mem(M_copy);
+            memcpy(M_copy, M, mat_size * sizeof(double));
+        }
+        check(!solve_mpi(M_copy, B, width, nrhs, proc_rank, num_procs),
+                "Double precision fallback failed");
+        num_iter = -num_iter - 1;
+    }
+    else if (proc_rank == 0)
+    {
+        memcpy(B, X, rhs_size * sizeof(double));
+    }
+    if (iter)
+        *iter = num_iter;
+
+    free(X); free(M_loc); free(B_loc); free(R_loc);
+    free(row_counts); free(row_displs); free(rhs_counts); free(rhs_displs);
+    if (proc_rank == 0)
+    {
+        free(LU); free(C); free(R);
+        if (M_copy)
+            free(M_copy);
+    }
+    return 0;
+error:
+    if (X) free(X);
+    if (M_loc) free(M_loc);
+    if (B_loc) free(B_loc);
+    if (R_loc) free(R_loc);
+    if (LU) free(LU);
+    if (C) free(C);
+    if (R) free(R);
+    if (M_copy) free(M_copy);
+    if (row_counts) free(row_counts);
+    if (row_displs) free(row_displs);
+    if (rhs_counts) free(rhs_counts);
+    if (rhs_displs) free(rhs_displs);
+    return -1;
+}
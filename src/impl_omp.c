@@ -1,11 +1,18 @@
 #include "dbg.h"
+#include "fixed_kernels.h"
 #include "impl_omp.h"
+#include "matalloc.h"
+#include "transpose.h"
+#include "trace.h"
 
+#include <float.h>
 #include <inttypes.h>
 #include <math.h>
 #include <omp.h>
+#include <sched.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #define mel(A, w, i, j) A[i*w + j]  // get matrix element row,col
 #define submel(A, w, s, r, c) A[(r+s)*w + c + s]  // get principal submatrix element at row,col
@@ -25,11 +32,13 @@ matMulSquare_baseline_omp(const double *M_1,
                       const uint32_t width) 
 {
     check_mem(M_1); check_mem(M_2); check_mem(P);
+    if (matmul_fixed(M_1, M_2, P, width))
+        return 0;
     debug("Performing matrix multiplication for %d x %d matrices", width, width);
     const uint32_t matrix_size = width * width;
     check(matrix_size >= width, "Integer overflow (uint32_t).");
     debug("%u %u", width, matrix_size);
-#   pragma omp parallel for
+#   pragma omp parallel for schedule(static)
     for (uint32_t row = 0; row < width; row++)
     {
         for (uint32_t col = 0; col < width; col++)
@@ -63,6 +72,9 @@ matMulSquare_transpose_omp(const double *M_1,
     // fewer cache misses
     // large overhead of transposition
     // cumulative less than baseline?
+    check_mem(M_1); check_mem(M_2); check_mem(P);
+    if (matmul_fixed(M_1, M_2, P, width))
+        return 0;
     double *M_2trnsps = NULL;
     const uint32_t matrix_size = width * width;
     check(matrix_size >= width, "Integer overflow (uint32_t).");
@@ -70,23 +82,17 @@ matMulSquare_transpose_omp(const double *M_1,
     const unsigned long int mem_size = matrix_size * sizeof(double);
     check(mem_size >= matrix_size, "Integer overflow when calculating size to be malloc'd");
 
-    // 1m
-    M_2trnsps = (double *) malloc(mem_size);
+    // 1m, kept between calls
+    M_2trnsps = (double *) mat_scratch(SCRATCH_TRANSPOSE, mem_size);
     check_mem(M_2trnsps);
 
-    // parallelized matrix transposition
-#   pragma omp parallel for
-    for (uint32_t row = 0; row < width; row++ )
-    {
-        for (uint32_t col = 0; col < width; col++)
-        {
-            M_2trnsps[col * width + row] = M_2[row * width + col]; 
-        }
-    }
+    // parallel, cache oblivious transposition
+    check(!transpose_omp(M_2, width, M_2trnsps, width, width, width),
+            "Transposing M_2 failed");
 
     // matrix multiplication, taking into account transposition
     // of M_2
-#   pragma omp parallel for
+#   pragma omp parallel for schedule(static)
     for (uint32_t row = 0; row < width; row++) 
     {
         for (uint32_t col = 0; col < width; col++)
@@ -101,12 +107,9 @@ matMulSquare_transpose_omp(const double *M_1,
         }
     }
 
-    free(M_2trnsps);   // 1m
     return 0;
 
 error:
-    if (M_2trnsps)
-        free(M_2trnsps);
     return -1;
 }
 
@@ -117,10 +120,13 @@ matMulSquare_pretranspose_omp(const double *M_1,
                           double *P,
                           uint32_t width)
 {
+    check_mem(M_1); check_mem(M_2); check_mem(P);
+    if (matmul_nt_fixed(M_1, M_2, P, width))
+        return 0;
     const uint32_t matrix_size = width * width;
     check(matrix_size >= width, "Integer overflow (uint32_t).");
     
-#   pragma omp parallel for
+#   pragma omp parallel for schedule(static)
     for (uint32_t row = 0; row < width; row++)
     {
         for (uint32_t col = 0; col < width; col++)
@@ -141,23 +147,755 @@ error:
 }
 
 
+
+int
+matMulSquare_tiled_omp(const double *M_1,
+                   const double *M_2,
+                   double *P,
+                   uint32_t width,
+                   uint32_t tile)
+{
+    check_mem(M_1); check_mem(M_2); check_mem(P);
+    if (matmul_fixed(M_1, M_2, P, width))
+        return 0;
+    check(tile > 0, "Tile size must be positive");
+    const uint32_t matrix_size = width * width;
+    check(matrix_size >= width, "Integer overflow (uint32_t).");
+
+    // every thread owns whole tile rows of P, so P needs no reduction
+#   pragma omp parallel for schedule(static)
+    for (uint32_t row_tile = 0; row_tile < width; row_tile += tile)
+    {
+        const uint32_t row_end = row_tile + tile < width ? row_tile + tile : width;
+        for (uint32_t row = row_tile; row < row_end; row++)
+            memset(P + row * width, 0, width * sizeof(double));
+        for (uint32_t i_tile = 0; i_tile < width; i_tile += tile)
+        {
+            const uint32_t i_end = i_tile + tile < width ? i_tile + tile : width;
+            for (uint32_t col_tile = 0; col_tile < width; col_tile += tile)
+            {
+                const uint32_t col_end = col_tile + tile < width ? col_tile + tile : width;
+                for (uint32_t row = row_tile; row < row_end; row++)
+                {
+                    for (uint32_t i = i_tile; i < i_end; i++)
+                    {
+                        const double a = M_1[row*width + i];
+#                       pragma omp simd
+                        for (uint32_t col = col_tile; col < col_end; col++)
+                            P[row*width + col] += a * M_2[i*width + col];
+                    }
+                }
+            }
+        }
+    }
+
+    return 0;
+error:
+    return -1;
+}
+
 int
 gaussian_elimination_naive_inplace_omp(double *M, uint32_t width)
 {
+    int fixed_err;
     check_mem(M);
+    if (eliminate_fixed(M, width, 0, &fixed_err))
+    {
+        check(!fixed_err, "Zero pivot found! Use partial pivoting algo.");
+        return 0;
+    }
     for (uint32_t iter = 0; iter < width - 1; iter++) 
+    {
+        double pivot = M[iter * width + iter];
+        check(pivot != 0, "Zero pivot found! Use partial pivoting algo.");
+        // the team's implicit barrier ends every sweep, the per thread
+        // update phases show how long each thread waits there
+#       pragma omp parallel
+        {
+            TRACE_BEGIN(update);
+#           pragma omp for nowait
+            for (uint32_t row = iter+1; row < width; row++)
+            {
+                double factor = M[row*width + iter] / pivot;
+                for (uint32_t col = iter + 1; col < width; col++)
+                {
+                    M[row*width + col] -= factor * M[iter*width + col];
+                }
+                M[row * width + iter] = 0.0l;
+            }
+            TRACE_END(update);
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+// spins of a waiting thread between yields, so that a thread waiting
+// on one that shares its core lets it run
+#define SPIN_YIELD 1024
+
+// steps finished by one thread of the persistent elimination, one per
+// cache line so that polling one does not bounce the others
+typedef struct {
+    uint32_t step;
+    char pad[MAT_ALIGN - sizeof(uint32_t)];
+} progress_t;
+
+
+static void
+wait_for_step(const uint32_t *step, uint32_t target)
+{
+    for (uint32_t spins = 1; ; spins++)
+    {
+        uint32_t seen;
+#       pragma omp atomic read acquire
+        seen = *step;
+        if (seen >= target)
+            return;
+        if (spins % SPIN_YIELD == 0)
+            sched_yield();
+    }
+}
+
+
+int
+gaussian_elimination_persistent_omp(double *M, uint32_t width)
+{
+    int fixed_err;
+    check_mem(M);
+    if (eliminate_fixed(M, width, 0, &fixed_err))
+    {
+        check(!fixed_err, "Zero pivot found! Use partial pivoting algo.");
+        return 0;
+    }
+    const int max_threads = omp_get_max_threads();
+    progress_t *progress = (progress_t *) mat_alloc(max_threads * sizeof(progress_t));
+    check_mem(progress);
+    memset(progress, 0, max_threads * sizeof(progress_t));
+    int zero_pivot = 0;
+
+    // private copies, which the compiler can keep in registers across
+    // the stores to M
+#   pragma omp parallel num_threads(max_threads) firstprivate(M, width)
+    {
+        const uint32_t me = omp_get_thread_num(), team = omp_get_num_threads();
+        for (uint32_t iter = 0; iter < width - 1; iter++)
+        {
+            // row iter takes its last update in step iter - 1, from its
+            // owner, the wait replaces the barrier of the naive kernel
+            const uint32_t owner = iter % team;
+            if (owner != me)
+                wait_for_step(&progress[owner].step, iter);
+            const double pivot = M[iter * width + iter];
+            if (pivot == 0)
+            {
+                // every thread sees the same final pivot and stops here
+                if (me == owner)
+                {
+#                   pragma omp atomic write
+                    zero_pivot = 1;
+                }
+                break;
+            }
+            TRACE_BEGIN(update);
+            // rows stay with thread row % team throughout
+            const uint32_t first = iter + 1 + (me + team - (iter + 1) % team) % team;
+            for (uint32_t row = first; row < width; row += team)
+            {
+                const double factor = M[row*width + iter] / pivot;
+                for (uint32_t col = iter + 1; col < width; col++)
+                {
+                    M[row*width + col] -= factor * M[iter*width + col];
+                }
+                M[row * width + iter] = 0.0l;
+            }
+            TRACE_END(update);
+#           pragma omp atomic write release
+            progress[me].step = iter + 1;
+        }
+    }
+    mat_free(progress);
+    check(!zero_pivot, "Zero pivot found! Use partial pivoting algo.");
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+lu_factor_inplace_omp(double *M, uint32_t width)
+{
+    // same sweep as the elimination above, but the multipliers
+    // are kept below the diagonal (unit lower triangular L)
+    int fixed_err;
+    check_mem(M);
+    if (eliminate_fixed(M, width, 1, &fixed_err))
+    {
+        check(!fixed_err, "Zero pivot found! Use partial pivoting algo.");
+        return 0;
+    }
+    for (uint32_t iter = 0; iter < width - 1; iter++)
     {
         double pivot = M[iter * width + iter];
         check(pivot != 0, "Zero pivot found! Use partial pivoting algo.");
 #       pragma omp parallel for
         for (uint32_t row = iter+1; row < width; row++)
         {
-            double leverage = M[row*width + iter];  // LOL
+            double factor = M[row*width + iter] / pivot;
             for (uint32_t col = iter + 1; col < width; col++)
             {
-                M[row*width + col] -= leverage/pivot;
+                M[row*width + col] -= factor * M[iter*width + col];
+            }
+            M[row * width + iter] = factor;
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+#define TRSM_BLOCK 64  // rows per diagonal block in the triangular solves
+
+int
+lu_solve_omp(const double *LU, double *B, uint32_t width, uint32_t nrhs)
+{
+    // B is a width x nrhs row-major block of right hand sides,
+    // overwritten with the solution. Both triangular solves are
+    // blocked by TRSM_BLOCK rows: a short sequential solve on the
+    // diagonal block followed by a rank-TRSM_BLOCK update of the
+    // remaining rows, which is where the threads (and the flops) go.
+    check_mem(LU); check_mem(B);
+    check(nrhs > 0, "No right hand sides");
+
+    // forward substitution, L y = b (unit diagonal)
+    for (uint32_t kb = 0; kb < width; kb += TRSM_BLOCK)
+    {
+        const uint32_t kend = (kb + TRSM_BLOCK < width) ? kb + TRSM_BLOCK : width;
+#       pragma omp parallel for
+        for (uint32_t col = 0; col < nrhs; col++)
+        {
+            for (uint32_t row = kb + 1; row < kend; row++)
+            {
+                double sum = B[row*nrhs + col];
+                for (uint32_t k = kb; k < row; k++)
+                {
+                    sum -= LU[row*width + k] * B[k*nrhs + col];
+                }
+                B[row*nrhs + col] = sum;
+            }
+        }
+#       pragma omp parallel for
+        for (uint32_t row = kend; row < width; row++)
+        {
+            for (uint32_t k = kb; k < kend; k++)
+            {
+                const double l = LU[row*width + k];
+                for (uint32_t col = 0; col < nrhs; col++)
+                {
+                    B[row*nrhs + col] -= l * B[k*nrhs + col];
+                }
+            }
+        }
+    }
+
+    // back substitution, U x = y
+    const uint32_t num_blocks = (width + TRSM_BLOCK - 1) / TRSM_BLOCK;
+    for (uint32_t block = num_blocks; block-- > 0; )
+    {
+        const uint32_t kb = block * TRSM_BLOCK;
+        const uint32_t kend = (kb + TRSM_BLOCK < width) ? kb + TRSM_BLOCK : width;
+#       pragma omp parallel for
+        for (uint32_t col = 0; col < nrhs; col++)
+        {
+            for (uint32_t row = kend; row-- > kb; )
+            {
+                double sum = B[row*nrhs + col];
+                for (uint32_t k = row + 1; k < kend; k++)
+                {
+                    sum -= LU[row*width + k] * B[k*nrhs + col];
+                }
+                B[row*nrhs + col] = sum / LU[row*width + row];
+            }
+        }
+#       pragma omp parallel for
+        for (uint32_t row = 0; row < kb; row++)
+        {
+            for (uint32_t k = kb; k < kend; k++)
+            {
+                const double u = LU[row*width + k];
+                for (uint32_t col = 0; col < nrhs; col++)
+                {
+                    B[row*nrhs + col] -= u * B[k*nrhs + col];
+                }
+            }
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+solve_omp(double *M, double *B, uint32_t width, uint32_t nrhs)
+{
+    int my_err = lu_factor_inplace_omp(M, width);
+    check(!my_err, "LU factorisation failed");
+    my_err = lu_solve_omp(M, B, width, nrhs);
+    check(!my_err, "Triangular solves failed");
+    return 0;
+error:
+    return -1;
+}
+
+
+/* single precision kernels, same loops as their double
+ * counterparts above */
+
+int
+matMulSquare_baseline_omp_f(const float *M_1,
+                        const float *M_2,
+                        float *P,
+                        const uint32_t width)
+{
+    check_mem(M_1); check_mem(M_2); check_mem(P);
+    const uint32_t matrix_size = width * width;
+    check(matrix_size >= width, "Integer overflow (uint32_t).");
+#   pragma omp parallel for
+    for (uint32_t row = 0; row < width; row++)
+    {
+        for (uint32_t col = 0; col < width; col++)
+        {
+            float elmt_sum = 0.0f;
+            for (uint32_t i = 0; i < width; i++)
+            {
+                elmt_sum += M_1[row*width + i] * M_2[i*width + col];
+            }
+            P[row * width + col] = elmt_sum;
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+matMulSquare_transpose_omp_f(const float *M_1,
+                         const float *M_2,
+                         float *P,
+                         uint32_t width)
+{
+    float *M_2trnsps = NULL;
+    const uint32_t matrix_size = width * width;
+    check(matrix_size >= width, "Integer overflow (uint32_t).");
+
+    M_2trnsps = (float *) mat_scratch(SCRATCH_TRANSPOSE, (size_t) matrix_size * sizeof(float));
+    check_mem(M_2trnsps);
+
+#   pragma omp parallel for
+    for (uint32_t row = 0; row < width; row++ )
+    {
+        for (uint32_t col = 0; col < width; col++)
+        {
+            M_2trnsps[col * width + row] = M_2[row * width + col];
+        }
+    }
+
+#   pragma omp parallel for
+    for (uint32_t row = 0; row < width; row++)
+    {
+        for (uint32_t col = 0; col < width; col++)
+        {
+            float elmt_sum = 0.0f;
+            for (uint32_t i = 0; i < width; i++)
+            {
+                elmt_sum += M_1[row*width + i]*M_2trnsps[col * width + i];
+            }
+            P[row * width + col] = elmt_sum;
+        }
+    }
+
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+matMulSquare_pretranspose_omp_f(const float *M_1,
+                            const float *M_2,
+                            float *P,
+                            uint32_t width)
+{
+    const uint32_t matrix_size = width * width;
+    check(matrix_size >= width, "Integer overflow (uint32_t).");
+
+#   pragma omp parallel for
+    for (uint32_t row = 0; row < width; row++)
+    {
+        for (uint32_t col = 0; col < width; col++)
+        {
+            float elmt_sum = 0.0f;
+            for (uint32_t i = 0; i < width; i++)
+            {
+                elmt_sum += M_1[row*width + i] * M_2[col*width + i];
+            }
+            P[row * width + col] = elmt_sum;
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+static int
+eliminate_rows_omp_f(float *M, uint32_t width, int keep_multipliers)
+{
+    check_mem(M);
+    for (uint32_t iter = 0; iter < width - 1; iter++)
+    {
+        float pivot = M[iter * width + iter];
+        check(pivot != 0, "Zero pivot found! Use partial pivoting algo.");
+#       pragma omp parallel for
+        for (uint32_t row = iter+1; row < width; row++)
+        {
+            float factor = M[row*width + iter] / pivot;
+            for (uint32_t col = iter + 1; col < width; col++)
+            {
+                M[row*width + col] -= factor * M[iter*width + col];
+            }
+            M[row * width + iter] = keep_multipliers ? factor : 0.0f;
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+gaussian_elimination_naive_inplace_omp_f(float *M, uint32_t width)
+{
+    return eliminate_rows_omp_f(M, width, 0);
+}
+
+
+int
+lu_factor_inplace_omp_f(float *M, uint32_t width)
+{
+    return eliminate_rows_omp_f(M, width, 1);
+}
+
+
+int
+lu_solve_omp_f(const float *LU, float *B, uint32_t width, uint32_t nrhs)
+{
+    check_mem(LU); check_mem(B);
+    check(nrhs > 0, "No right hand sides");
+
+    for (uint32_t kb = 0; kb < width; kb += TRSM_BLOCK)
+    {
+        const uint32_t kend = (kb + TRSM_BLOCK < width) ? kb + TRSM_BLOCK : width;
+#       pragma omp parallel for
+        for (uint32_t col = 0; col < nrhs; col++)
+        {
+            for (uint32_t row = kb + 1; row < kend; row++)
+            {
+                float sum = B[row*nrhs + col];
+                for (uint32_t k = kb; k < row; k++)
+                {
+                    sum -= LU[row*width + k] * B[k*nrhs + col];
+                }
+                B[row*nrhs + col] = sum;
+            }
+        }
+#       pragma omp parallel for
+        for (uint32_t row = kend; row < width; row++)
+        {
+            for (uint32_t k = kb; k < kend; k++)
+            {
+                const float l = LU[row*width + k];
+                for (uint32_t col = 0; col < nrhs; col++)
+                {
+                    B[row*nrhs + col] -= l * B[k*nrhs + col];
+                }
+            }
+        }
+    }
+
+    const uint32_t num_blocks = (width + TRSM_BLOCK - 1) / TRSM_BLOCK;
+    for (uint32_t block = num_blocks; block-- > 0; )
+    {
+        const uint32_t kb = block * TRSM_BLOCK;
+        const uint32_t kend = (kb + TRSM_BLOCK < width) ? kb + TRSM_BLOCK : width;
+#       pragma omp parallel for
+        for (uint32_t col = 0; col < nrhs; col++)
+        {
+            for (uint32_t row = kend; row-- > kb; )
+            {
+                float sum = B[row*nrhs + col];
+                for (uint32_t k = row + 1; k < kend; k++)
+                {
+                    sum -= LU[row*width + k] * B[k*nrhs + col];
+                }
+                B[row*nrhs + col] = sum / LU[row*width + row];
+            }
+        }
+#       pragma omp parallel for
+        for (uint32_t row = 0; row < kb; row++)
+        {
+            for (uint32_t k = kb; k < kend; k++)
+            {
+                const float u = LU[row*width + k];
+                for (uint32_t col = 0; col < nrhs; col++)
+                {
+                    B[row*nrhs + col] -= u * B[k*nrhs + col];
+                }
+            }
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+#define REFINE_MAX_ITER 30
+
+int
+solve_mixed_omp(const double *M, double *B, uint32_t width, uint32_t nrhs,
+        int *iter)
+{
+    // factorise in single precision and refine the solution with
+    // residuals computed in double, as LAPACK's dsgesv does. If the
+    // refinement stalls M is factorised again in double.
+    float *LU = NULL, *C = NULL;
+    double *X = NULL, *R = NULL, *M_copy = NULL;
+    const size_t mat_size = (size_t) width * width;
+    const size_t rhs_size = (size_t) width * nrhs;
+    int converged = 0, num_iter = 0;
+    check_mem(M); check_mem(B);
+    check(nrhs > 0, "No right hand sides");
+
+    LU = (float *) malloc(mat_size * sizeof(float));
+    check_mem(LU);
+    C = (float *) malloc(rhs_size * sizeof(float));
+    check_mem(C);
+    X = (double *) calloc(rhs_size, sizeof(double));
+    check_mem(X);
+    R = (double *) malloc(rhs_size * sizeof(double));
+    check_mem(R);
+
+    // infinity norm of M for the stopping criterion, and M in single
+    // precision unless an element is out of its range (as dlag2s)
+    double m_norm = 0.0l;
+    int overflow = 0;
+#   pragma omp parallel for reduction(max:m_norm) reduction(|:overflow)
+    for (uint32_t row = 0; row < width; row++)
+    {
+        double row_sum = 0.0l;
+        for (uint32_t col = 0; col < width; col++)
+        {
+            const double m = M[row*width + col];
+            overflow |= !(fabs(m) <= FLT_MAX);
+            row_sum += fabs(m);
+            LU[row*width + col] = (float) m;
+        }
+        m_norm = row_sum > m_norm ? row_sum : m_norm;
+    }
+    const double tolerance = m_norm * sqrt((double) width) * DBL_EPSILON;
+    double prev_r_norm = HUGE_VAL;
+
+    if (overflow)
+    {
+        debug("M does not fit in single precision");
+        goto fallback;
+    }
+    if (lu_factor_inplace_omp_f(LU, width) != 0)
+    {
+        debug("Single precision factorisation failed");
+        goto fallback;
+    }
+
+    for (num_iter = 0; num_iter < REFINE_MAX_ITER; num_iter++)
+    {
+        // R = B - M X, in double precision
+        // fmax drops NaNs, so the elements are checked on their own
+        double r_norm = 0.0l, x_norm = 0.0l;
+        int not_finite = 0;
+#       pragma omp parallel for reduction(max:r_norm, x_norm) reduction(|:not_finite)
+        for (uint32_t row = 0; row < width; row++)
+        {
+            for (uint32_t col = 0; col < nrhs; col++)
+            {
+                R[row*nrhs + col] = B[row*nrhs + col];
+                not_finite |= !isfinite(X[row*nrhs + col]);
+                x_norm = fmax(x_norm, fabs(X[row*nrhs + col]));
+            }
+            for (uint32_t k = 0; k < width; k++)
+            {
+                const double m = M[row*width + k];
+                for (uint32_t col = 0; col < nrhs; col++)
+                {
+                    R[row*nrhs + col] -= m * X[k*nrhs + col];
+                }
+            }
+            for (uint32_t col = 0; col < nrhs; col++)
+            {
+                // the residual goes to single precision as well
+                not_finite |= !(fabs(R[row*nrhs + col]) <= FLT_MAX);
+                r_norm = fmax(r_norm, fabs(R[row*nrhs + col]));
+                C[row*nrhs + col] = (float) R[row*nrhs + col];
+            }
+        }
+        if (not_finite)
+            break;
+        if (num_iter > 0 && r_norm <= x_norm * tolerance)
+        {
+            converged = 1;
+            break;
+        }
+        if (r_norm >= prev_r_norm)
+            break;  // stagnating or diverging
+        prev_r_norm = r_norm;
+
+        // X += (LU)^-1 R, in single precision
+        check(!lu_solve_omp_f(LU, C, width, nrhs), "Single precision solve failed");
+#       pragma omp parallel for
+        for (uint32_t i = 0; i < rhs_size; i++)
+        {
+            X[i] += (double) C[i];
+        }
+    }
+    if (!converged)
+        goto fallback;
+
+    debug("Mixed precision solve converged after %d iterations", num_iter);
+    memcpy(B, X, rhs_size * sizeof(double));
+    if (iter)
+        *iter = num_iter;
+    free(LU); free(C); free(X); free(R);
+    return 0;
+
+fallback:
+    debug("Iterative refinement did not converge, solving in double");
+    M_copy = (double *) malloc(mat_size * sizeof(double));
+    check_mem(M_copy);
+    memcpy(M_copy, M, mat_size * sizeof(double));
+    check(!solve_omp(M_copy, B, width, nrhs), "Double precision fallback failed");
+    if (iter)
+        *iter = -num_iter - 1;
+    free(LU); free(C); free(X); free(R); free(M_copy);
+    return 0;
+error:
+    if (LU) free(LU);
+    if (C) free(C);
+    if (X) free(X);
+    if (R) free(R);
+    if (M_copy) free(M_copy);
+    return -1;
+}
+
+
+int
+syrk_lower_omp(const double *A, double *P, uint32_t width)
+{
+    // P = A A^T. Only the lower triangle (col <= row) of P is
+    // computed and written, the rows of A are read contiguously as
+    // in the pretranspose kernel. Row i costs i+1 dot products so
+    // rows are handed out dynamically.
+    check_mem(A); check_mem(P);
+    const uint32_t matrix_size = width * width;
+    check(matrix_size >= width, "Integer overflow (uint32_t).");
+
+#   pragma omp parallel for schedule(dynamic, 8)
+    for (uint32_t row = 0; row < width; row++)
+    {
+        for (uint32_t col = 0; col <= row; col++)
+        {
+            double elmt_sum = 0.0l;
+            for (uint32_t i = 0; i < width; i++)
+            {
+                elmt_sum += A[row*width + i] * A[col*width + i];
+            }
+            P[row*width + col] = elmt_sum;
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+#define CHOL_BLOCK 64
+
+int
+cholesky_inplace_omp(double *M, uint32_t width)
+{
+    // blocked right-looking Cholesky factorisation M = L L^T of a
+    // symmetric positive definite M. Only the lower triangle is read
+    // and it is overwritten with L, the upper triangle is untouched.
+    check_mem(M);
+    for (uint32_t kb = 0; kb < width; kb += CHOL_BLOCK)
+    {
+        const uint32_t kend = (kb + CHOL_BLOCK < width) ? kb + CHOL_BLOCK : width;
+
+        // unblocked factorisation of the diagonal block
+        for (uint32_t k = kb; k < kend; k++)
+        {
+            double diag = M[k*width + k];
+            for (uint32_t i = kb; i < k; i++)
+            {
+                diag -= M[k*width + i] * M[k*width + i];
+            }
+            check(diag > 0, "Matrix is not positive definite (pivot %u)", k);
+            diag = sqrt(diag);
+            M[k*width + k] = diag;
+            for (uint32_t row = k + 1; row < kend; row++)
+            {
+                double sum = M[row*width + k];
+                for (uint32_t i = kb; i < k; i++)
+                {
+                    sum -= M[row*width + i] * M[k*width + i];
+                }
+                M[row*width + k] = sum / diag;
+            }
+        }
+
+        // panel below the diagonal block, L_21 = A_21 L_11^-T
+#       pragma omp parallel for
+        for (uint32_t row = kend; row < width; row++)
+        {
+            for (uint32_t k = kb; k < kend; k++)
+            {
+                double sum = M[row*width + k];
+                for (uint32_t i = kb; i < k; i++)
+                {
+                    sum -= M[row*width + i] * M[k*width + i];
+                }
+                M[row*width + k] = sum / M[k*width + k];
+            }
+        }
+
+        // symmetric rank-CHOL_BLOCK update of the trailing lower
+        // triangle, A_22 -= L_21 L_21^T
+#       pragma omp parallel for schedule(dynamic, 8)
+        for (uint32_t row = kend; row < width; row++)
+        {
+            for (uint32_t col = kend; col <= row; col++)
+            {
+                double sum = 0.0l;
+                for (uint32_t k = kb; k < kend; k++)
+                {
+                    sum += M[row*width + k] * M[col*width + k];
+                }
+                M[row*width + col] -= sum;
             }
-            M[row * width + iter] = 0.0l;
         }
     }
     return 0;
@@ -0,0 +1,176 @@
+#include "dbg.h"
+#include "matalloc.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+
+/* Every block starts with a header of MAT_ALIGN bytes, the caller gets
+ * the memory right after it. The header records how the block has been
+ * obtained so that mat_free can give it back the same way. */
+
+enum {HUGEPAGES_OFF, HUGEPAGES_THP, HUGEPAGES_EXPLICIT};
+enum {BLOCK_HEAP, BLOCK_MAPPED};
+
+typedef struct {
+    void *base;
+    size_t length;
+    int kind;
+} block_header_t;
+
+typedef struct {
+    void *ptr;
+    size_t bytes;
+} scratch_t;
+
+// -1: not looked at the environment yet
+static int hugepage_mode = -1;
+static _Thread_local scratch_t scratch[NUM_SCRATCH_SLOTS];
+
+
+static int
+hugepages(void)
+{
+    if (hugepage_mode < 0)
+    {
+        const char *env = getenv("MATALLOC_HUGEPAGES");
+        hugepage_mode = HUGEPAGES_OFF;
+        if (env && (!strcmp(env, "1") || !strcmp(env, "thp")))
+            hugepage_mode = HUGEPAGES_THP;
+        else if (env && !strcmp(env, "explicit"))
+            hugepage_mode = HUGEPAGES_EXPLICIT;
+    }
+    return hugepage_mode;
+}
+
+
+void
+mat_advise_hugepages(void *addr, size_t bytes)
+{
+#   ifdef MADV_HUGEPAGE
+    if (hugepages() != HUGEPAGES_OFF && bytes >= MAT_HUGE_PAGE && madvise(addr, bytes, MADV_HUGEPAGE))
+    {
+        debug("madvise(MADV_HUGEPAGE) failed");
+    }
+#   else
+    (void) addr; (void) bytes;
+#   endif
+}
+
+
+static void *
+map_hugetlb(size_t length)
+{
+#   ifdef MAP_HUGETLB
+    void *base = mmap(NULL, length, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+    return base == MAP_FAILED ? NULL : base;
+#   else
+    (void) length;
+    return NULL;
+#   endif
+}
+
+
+void *
+mat_alloc(size_t bytes)
+{
+    block_header_t header = {NULL, bytes + MAT_ALIGN, BLOCK_HEAP};
+    check(header.length > bytes, "Integer overflow (size_t).");
+    const int huge = hugepages() != HUGEPAGES_OFF && bytes >= MAT_HUGE_PAGE;
+    if (huge)
+        header.length = (header.length + MAT_HUGE_PAGE - 1) / MAT_HUGE_PAGE * MAT_HUGE_PAGE;
+
+    if (huge && hugepages() == HUGEPAGES_EXPLICIT)
+    {
+        header.base = map_hugetlb(header.length);
+        header.kind = BLOCK_MAPPED;
+        if (!header.base)
+        {
+            debug("No explicit huge pages for %zu bytes, using transparent ones", bytes);
+        }
+    }
+    if (!header.base)
+    {
+        header.kind = BLOCK_HEAP;
+        check(!posix_memalign(&header.base, huge ? MAT_HUGE_PAGE : MAT_ALIGN,
+                    header.length), "Out of memory.");
+        if (huge)
+            mat_advise_hugepages(header.base, header.length);
+    }
+    memcpy(header.base, &header, sizeof(header));
+    return (char *) header.base + MAT_ALIGN;
+error:
+    return NULL;
+}
+
+
+void
+mat_free(void *ptr)
+{
+    block_header_t header;
+    if (!ptr)
+        return;
+    memcpy(&header, (char *) ptr - MAT_ALIGN, sizeof(header));
+    if (header.kind == BLOCK_MAPPED)
+        munmap(header.base, header.length);
+    else
+        free(header.base);
+}
+
+
+void *
+mat_scratch(int slot, size_t bytes)
+{
+    check(slot >= 0 && slot < NUM_SCRATCH_SLOTS, "No scratch slot %d", slot);
+    scratch_t *s = &scratch[slot];
+    // a large buffer is given back when far less of it is asked for
+    const int shrink = s->bytes >= MAT_HUGE_PAGE && bytes < s->bytes / MAT_SCRATCH_SHRINK;
+    if (s->bytes < bytes || !s->ptr || shrink)
+    {
+        mat_free(s->ptr);
+        s->bytes = 0;
+        s->ptr = mat_alloc(bytes > 0 ? bytes : 1);
+        check_mem(s->ptr);
+        s->bytes = bytes;
+    }
+    return s->ptr;
+error:
+    return NULL;
+}
+
+
+void
+mat_scratch_sizes(size_t held[NUM_SCRATCH_SLOTS])
+{
+    for (int slot = 0; slot < NUM_SCRATCH_SLOTS; slot++)
+        held[slot] = scratch[slot].bytes;
+}
+
+
+void
+mat_scratch_trim(const size_t held[NUM_SCRATCH_SLOTS])
+{
+    for (int slot = 0; slot < NUM_SCRATCH_SLOTS; slot++)
+    {
+        if (scratch[slot].bytes > held[slot])
+        {
+            mat_free(scratch[slot].ptr);
+            scratch[slot].ptr = NULL;
+            scratch[slot].bytes = 0;
+        }
+    }
+}
+
+
+void
+mat_scratch_release(void)
+{
+    for (int slot = 0; slot < NUM_SCRATCH_SLOTS; slot++)
+    {
+        mat_free(scratch[slot].ptr);
+        scratch[slot].ptr = NULL;
+        scratch[slot].bytes = 0;
+    }
+}
@@ -0,0 +1,266 @@
+#include "dbg.h"
+#include "matgen.h"
+#include "ooc.h"
+
+#include <math.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// the Philox4x32 multipliers and Weyl key increments
+#define PHILOX_M0 0xD2511F53u
+#define PHILOX_M1 0xCD9E8D57u
+#define PHILOX_W0 0x9E3779B9u
+#define PHILOX_W1 0xBB67AE85u
+#define PHILOX_ROUNDS 10
+
+// streams of a matrix: its entries and the two reflection vectors
+#define STREAM_ENTRIES 0
+#define STREAM_V1 1
+#define STREAM_V2 2
+
+// rows formatted per ordered write of the text output, and the widest
+// "%.17g" with its separator
+#define TEXT_ROWS 8
+#define TEXT_ENTRY 26
+
+
+static void
+philox(uint32_t ctr[4], uint64_t seed)
+{
+    uint32_t key0 = (uint32_t) seed, key1 = (uint32_t) (seed >> 32);
+    for (int round = 0; round < PHILOX_ROUNDS; round++)
+    {
+        const uint64_t prod0 = (uint64_t) PHILOX_M0 * ctr[0];
+        const uint64_t prod1 = (uint64_t) PHILOX_M1 * ctr[2];
+        const uint32_t next[4] = {
+            (uint32_t) (prod1 >> 32) ^ ctr[1] ^ key0, (uint32_t) prod1,
+            (uint32_t) (prod0 >> 32) ^ ctr[3] ^ key1, (uint32_t) prod0};
+        memcpy(ctr, next, sizeof(next));
+        key0 += PHILOX_W0;
+        key1 += PHILOX_W1;
+    }
+}
+
+
+// count uniforms in [0, 1) for entries 0 to count - 1 of row in stream
+static void
+uniform_row(const matgen_t *G, uint32_t stream, uint32_t row, double *out, uint32_t count)
+{
+    for (uint32_t col = 0; col < count; col += 2)
+    {
+        uint32_t ctr[4] = {col / 2, row, G->id, stream};
+        philox(ctr, G->seed);
+        // 53 bits from each half of the output
+        out[col] = (double) ((((uint64_t) ctr[0] << 32) | ctr[1]) >> 11) * 0x1.0p-53;
+        if (col + 1 < count)
+            out[col + 1] = (double) ((((uint64_t) ctr[2] << 32) | ctr[3]) >> 11) * 0x1.0p-53;
+    }
+}
+
+
+// a random unit vector of stream
+static void
+unit_vector(const matgen_t *G, uint32_t stream, double *v)
+{
+    double norm = 0.0l;
+    uniform_row(G, stream, 0, v, G->width);
+    for (uint32_t i = 0; i < G->width; i++)
+    {
+        v[i] = 2.0l * v[i] - 1.0l;
+        norm += v[i] * v[i];
+    }
+    norm = sqrt(norm);
+    for (uint32_t i = 0; i < G->width; i++)
+        v[i] /= norm;
+}
+
+
+int
+matgen_init(matgen_t *G, matgen_kind_t kind, uint32_t width, uint64_t seed,
+        uint32_t id, double cond, double low, double high)
+{
+    check_mem(G);
+    *G = (matgen_t) {.kind = kind, .width = width, .seed = seed, .id = id,
+        .cond = cond, .low = low, .high = high};
+    check(width > 0, "Non-positive width");
+    check(low <= high, "Empty range [%lf, %lf)", low, high);
+    check(kind != MATGEN_DOMINANT || cond > 1.0l,
+            "Diagonally dominant matrices need a condition number above 1, not %lf", cond);
+    if (kind == MATGEN_SPECTRUM)
+    {
+        check(cond >= 1.0l, "Condition number %lf below 1", cond);
+        G->v1 = (double *) malloc(3 * (size_t) width * sizeof(double));
+        check_mem(G->v1);
+        G->v2 = G->v1 + width;
+        G->sigma = G->v2 + width;
+        unit_vector(G, STREAM_V1, G->v1);
+        unit_vector(G, STREAM_V2, G->v2);
+        G->v1_s_v2 = 0.0l;
+        for (uint32_t i = 0; i < width; i++)
+        {
+            G->sigma[i] = width > 1 ? pow(cond, -(double) i / (width - 1)) : 1.0l;
+            G->v1_s_v2 += G->v1[i] * G->sigma[i] * G->v2[i];
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+void
+matgen_free(matgen_t *G)
+{
+    if (G && G->v1)
+        free(G->v1);
+    if (G)
+        G->v1 = G->v2 = G->sigma = NULL;
+}
+
+
+void
+matgen_rows(const matgen_t *G, double *buf, uint32_t row, uint32_t count)
+{
+    const uint32_t n = G->width;
+    const double delta = G->kind == MATGEN_DOMINANT ? 2.0l / (G->cond - 1.0l) : 0.0l;
+    for (uint32_t r = row; r < row + count; r++)
+    {
+        double *out = buf + (size_t) (r - row) * n;
+        if (G->kind == MATGEN_SPECTRUM)
+        {
+            // (H_1 S H_2)_rc = s_r [r = c] - 2 v1_r v1_c s_c
+            //                  - 2 s_r v2_r v2_c + 4 v1_r (v1^T S v2) v2_c
+            const double *v1 = G->v1, *v2 = G->v2, *s = G->sigma;
+            const double a = -2.0l * v1[r], b = -2.0l * s[r] * v2[r];
+            const double c = 4.0l * v1[r] * G->v1_s_v2;
+            for (uint32_t col = 0; col < n; col++)
+                out[col] = a * v1[col] * s[col] + (b + c) * v2[col];
+            out[r] += s[r];
+            continue;
+        }
+        uniform_row(G, STREAM_ENTRIES, r, out, n);
+        double row_sum = 0.0l;
+        for (uint32_t col = 0; col < n; col++)
+        {
+            out[col] = G->low + (G->high - G->low) * out[col];
+            row_sum += col != r ? fabs(out[col]) : 0.0l;
+        }
+        if (G->kind == MATGEN_DOMINANT)
+            out[r] = row_sum > 0.0l ? (1.0l + delta) * row_sum : 1.0l;
+    }
+}
+
+
+int
+matgen_fill_omp(const matgen_t *G, double *M)
+{
+    check_mem(G); check_mem(M);
+#   pragma omp parallel for schedule(static)
+    for (uint32_t row = 0; row < G->width; row++)
+        matgen_rows(G, M + (size_t) row * G->width, row, 1);
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+matgen_write_omp(const matgen_t *G, const char *path, size_t memory)
+{
+    ooc_matrix_t F = {.fd = -1};
+    int write_err = 0;
+    check_mem(G);
+    const uint64_t width = G->width;
+    check(!ooc_create(&F, path, width, width), "Could not create %s", path);
+
+    // a panel per thread within the budget
+    uint64_t panel = memory / ((uint64_t) omp_get_max_threads() * width * sizeof(double));
+    panel = panel < 1 ? 1 : (panel < width ? panel : width);
+    const uint64_t panels = (width + panel - 1) / panel;
+
+#   pragma omp parallel
+    {
+        double *buf = (double *) malloc(panel * width * sizeof(double));
+        if (!buf)
+        {
+#           pragma omp atomic write
+            write_err = 1;
+        }
+        // disjoint panels, so the pwrites of the threads do not overlap
+#       pragma omp for schedule(dynamic)
+        for (uint64_t p = 0; p < panels; p++)
+        {
+            const uint64_t row0 = p * panel;
+            const uint64_t rows = width - row0 < panel ? width - row0 : panel;
+            if (!buf)
+                continue;
+            matgen_rows(G, buf, (uint32_t) row0, (uint32_t) rows);
+            if (ooc_write_rows(&F, buf, row0, rows))
+            {
+#               pragma omp atomic write
+                write_err = 1;
+            }
+        }
+        if (buf)
+            free(buf);
+    }
+    check(!write_err, "Could not write %s", path);
+    check(!ooc_close(&F), "Could not close %s", path);
+    return 0;
+error:
+    ooc_close(&F);
+    return -1;
+}
+
+
+int
+matgen_write_text_omp(const matgen_t *G, FILE *file)
+{
+    int write_err = 0;
+    check_mem(G);
+    check(file, "Not a valid FILE pointer");
+    const uint32_t n = G->width;
+    const uint32_t blocks = (n + TEXT_ROWS - 1) / TEXT_ROWS;
+
+#   pragma omp parallel
+    {
+        double *buf = (double *) malloc((size_t) TEXT_ROWS * n * sizeof(double));
+        char *text = (char *) malloc((size_t) TEXT_ROWS * n * TEXT_ENTRY + 1);
+        if (!buf || !text)
+        {
+#           pragma omp atomic write
+            write_err = 1;
+        }
+        // formatting overlaps, the writes go in row order
+#       pragma omp for ordered schedule(static, 1)
+        for (uint32_t block = 0; block < blocks; block++)
+        {
+            const uint32_t row0 = block * TEXT_ROWS;
+            const uint32_t rows = n - row0 < TEXT_ROWS ? n - row0 : TEXT_ROWS;
+            size_t len = 0;
+            if (buf && text)
+            {
+                matgen_rows(G, buf, row0, rows);
+                for (size_t i = 0; i < (size_t) rows * n; i++)
+                    len += sprintf(text + len, "%.17g%c", buf[i], (i + 1) % n ? ' ' : '\n');
+            }
+#           pragma omp ordered
+            if (len && fwrite(text, 1, len, file) != len)
+            {
+#               pragma omp atomic write
+                write_err = 1;
+            }
+        }
+        if (buf)
+            free(buf);
+        if (text)
+            free(text);
+    }
+    check(!write_err, "Could not write the matrix");
+    return 0;
+error:
+    return -1;
+}
@@ -0,0 +1,110 @@
+#include "dbg.h"
+#include "matrix.hpp"
+
+extern "C" {
+#include "verify.h"
+}
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <exception>
+#include <omp.h>
+#include <stdexcept>
+#include <utility>
+
+using hpsc::Matrix;
+
+/* Driver of the C++ layer, reads the driver format like omp.out and
+ * checks the expression forms against the C kernels they wrap */
+
+const double THRESHOLD = 1.0e-9;
+
+
+static void
+expect_close(double of, double against, const char *what)
+{
+    if (std::fabs(of - against) > THRESHOLD * (std::fabs(against) + 1.0))
+    {
+        log_err("%s: %lf against %lf", what, of, against);
+        throw std::runtime_error(what);
+    }
+}
+
+
+int main()
+{
+    try
+    {
+        uint32_t width;
+        if (std::scanf("%u", &width) != 1 || width == 0)
+            throw std::runtime_error("Could not read a positive width");
+        const Matrix A = Matrix::read(stdin, width);
+        const Matrix B = Matrix::read(stdin, width);
+        const size_t size = (size_t) width * width;
+
+        // a bare product is one kernel call into the destination
+        double start_time = omp_get_wtime();
+        Matrix P = A * B;
+        double end_time = omp_get_wtime();
+        const double execution_time_matmul = end_time - start_time;
+        if (verify_matmul_omp(A.data(), B.data(), P.data(), width, 0, VERIFY_TRIALS,
+                    (uint64_t) std::time(NULL), VERIFY_TOL))
+            throw std::runtime_error("Bad numericals - matrix multiplication test case failed");
+
+        // the product into D, then the rest in one pass
+        Matrix D = A * B + A - 2.0 * B;
+        for (size_t i = 0; i < size; i++)
+            expect_close(D.data()[i], P.data()[i] + A.data()[i] - 2.0 * B.data()[i], "Fused sum");
+
+        // D as an operand of its own product goes through a temporary,
+        // and a second product of the expression too
+        D = A * B;
+        D = A * D - P * A;
+        Matrix ABB = A * P, PA = P * A;
+        for (size_t i = 0; i < size; i++)
+            expect_close(D.data()[i], ABB.data()[i] - PA.data()[i], "Aliased product");
+
+        // views: a block sum, then every row moved one down in place
+        const uint32_t half = width / 2;
+        D = P.clone();
+        Matrix &Pm = P;
+        D.view(0, 0, half, half) = Pm.view(half, half, half, half) + Pm.view(0, half, half, half);
+        for (uint32_t row = 0; row < half; row++)
+        {
+            for (uint32_t col = 0; col < half; col++)
+                expect_close(D(row, col), P(row + half, col + half) + P(row, col + half), "View sum");
+        }
+        D = P.clone();
+        D.view(1, 0, width - 1, width) = D.view(0, 0, width - 1, width);
+        for (size_t i = width; i < size; i++)
+            expect_close(D.data()[i], P.data()[i - width], "Overlapping view");
+
+        // elimination of the lazy product happens in its result
+        start_time = omp_get_wtime();
+        Matrix U = (A * B).eliminate();
+        end_time = omp_get_wtime();
+        const double execution_time_elimination = end_time - start_time;
+        Matrix R = P.clone();
+        if (gaussian_elimination_naive_inplace_omp(R.data(), width))
+            throw std::runtime_error("Something went wrong during gaussian elimination");
+        for (size_t i = 0; i < size; i++)
+            expect_close(U.data()[i], R.data()[i], "Elimination");
+
+        // ownership moves, the source is left empty
+        Matrix moved = std::move(U);
+        if (U.data() || !moved.data() || moved.width() != width)
+            throw std::runtime_error("Bad move");
+
+        // width num_threads matmul_time elimination_time
+        std::printf("%u %d %lf %lf\n", width, omp_get_max_threads(),
+                execution_time_matmul, execution_time_elimination);
+    }
+    catch (const std::exception &e)
+    {
+        log_err("%s", e.what());
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,282 @@
+#include "dbg.h"
+#include "morton.h"
+
+#include <omp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define TILE MORTON_TILE
+#define TILE_SIZE (MORTON_TILE * MORTON_TILE)
+#define PAGE 4096
+
+// valid rows (or columns) of tile row (or column) t
+#define VALID(T, t) ((T)->width - (t) * TILE < TILE ? (T)->width - (t) * TILE : TILE)
+
+
+// the even bits of code, compacted
+static uint32_t
+compact_bits(uint64_t code)
+{
+    code &= 0x5555555555555555ull;
+    code = (code | (code >> 1)) & 0x3333333333333333ull;
+    code = (code | (code >> 2)) & 0x0f0f0f0f0f0f0f0full;
+    code = (code | (code >> 4)) & 0x00ff00ff00ff00ffull;
+    code = (code | (code >> 8)) & 0x0000ffff0000ffffull;
+    code = (code | (code >> 16)) & 0x00000000ffffffffull;
+    return (uint32_t) code;
+}
+
+
+int
+morton_alloc(morton_matrix_t *T, uint32_t width)
+{
+    check_mem(T);
+    T->offset = NULL;
+    T->data = NULL;
+    check(width > 0, "Non-positive width");
+    T->width = width;
+    T->tiles = (width + TILE - 1) / TILE;
+    const size_t num_tiles = (size_t) T->tiles * T->tiles;
+
+    T->offset = (uint32_t *) malloc(num_tiles * sizeof(uint32_t));
+    check_mem(T->offset);
+    // walk the Z curve over the enclosing power of two grid and
+    // number the tiles that exist
+    uint64_t grid = 1;
+    while (grid < T->tiles)
+        grid *= 2;
+    uint32_t index = 0;
+    for (uint64_t code = 0; code < grid * grid; code++)
+    {
+        const uint32_t tile_row = compact_bits(code >> 1), tile_col = compact_bits(code);
+        if (tile_row < T->tiles && tile_col < T->tiles)
+            T->offset[tile_row * T->tiles + tile_col] = index++;
+    }
+
+    check(!posix_memalign((void **) &T->data, PAGE, num_tiles * TILE_SIZE * sizeof(double)),
+            "Out of memory.");
+    return 0;
+error:
+    morton_free(T);
+    return -1;
+}
+
+
+void
+morton_free(morton_matrix_t *T)
+{
+    if (!T)
+        return;
+    if (T->offset)
+        free(T->offset);
+    if (T->data)
+        free(T->data);
+    T->offset = NULL;
+    T->data = NULL;
+}
+
+
+int
+morton_from_rowmajor_omp(morton_matrix_t *T, const double *M)
+{
+    check_mem(T); check_mem(M);
+    const uint32_t tiles = T->tiles, width = T->width;
+#   pragma omp parallel for collapse(2) schedule(static)
+    for (uint32_t tile_row = 0; tile_row < tiles; tile_row++)
+    {
+        for (uint32_t tile_col = 0; tile_col < tiles; tile_col++)
+        {
+            double *tile = morton_tile(T, tile_row, tile_col);
+            const uint32_t rows = VALID(T, tile_row), cols = VALID(T, tile_col);
+            memset(tile, 0, TILE_SIZE * sizeof(double));
+            for (uint32_t row = 0; row < rows; row++)
+                memcpy(tile + row * TILE,
+                        M + (size_t) (tile_row * TILE + row) * width + tile_col * TILE,
+                        cols * sizeof(double));
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+morton_to_rowmajor_omp(const morton_matrix_t *T, double *M)
+{
+    check_mem(T); check_mem(M);
+    const uint32_t tiles = T->tiles, width = T->width;
+#   pragma omp parallel for collapse(2) schedule(static)
+    for (uint32_t tile_row = 0; tile_row < tiles; tile_row++)
+    {
+        for (uint32_t tile_col = 0; tile_col < tiles; tile_col++)
+        {
+            const double *tile = morton_tile(T, tile_row, tile_col);
+            const uint32_t rows = VALID(T, tile_row), cols = VALID(T, tile_col);
+            for (uint32_t row = 0; row < rows; row++)
+                memcpy(M + (size_t) (tile_row * TILE + row) * width + tile_col * TILE,
+                        tile + row * TILE, cols * sizeof(double));
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+// C += alpha A B on whole tiles, the padding is zero
+static void
+tile_gemm(const double *restrict A, const double *restrict B, double *restrict C,
+        double alpha)
+{
+    for (int row = 0; row < TILE; row++)
+    {
+        for (int i = 0; i < TILE; i++)
+        {
+            const double a = alpha * A[row*TILE + i];
+#           pragma omp simd
+            for (int col = 0; col < TILE; col++)
+                C[row*TILE + col] += a * B[i*TILE + col];
+        }
+    }
+}
+
+
+int
+matMulSquare_morton_omp(const morton_matrix_t *A, const morton_matrix_t *B,
+        morton_matrix_t *C)
+{
+    check_mem(A); check_mem(B); check_mem(C);
+    check(A->width == B->width && B->width == C->width, "Widths differ");
+    const uint32_t tiles = C->tiles;
+
+    // one tile of C per iteration, no two threads write the same tile
+#   pragma omp parallel for collapse(2) schedule(static)
+    for (uint32_t tile_row = 0; tile_row < tiles; tile_row++)
+    {
+        for (uint32_t tile_col = 0; tile_col < tiles; tile_col++)
+        {
+            double *c = morton_tile(C, tile_row, tile_col);
+            memset(c, 0, TILE_SIZE * sizeof(double));
+            for (uint32_t k = 0; k < tiles; k++)
+                tile_gemm(morton_tile(A, tile_row, k), morton_tile(B, k, tile_col), c, 1.0);
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+// LU of the first valid rows and columns of the diagonal tile
+static int
+tile_lu(double *D, uint32_t valid)
+{
+    for (uint32_t iter = 0; iter < valid; iter++)
+    {
+        const double pivot = D[iter*TILE + iter];
+        if (pivot == 0.0)
+            return -1;
+        for (uint32_t row = iter + 1; row < valid; row++)
+        {
+            const double factor = D[row*TILE + iter] / pivot;
+            D[row*TILE + iter] = factor;
+            for (uint32_t col = iter + 1; col < valid; col++)
+                D[row*TILE + col] -= factor * D[iter*TILE + col];
+        }
+    }
+    return 0;
+}
+
+
+// U := L^-1 U for the unit lower triangle of the diagonal tile D
+static void
+tile_solve_lower(const double *D, double *U, uint32_t valid)
+{
+    for (uint32_t iter = 0; iter < valid; iter++)
+    {
+        for (uint32_t row = iter + 1; row < valid; row++)
+        {
+            const double factor = D[row*TILE + iter];
+#           pragma omp simd
+            for (int col = 0; col < TILE; col++)
+                U[row*TILE + col] -= factor * U[iter*TILE + col];
+        }
+    }
+}
+
+
+// L := L U^-1 for the upper triangle of the diagonal tile D
+static void
+tile_solve_upper(const double *D, double *L, uint32_t valid)
+{
+    for (int row = 0; row < TILE; row++)
+    {
+        for (uint32_t iter = 0; iter < valid; iter++)
+        {
+            const double factor = L[row*TILE + iter] / D[iter*TILE + iter];
+            L[row*TILE + iter] = factor;
+            for (uint32_t col = iter + 1; col < valid; col++)
+                L[row*TILE + col] -= factor * D[iter*TILE + col];
+        }
+    }
+}
+
+
+int
+lu_factor_morton_omp(morton_matrix_t *T)
+{
+    check_mem(T);
+    const uint32_t tiles = T->tiles;
+    for (uint32_t k = 0; k < tiles; k++)
+    {
+        double *diag = morton_tile(T, k, k);
+        const uint32_t valid = VALID(T, k);
+        check(!tile_lu(diag, valid), "Zero pivot found! Use partial pivoting algo.");
+        const uint32_t rest = tiles - k - 1;
+
+        // the tile row right of and the tile column below the diagonal
+#       pragma omp parallel for schedule(static)
+        for (uint32_t t = 0; t < 2 * rest; t++)
+        {
+            if (t < rest)
+                tile_solve_lower(diag, morton_tile(T, k, k + 1 + t), valid);
+            else
+                tile_solve_upper(diag, morton_tile(T, k + 1 + t - rest, k), valid);
+        }
+
+        // trailing tiles
+#       pragma omp parallel for collapse(2) schedule(static)
+        for (uint32_t tile_row = k + 1; tile_row < tiles; tile_row++)
+        {
+            for (uint32_t tile_col = k + 1; tile_col < tiles; tile_col++)
+                tile_gemm(morton_tile(T, tile_row, k), morton_tile(T, k, tile_col),
+                        morton_tile(T, tile_row, tile_col), -1.0);
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+gaussian_elimination_morton_omp(morton_matrix_t *T)
+{
+    check(!lu_factor_morton_omp(T), "Tile LU failed");
+    const uint32_t tiles = T->tiles;
+    // U is the same as the one of the elimination, drop L
+#   pragma omp parallel for schedule(static)
+    for (uint32_t tile_row = 0; tile_row < tiles; tile_row++)
+    {
+        for (uint32_t tile_col = 0; tile_col < tile_row; tile_col++)
+            memset(morton_tile(T, tile_row, tile_col), 0, TILE_SIZE * sizeof(double));
+        double *diag = morton_tile(T, tile_row, tile_row);
+        for (int row = 1; row < TILE; row++)
+            memset(diag + row * TILE, 0, row * sizeof(double));
+    }
+    return 0;
+error:
+    return -1;
+}
@@ -1,19 +1,36 @@
 #include "dbg.h"
+#include "autotune.h"
 #include "impl_mpi.h"
+#include "matalloc.h"
 #include "matrixio.h"
+#include "perf_counters.h"
+#include "stream_mpi.h"
+#include "trace_mpi.h"
+#include "verify.h"
 
 #include <inttypes.h>
 #include <mpi.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 const double threshold = 0.01;
 
+static int
+lowmem_mpi(const double *M_1, double *M_2, double *P, int width,
+        int proc_rank, int num_procs)
+{
+    return matMulSquare_lowmem_mpi(M_1, M_2, P, width, proc_rank, num_procs, LOWMEM_PANEL);
+}
+
 impl_mpi_t matmul_methods_mpi[] = {
                               matMulSquare_balanced_mpi,
                               matMulSquare_transpose_mpi,
-                              matMulSquare_pretranspose_mpi};
+                              matMulSquare_pretranspose_mpi,
+                              matMulSquare_auto_mpi,
+                              lowmem_mpi};
 
 const int num_methods_mpi = sizeof(matmul_methods_mpi)/sizeof(impl_mpi_t);
 
@@ -31,6 +48,8 @@ int main(int argc, char *argv[])
     check(!mpi_err, "MPI_Comm_size failed");
     mpi_err = MPI_Comm_rank(MPI_COMM_WORLD, &proc_rank);
     check(!mpi_err, "MPI_Comm_rank failed");
+    PERF_SET_RANK(proc_rank);
+    TRACE_SYNC_MPI(proc_rank, num_procs);
 
     if (argc > 1)
     {
@@ -47,45 +66,68 @@ int main(int argc, char *argv[])
     debug_mpi(proc_rank,"Method_index: %d", method_index);
     matmul = matmul_methods_mpi[method_index];
 
-    if (proc_rank == 0)
+    // `mpi.out <method> stream` reads the input while multiplying, the
+    // matmul time then includes the reading, see include/stream_mpi.h
+    const int stream = argc > 2 && !strcmp(argv[2], "stream");
+    double start_time, end_time;
+    int my_err;
+    if (stream)
     {
-        int scan_count = scanf("%d", &width);
-        check(scan_count != EOF, "Unexpected EOF");
-        check(scan_count > 0, "Nothing scanned");
-        int mat_size = width * width;
-
-        m1 = (double *)malloc(mat_size * sizeof(double));
-        m2 = (double *)malloc(mat_size * sizeof(double));
-        p = (double *)malloc(mat_size * sizeof(double));
-        for (int i = 0; i < mat_size; i++)
-        {
-            scan_count = scanf("%lf", m1 + i);
-            check(scan_count != EOF, "Unexpected EOF");
-            check(scan_count > 0, "Nothing scanned");
-        }
-        for (int i = 0; i < mat_size; i++)
+        PERF_KERNEL_BEGIN();
+        start_time = MPI_Wtime();
+        my_err = matMulSquare_stream_mpi(stdin, &p, &width, proc_rank, num_procs);
+        end_time = MPI_Wtime();
+        PERF_KERNEL_END("matmul");
+        check(!my_err, "Something went wrong during streamed matrix multiplication");
+    }
+    else
+    {
+        if (proc_rank == 0)
         {
-            scan_count = scanf("%lf", m2 + i);
+            int scan_count = scanf("%d", &width);
             check(scan_count != EOF, "Unexpected EOF");
             check(scan_count > 0, "Nothing scanned");
+            int mat_size = width * width;
+
+            m1 = (double *)malloc(mat_size * sizeof(double));
+            m2 = (double *)malloc(mat_size * sizeof(double));
+            p = (double *)malloc(mat_size * sizeof(double));
+            for (int i = 0; i < mat_size; i++)
+            {
+                scan_count = scanf("%lf", m1 + i);
+                check(scan_count != EOF, "Unexpected EOF");
+                check(scan_count > 0, "Nothing scanned");
+            }
+            for (int i = 0; i < mat_size; i++)
+            {
+                scan_count = scanf("%lf", m2 + i);
+                check(scan_count != EOF, "Unexpected EOF");
+                check(scan_count > 0, "Nothing scanned");
+            }
+            debug("matrix read complete");
         }
-        debug("matrix read complete");
-    }
 
-    mpi_err = MPI_Bcast(&width, 1, MPI_INTEGER, 0, MPI_COMM_WORLD);
-    check(!mpi_err, "`MPI_Bcast` returned with error.");
+        mpi_err = MPI_Bcast(&width, 1, MPI_INTEGER, 0, MPI_COMM_WORLD);
+        check(!mpi_err, "`MPI_Bcast` returned with error.");
+
+        debug_mpi(proc_rank,"Performing matmul");
+        PERF_KERNEL_BEGIN();
+        start_time = MPI_Wtime();
+        my_err = matmul(m1, m2, p, width, proc_rank, num_procs);
+        end_time = MPI_Wtime();
+        PERF_KERNEL_END("matmul");
+        check(!my_err, "Something went wrong during matrix multiplication");
+        debug_mpi(proc_rank, "Returned from matmul");
+    }
     int mat_size = width * width;
-
-    debug_mpi(proc_rank,"Performing matmul");
-    double start_time = MPI_Wtime();
-    int my_err = matmul(m1, m2, p, width, proc_rank, num_procs);
-    double end_time = MPI_Wtime();
-    check(!my_err, "Something went wrong during matrix multiplication");
-    debug_mpi(proc_rank, "Returned from matmul");
-
     double execution_time_matmul = end_time - start_time;
 
-    if (proc_rank == 0) {
+    // Freivalds' test in O(width^2) on all processes, the reference
+    // product that may follow in the input is not read. The streamed
+    // matmul keeps no copy of M_1 and M_2, it is still checked against
+    // the reference
+    if (stream && proc_rank == 0)
+    {
         for (int i = 0; i < mat_size; i++)
         {
             double elmt;
@@ -96,14 +138,25 @@ int main(int argc, char *argv[])
             check(residue < threshold, "Bad numericals\
                     - matrix multiplication test case failed");
         }
+    }
+    else if (!stream)
+    {
+        my_err = verify_matmul_mpi(m1, m2, p, width, method_index == 2, VERIFY_TRIALS,
+                (uint64_t) time(NULL), VERIFY_TOL, proc_rank, num_procs);
+        check(!my_err, "Bad numericals - matrix multiplication test case failed");
+    }
+    if (m1)
         free(m1);
+    if (m2)
         free(m2);
-    }
+    m1 = m2 = NULL;
     debug_mpi(proc_rank, "m1 and m2 freed");
 
+    PERF_KERNEL_BEGIN();
     start_time = MPI_Wtime();
     my_err = gaussian_elimination_naive_inplace_mpi(p, width, proc_rank, num_procs);
     end_time = MPI_Wtime();
+    PERF_KERNEL_END("gaussian_elimination_naive_inplace_mpi");
     check(!my_err, "Error during gaussian elimination");
     debug("returned from gaussian elimination");
     double execution_time_elimination = end_time - start_time;
@@ -130,6 +183,8 @@ int main(int argc, char *argv[])
     debug_mpi(proc_rank, "Exit success");
     if (p)
         free(p);
+    mat_scratch_release();
+    TRACE_DUMP_MPI(proc_rank, num_procs);
     MPI_Finalize();
     return EXIT_SUCCESS; 
 error:
@@ -149,6 +204,7 @@ error:
     if (m1) free(m1);
     if (m2) free(m2);
     if (p) free(p);
+    mat_scratch_release();
     return EXIT_FAILURE;
 }
 
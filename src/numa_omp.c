@@ -0,0 +1,126 @@
+#include "dbg.h"
+#include "impl_omp.h"
+#include "matalloc.h"
+
+#include <linux/mempolicy.h>
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/* no libnuma, the node list comes from sysfs and the interleaving is
+ * a raw mbind */
+
+#define NUMA_MAX_NODES 1024
+#define MASK_BITS (8 * sizeof(unsigned long))
+
+
+/* parses /sys/devices/system/node/online ("0", "0-1", "0,2-3") into
+ * mask and returns the number of nodes, 0 if it cannot be read */
+static int
+online_nodes(unsigned long *mask)
+{
+    int count = 0, first, last;
+    FILE *file = fopen("/sys/devices/system/node/online", "r");
+    if (!file)
+        return 0;
+    memset(mask, 0, NUMA_MAX_NODES / 8);
+    while (fscanf(file, "%d", &first) == 1)
+    {
+        last = first;
+        int sep = fgetc(file);
+        if (sep == '-')
+        {
+            if (fscanf(file, "%d", &last) != 1)
+                break;
+            sep = fgetc(file);
+        }
+        for (int node = first; node <= last && node < NUMA_MAX_NODES; node++)
+        {
+            mask[node / MASK_BITS] |= 1ul << (node % MASK_BITS);
+            count++;
+        }
+        if (sep != ',')
+            break;
+    }
+    fclose(file);
+    return count;
+}
+
+
+int
+numa_num_nodes(void)
+{
+    unsigned long mask[NUMA_MAX_NODES / MASK_BITS];
+    const int count = online_nodes(mask);
+    return count > 0 ? count : 1;
+}
+
+
+static int
+interleave_pages(void *addr, size_t bytes)
+{
+    unsigned long mask[NUMA_MAX_NODES / MASK_BITS];
+    check(online_nodes(mask) > 0, "Could not read the online NUMA nodes");
+    check(!syscall(SYS_mbind, addr, bytes, MPOL_INTERLEAVE, mask,
+                (unsigned long) NUMA_MAX_NODES, 0u), "mbind failed");
+    return 0;
+error:
+    return -1;
+}
+
+
+double *
+numa_alloc_matrix_omp(uint32_t width, int policy)
+{
+    double *M = NULL;
+    const size_t mat_size = (size_t) width * width;
+    check(width > 0, "Non-positive width");
+    if (policy == NUMA_NONE)
+    {
+        M = (double *) malloc(mat_size * sizeof(double));
+        check_mem(M);
+        return M;
+    }
+
+    // whole pages, so that placing them touches nothing else, and
+    // whole huge pages for large matrices
+    size_t page = (size_t) sysconf(_SC_PAGESIZE);
+    if (mat_size * sizeof(double) >= MAT_HUGE_PAGE)
+        page = MAT_HUGE_PAGE;
+    const size_t bytes = (mat_size * sizeof(double) + page - 1) / page * page;
+    check(!posix_memalign((void **) &M, page, bytes), "Out of memory.");
+    mat_advise_hugepages(M, bytes);
+    if (policy == NUMA_INTERLEAVE && interleave_pages(M, bytes))
+        log_warn("Could not interleave, falling back to first touch");
+
+    // same static row schedule as the kernels
+#   pragma omp parallel for schedule(static)
+    for (uint32_t row = 0; row < width; row++)
+        memset(M + (size_t) row * width, 0, width * sizeof(double));
+    return M;
+error:
+    if (M)
+        free(M);
+    return NULL;
+}
+
+
+int
+numa_check_binding_omp(void)
+{
+    const int bound = omp_get_proc_bind() != omp_proc_bind_false;
+    if (!bound && numa_num_nodes() > 1)
+        log_warn("OpenMP threads are not bound on a %d node machine, "
+                "set OMP_PLACES=cores OMP_PROC_BIND=spread", numa_num_nodes());
+#   ifndef NDEBUG
+    for (int place = 0; bound && place < omp_get_num_places(); place++)
+    {
+        debug("place %d: %d processors", place, omp_get_place_num_procs(place));
+    }
+#   endif
+    return bound;
+}
@@ -1,6 +1,11 @@
 #include "dbg.h"
+#include "autotune.h"
 #include "impl_omp.h"
+#include "matalloc.h"
 #include "matrixio.h"
+#include "perf_counters.h"
+#include "trace.h"
+#include "verify.h"
 
 #include <math.h>
 #include <omp.h>
@@ -8,25 +13,17 @@
 #include <stdint.h>
 #include <inttypes.h>
 #include <stdlib.h>
+#include <time.h>
 
 
 impl_omp_t omp_matmul_methods[] = {matMulSquare_baseline_omp,
                                 matMulSquare_transpose_omp,
-                                matMulSquare_pretranspose_omp};
+                                matMulSquare_pretranspose_omp,
+                                matMulSquare_auto_omp};
 
 
 const int num_methods_omp = sizeof(omp_matmul_methods)/sizeof(impl_omp_t);
 
-const double THRESHOLD = 0.01l;
-
-static
-inline
-double percent_error(double of, double against)
-{
-    return fabs(of - against)/against * 100;
-}
-
-
 int main(int argc, char *argv[])
 {
     double *m1 = NULL, *m2 = NULL, *p = NULL;
@@ -39,10 +36,12 @@ int main(int argc, char *argv[])
     check(scan_rv != EOF, "Unexpected EOF");
     check(scan_rv > 0, "Nothing was scanned");
 
-    const int mat_size = widthi * widthi;
-    const int mem_size = mat_size * sizeof(double);
-    m1 = (double *)malloc(mem_size);
-    m2 = (double *)malloc(mem_size);
+    // placed before reading, so that parsing on one thread does
+    // not put all pages on its node
+    numa_check_binding_omp();
+    check(widthi > 0, "Non-positive width");
+    m1 = numa_alloc_matrix_omp(widthi, NUMA_FIRST_TOUCH);
+    m2 = numa_alloc_matrix_omp(widthi, NUMA_FIRST_TOUCH);
 
 
     int my_err = read_matrices(m1, m2, widthi, stdin);
@@ -65,31 +64,32 @@ int main(int argc, char *argv[])
         matmul = omp_matmul_methods[method_index];
     }
 
-    p = (double *)malloc(width * width * sizeof(double));
+    p = numa_alloc_matrix_omp(width, NUMA_FIRST_TOUCH);
+    check_mem(p);
+    PERF_KERNEL_BEGIN();
     double start_time = omp_get_wtime();
     my_err = matmul(m1, m2, p, width);
     double end_time = omp_get_wtime();
+    PERF_KERNEL_END("matmul");
     check(!my_err, "Something went wrong during matrix multiplication");
     double execution_time_matmul = end_time - start_time;
+
+    // Freivalds' test in O(width^2), the reference product that may
+    // follow in the input is not read, the pretranspose method expects
+    // M_2 transposed
+    my_err = verify_matmul_omp(m1, m2, p, width, method_index == 2,
+            VERIFY_TRIALS, (uint64_t) time(NULL), VERIFY_TOL);
+    check(!my_err, "Bad numericals - matrix multiplication test case failed");
     free(m1);  
     free(m2);
-
-    for (uint32_t i = 0; i < width * width; i++)
-    {
-        double elmt; 
-
-        scan_rv = scanf("%lf", &elmt);
-        check(scan_rv != EOF, "Unexpected EOF");
-        check(scan_rv > 0, "Nothing was scanned");
-        double prcnt_err = percent_error(p[i], elmt);
-        check(prcnt_err < THRESHOLD, "Bad numericals -\
-                matrix multiplication test case failed");
-    }
+    m1 = m2 = NULL;
     debug("Matrix multiplication complete");
     
+    PERF_KERNEL_BEGIN();
     start_time = omp_get_wtime();
     my_err = gaussian_elimination_naive_inplace_omp(p, width);
     end_time = omp_get_wtime();
+    PERF_KERNEL_END("gaussian_elimination_naive_inplace_omp");
     check(!my_err, "Something went wrong during gaussian elimination");
     double execution_time_elimination = end_time - start_time;
 
@@ -109,11 +109,14 @@ int main(int argc, char *argv[])
     printf("%u %d %lf %lf\n", width, num_threads,
             execution_time_matmul, execution_time_elimination);
     free(p);
+    mat_scratch_release();
+    TRACE_DUMP();
     return 0;
 error:
     if (m1) free(m1);
     if (m2) free(m2);
     if (p) free(p);
+    mat_scratch_release();
 
     return -1;
 }
@@ -0,0 +1,376 @@
+#include "dbg.h"
+#include "matalloc.h"
+#include "ooc.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+
+static int
+read_full(int fd, void *buf, size_t bytes, off_t offset)
+{
+    char *dest = (char *) buf;
+    while (bytes > 0)
+    {
+        ssize_t got = pread(fd, dest, bytes, offset);
+        if (got < 0 && errno == EINTR)
+            continue;
+        check(got > 0, "Short read at offset %lld", (long long) offset);
+        dest += got;
+        bytes -= (size_t) got;
+        offset += got;
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+static int
+write_full(int fd, const void *buf, size_t bytes, off_t offset)
+{
+    const char *src = (const char *) buf;
+    while (bytes > 0)
+    {
+        ssize_t put = pwrite(fd, src, bytes, offset);
+        if (put < 0 && errno == EINTR)
+            continue;
+        check(put > 0, "Short write at offset %lld", (long long) offset);
+        src += put;
+        bytes -= (size_t) put;
+        offset += put;
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+ooc_create(ooc_matrix_t *F, const char *path, uint64_t rows, uint64_t cols)
+{
+    check_mem(F);
+    F->fd = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    check(F->fd >= 0, "Could not create %s", path);
+    F->rows = rows;
+    F->cols = cols;
+    ooc_header_t header = {.rows = rows, .cols = cols, .reserved = 0};
+    memcpy(header.magic, OOC_MAGIC, sizeof(header.magic));
+    check(!write_full(F->fd, &header, sizeof(header), 0), "Could not write %s", path);
+    check(!ftruncate(F->fd, (off_t) (sizeof(header) + rows * cols * sizeof(double))),
+            "Could not size %s", path);
+    return 0;
+error:
+    if (F && F->fd >= 0)
+        close(F->fd);
+    if (F)
+        F->fd = -1;
+    return -1;
+}
+
+
+int
+ooc_open(ooc_matrix_t *F, const char *path, int writable)
+{
+    check_mem(F);
+    F->fd = open(path, writable ? O_RDWR : O_RDONLY);
+    check(F->fd >= 0, "Could not open %s", path);
+    ooc_header_t header;
+    check(!read_full(F->fd, &header, sizeof(header), 0), "Could not read %s", path);
+    check(!memcmp(header.magic, OOC_MAGIC, sizeof(header.magic)), "%s is not a matrix file", path);
+    F->rows = header.rows;
+    F->cols = header.cols;
+    // the panels are read front to back
+    posix_fadvise(F->fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    return 0;
+error:
+    if (F && F->fd >= 0)
+        close(F->fd);
+    if (F)
+        F->fd = -1;
+    return -1;
+}
+
+
+int
+ooc_close(ooc_matrix_t *F)
+{
+    if (!F || F->fd < 0)
+        return 0;
+    int rv = close(F->fd);
+    F->fd = -1;
+    return rv ? -1 : 0;
+}
+
+
+int
+ooc_read_rows(const ooc_matrix_t *F, double *buf, uint64_t row, uint64_t count)
+{
+    check(row + count <= F->rows, "Rows %llu to %llu out of range",
+            (unsigned long long) row, (unsigned long long) (row + count));
+    return read_full(F->fd, buf, count * F->cols * sizeof(double),
+            (off_t) (sizeof(ooc_header_t) + row * F->cols * sizeof(double)));
+error:
+    return -1;
+}
+
+
+int
+ooc_write_rows(const ooc_matrix_t *F, const double *buf, uint64_t row, uint64_t count)
+{
+    check(row + count <= F->rows, "Rows %llu to %llu out of range",
+            (unsigned long long) row, (unsigned long long) (row + count));
+    return write_full(F->fd, buf, count * F->cols * sizeof(double),
+            (off_t) (sizeof(ooc_header_t) + row * F->cols * sizeof(double)));
+error:
+    return -1;
+}
+
+
+int
+ooc_write_matrix(const char *path, const double *M, uint32_t width)
+{
+    ooc_matrix_t F = {.fd = -1};
+    check(!ooc_create(&F, path, width, width), "Could not create %s", path);
+    check(!ooc_write_rows(&F, M, 0, width), "Could not write %s", path);
+    return ooc_close(&F);
+error:
+    ooc_close(&F);
+    return -1;
+}
+
+
+int
+ooc_read_matrix(const char *path, double *M, uint32_t width)
+{
+    ooc_matrix_t F = {.fd = -1};
+    check(!ooc_open(&F, path, 0), "Could not open %s", path);
+    check(F.rows == width && F.cols == width, "%s is not %u wide", path, width);
+    check(!ooc_read_rows(&F, M, 0, width), "Could not read %s", path);
+    return ooc_close(&F);
+error:
+    ooc_close(&F);
+    return -1;
+}
+
+
+int
+ooc_convert_text(FILE *text, const char *path, uint32_t width)
+{
+    ooc_matrix_t F = {.fd = -1};
+    double *row_buf = NULL;
+    check(text, "Not a valid FILE pointer");
+    row_buf = (double *) malloc(width * sizeof(double));
+    check_mem(row_buf);
+    check(!ooc_create(&F, path, width, width), "Could not create %s", path);
+    for (uint32_t row = 0; row < width; row++)
+    {
+        for (uint32_t col = 0; col < width; col++)
+        {
+            int scan_flag = fscanf(text, "%lf", row_buf + col);
+            check(scan_flag != EOF, "Unexpected EOF");
+            check(scan_flag > 0, "Nothing was scanned");
+        }
+        check(!ooc_write_rows(&F, row_buf, row, 1), "Could not write %s", path);
+    }
+    free(row_buf);
+    return ooc_close(&F);
+error:
+    if (row_buf)
+        free(row_buf);
+    ooc_close(&F);
+    return -1;
+}
+
+
+// rows per panel for buffers panels wide, at least one
+static uint64_t
+panel_rows(size_t memory, uint64_t width, int buffers)
+{
+    uint64_t rows = memory / (buffers * width * sizeof(double));
+    if (rows < 1)
+        rows = 1;
+    return rows < width ? rows : width;
+}
+
+
+int
+matMulSquare_ooc_omp(const char *left, const char *right, const char *product,
+        size_t memory)
+{
+    ooc_matrix_t A = {.fd = -1}, B = {.fd = -1}, C = {.fd = -1};
+    double *work = NULL;
+    check(!ooc_open(&A, left, 0), "Could not open %s", left);
+    check(!ooc_open(&B, right, 0), "Could not open %s", right);
+    const uint64_t width = A.rows;
+    check(A.cols == width && B.rows == width && B.cols == width, "Operands are not square of one width");
+    check(!ooc_create(&C, product, width, width), "Could not create %s", product);
+
+    // a panel of rows of A and of C, two of B
+    const uint64_t panel = panel_rows(memory, width, 4);
+    const size_t panel_size = panel * width;
+    work = (double *) mat_alloc(4 * panel_size * sizeof(double));
+    check_mem(work);
+    double *A_panel = work, *C_panel = work + panel_size;
+    double *B_panel[2] = {work + 2 * panel_size, work + 3 * panel_size};
+    const uint64_t steps = (width + panel - 1) / panel;
+
+    for (uint64_t row0 = 0; row0 < width; row0 += panel)
+    {
+        const uint64_t rows = width - row0 < panel ? width - row0 : panel;
+        check(!ooc_read_rows(&A, A_panel, row0, rows), "Could not read %s", left);
+        check(!ooc_read_rows(&B, B_panel[0], 0, panel), "Could not read %s", right);
+        memset(C_panel, 0, rows * width * sizeof(double));
+        int read_err = 0;
+
+#       pragma omp parallel
+        for (uint64_t step = 0; step < steps; step++)
+        {
+            const uint64_t k0 = step * panel;
+            const uint64_t ks = width - k0 < panel ? width - k0 : panel;
+            const double *B_cur = B_panel[step % 2];
+
+            // one thread fetches the next panel of B, then joins in
+#           pragma omp single nowait
+            if (step + 1 < steps)
+            {
+                const uint64_t next = k0 + panel;
+                const uint64_t count = width - next < panel ? width - next : panel;
+                if (ooc_read_rows(&B, B_panel[(step + 1) % 2], next, count))
+                {
+#                   pragma omp atomic write
+                    read_err = 1;
+                }
+            }
+
+#           pragma omp for schedule(dynamic)
+            for (uint64_t row = 0; row < rows; row++)
+            {
+                double *C_row = C_panel + row * width;
+                const double *A_row = A_panel + row * width + k0;
+                for (uint64_t k = 0; k < ks; k++)
+                {
+                    const double elmt = A_row[k];
+                    const double *B_row = B_cur + k * width;
+                    for (uint64_t col = 0; col < width; col++)
+                        C_row[col] += elmt * B_row[col];
+                }
+            }
+        }
+        check(!read_err, "Could not read %s", right);
+        check(!ooc_write_rows(&C, C_panel, row0, rows), "Could not write %s", product);
+    }
+
+    mat_free(work);
+    ooc_close(&A); ooc_close(&B);
+    check(!ooc_close(&C), "Could not close %s", product);
+    return 0;
+error:
+    if (work)
+        mat_free(work);
+    ooc_close(&A); ooc_close(&B); ooc_close(&C);
+    return -1;
+}
+
+
+int
+gaussian_elimination_ooc_omp(const char *path, size_t memory)
+{
+    ooc_matrix_t F = {.fd = -1};
+    double *work = NULL;
+    check(!ooc_open(&F, path, 1), "Could not open %s", path);
+    const uint64_t width = F.rows;
+    check(F.cols == width, "Not a square matrix");
+
+    // the panel being eliminated and two of the rows above it
+    const uint64_t panel = panel_rows(memory, width, 3);
+    const size_t panel_size = panel * width;
+    work = (double *) mat_alloc(3 * panel_size * sizeof(double));
+    check_mem(work);
+    double *cur = work;
+    double *U_panel[2] = {work + panel_size, work + 2 * panel_size};
+
+    for (uint64_t row0 = 0; row0 < width; row0 += panel)
+    {
+        const uint64_t rows = width - row0 < panel ? width - row0 : panel;
+        const uint64_t steps = row0 / panel;
+        check(!ooc_read_rows(&F, cur, row0, rows), "Could not read %s", path);
+        if (steps > 0)
+            check(!ooc_read_rows(&F, U_panel[0], 0, panel), "Could not read %s", path);
+        int read_err = 0, pivot_err = 0;
+
+        // the rows of the panel are independent under the updates of
+        // the finished rows above, each takes a whole streamed panel
+#       pragma omp parallel
+        for (uint64_t step = 0; step < steps; step++)
+        {
+            const uint64_t k0 = step * panel;
+            const double *U_cur = U_panel[step % 2];
+#           pragma omp single nowait
+            if (step + 1 < steps)
+            {
+                if (ooc_read_rows(&F, U_panel[(step + 1) % 2], k0 + panel, panel))
+                {
+#                   pragma omp atomic write
+                    read_err = 1;
+                }
+            }
+
+#           pragma omp for schedule(dynamic)
+            for (uint64_t row = 0; row < rows; row++)
+            {
+                double *M_row = cur + row * width;
+                for (uint64_t k = 0; k < panel; k++)
+                {
+                    const uint64_t iter = k0 + k;
+                    const double *U_row = U_cur + k * width;
+                    if (U_row[iter] == 0.0)
+                    {
+#                       pragma omp atomic write
+                        pivot_err = 1;
+                        continue;
+                    }
+                    const double factor = M_row[iter] / U_row[iter];
+                    for (uint64_t col = iter + 1; col < width; col++)
+                        M_row[col] -= factor * U_row[col];
+                    M_row[iter] = 0.0l;
+                }
+            }
+        }
+        check(!read_err, "Could not read %s", path);
+        check(!pivot_err, "Zero pivot found! Use partial pivoting algo.");
+
+        // then the panel on its own, as the in-memory sweep
+        for (uint64_t k = 0; k + 1 < rows; k++)
+        {
+            const uint64_t iter = row0 + k;
+            const double *pivot_row = cur + k * width;
+            const double pivot = pivot_row[iter];
+            check(pivot != 0, "Zero pivot found! Use partial pivoting algo.");
+#           pragma omp parallel for schedule(static)
+            for (uint64_t row = k + 1; row < rows; row++)
+            {
+                double *M_row = cur + row * width;
+                const double factor = M_row[iter] / pivot;
+                for (uint64_t col = iter + 1; col < width; col++)
+                    M_row[col] -= factor * pivot_row[col];
+                M_row[iter] = 0.0l;
+            }
+        }
+        check(!ooc_write_rows(&F, cur, row0, rows), "Could not write %s", path);
+    }
+
+    mat_free(work);
+    return ooc_close(&F);
+error:
+    if (work)
+        mat_free(work);
+    ooc_close(&F);
+    return -1;
+}
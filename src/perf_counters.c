@@ -0,0 +1,146 @@
+#include "dbg.h"
+#include "perf_counters.h"
+
+#include <linux/perf_event.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Only built with -DPERF_COUNTERS, see perf_counters.h */
+
+#define NUM_EVENTS 5
+
+static const struct {
+    uint32_t type;
+    uint64_t config;
+} events[NUM_EVENTS] = {
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+    {PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB
+        | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+};
+
+// -1: not looked at the environment yet, 0: off, 1: on
+static int enabled = -1;
+static FILE *out = NULL;
+static int rank = 0;
+static unsigned long invocation = 0;
+
+// per thread, counters are opened on first use by each thread
+static _Thread_local int fds[NUM_EVENTS];
+static _Thread_local int opened = 0;
+static _Thread_local int64_t start[NUM_EVENTS];
+
+
+static int
+perf_enabled(void)
+{
+    if (enabled < 0)
+    {
+        const char *env = getenv("PERF_COUNTERS");
+        enabled = env && strcmp(env, "") && strcmp(env, "0");
+        if (enabled)
+        {
+            out = strcmp(env, "1") ? fopen(env, "a") : stderr;
+            if (!out)
+            {
+                log_warn("Could not open %s, performance counters disabled", env);
+                enabled = 0;
+            }
+        }
+    }
+    return enabled;
+}
+
+
+static void
+open_counters(void)
+{
+    for (int i = 0; i < NUM_EVENTS; i++)
+    {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = events[i].type;
+        attr.config = events[i].config;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // this thread, any cpu
+        fds[i] = (int) syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+    if (fds[0] < 0)
+    {
+        debug("perf_event_open failed, check /proc/sys/kernel/perf_event_paranoid");
+    }
+    opened = 1;
+}
+
+
+static void
+read_counters(int64_t *values)
+{
+    if (!opened)
+        open_counters();
+    for (int i = 0; i < NUM_EVENTS; i++)
+    {
+        uint64_t value;
+        values[i] = (fds[i] >= 0 && read(fds[i], &value, sizeof(value)) == sizeof(value))
+            ? (int64_t) value : -1;
+    }
+}
+
+
+void
+perf_set_rank(int r)
+{
+    rank = r;
+}
+
+
+void
+perf_kernel_begin(void)
+{
+    if (!perf_enabled())
+        return;
+#   ifdef _OPENMP
+#   pragma omp parallel
+#   endif
+    read_counters(start);
+}
+
+
+void
+perf_kernel_end(const char *name)
+{
+    if (!perf_enabled())
+        return;
+    const unsigned long id = invocation++;
+#   ifdef _OPENMP
+#   pragma omp parallel
+#   endif
+    {
+        int64_t end[NUM_EVENTS];
+        int thread = 0;
+        read_counters(end);
+#       ifdef _OPENMP
+        thread = omp_get_thread_num();
+#       endif
+        for (int i = 0; i < NUM_EVENTS; i++)
+            end[i] = (end[i] < 0 || start[i] < 0) ? -1 : end[i] - start[i];
+        // a single fprintf per line, so lines of different threads
+        // don't get mixed up
+        fprintf(out, "%s,%lu,%d,%d,%lld,%lld,%lld,%lld,%lld\n", name, id,
+                rank, thread, (long long) end[0], (long long) end[1],
+                (long long) end[2], (long long) end[3], (long long) end[4]);
+    }
+    fflush(out);
+}
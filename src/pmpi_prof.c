@@ -0,0 +1,509 @@
+#include "dbg.h"
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* PMPI interposition profiler.
+ *
+ * Linked into a target (`make mpi PROF=1`) or preloaded into any MPI
+ * binary (`make pmpi`, then LD_PRELOAD=bin/libpmpiprof.so), this
+ * wraps the MPI calls used by the kernels and records per rank and
+ * per function the number of calls, the bytes this rank sent and
+ * received, and the time spent inside the call. At MPI_Finalize the
+ * numbers are gathered on rank 0, which prints min/mean/max across
+ * ranks and the imbalance (max/mean - 1) per function, followed by
+ * the compute (wall time minus MPI time) vs communication split of
+ * every rank.
+ *
+ * The bytes of a nonblocking call are booked when it is posted, and
+ * the time it takes to complete under the waits and tests that
+ * complete it.
+ *
+ * PMPI_PROF_SYNC=1 puts a barrier in front of every collective and
+ * books the time spent in it as waiting, so that the time left in the
+ * collective is the transfer itself. This changes the timing of the
+ * program, leave it off for plain totals. PMPI_PROF_FILE=<path>
+ * writes the report there instead of to stderr. */
+
+enum {
+    PROF_BCAST, PROF_SCATTER, PROF_SCATTERV, PROF_GATHER, PROF_GATHERV,
+    PROF_ALLGATHER, PROF_ALLGATHERV, PROF_REDUCE, PROF_ALLREDUCE,
+    PROF_ALLTOALL, PROF_ALLTOALLV, PROF_ALLTOALLW, PROF_BARRIER, PROF_SEND, PROF_RECV,
+    PROF_ISEND, PROF_IRECV, PROF_IBCAST, PROF_WAIT, PROF_WAITALL, PROF_TEST,
+    PROF_TESTALL, NUM_PROF
+};
+
+static const char *prof_names[NUM_PROF] = {
+    "MPI_Bcast", "MPI_Scatter", "MPI_Scatterv", "MPI_Gather", "MPI_Gatherv",
+    "MPI_Allgather", "MPI_Allgatherv", "MPI_Reduce", "MPI_Allreduce",
+    "MPI_Alltoall", "MPI_Alltoallv", "MPI_Alltoallw", "MPI_Barrier", "MPI_Send", "MPI_Recv",
+    "MPI_Isend", "MPI_Irecv", "MPI_Ibcast", "MPI_Wait", "MPI_Waitall", "MPI_Test",
+    "MPI_Testall"
+};
+
+// kept as doubles so that one reduction handles all of them
+enum { STAT_CALLS, STAT_BYTES, STAT_TIME, STAT_WAIT, NUM_STATS };
+
+static double stats[NUM_PROF][NUM_STATS];
+static double init_time = 0.0;
+static int sync_collectives = 0;
+
+
+static double
+type_bytes(int count, MPI_Datatype type)
+{
+    int size = 0;
+    // the type beside an MPI_IN_PLACE buffer may be left null
+    if (type == MPI_DATATYPE_NULL)
+        return 0.0;
+    PMPI_Type_size(type, &size);
+    return (double) count * size;
+}
+
+
+static double
+sum_bytes(const int *counts, MPI_Datatype type, MPI_Comm comm)
+{
+    int num_procs;
+    double bytes = 0.0;
+    PMPI_Comm_size(comm, &num_procs);
+    for (int i = 0; i < num_procs; i++)
+        bytes += type_bytes(counts[i], type);
+    return bytes;
+}
+
+
+static int
+is_root(int root, MPI_Comm comm)
+{
+    int rank;
+    PMPI_Comm_rank(comm, &rank);
+    return rank == root;
+}
+
+
+static double
+prof_begin(int id, MPI_Comm comm)
+{
+    if (sync_collectives && comm != MPI_COMM_NULL)
+    {
+        double start = PMPI_Wtime();
+        PMPI_Barrier(comm);
+        stats[id][STAT_WAIT] += PMPI_Wtime() - start;
+    }
+    return PMPI_Wtime();
+}
+
+
+static void
+prof_end(int id, double start, double bytes)
+{
+    stats[id][STAT_CALLS] += 1.0;
+    stats[id][STAT_BYTES] += bytes;
+    stats[id][STAT_TIME] += PMPI_Wtime() - start;
+}
+
+
+int
+MPI_Init(int *argc, char ***argv)
+{
+    int err = PMPI_Init(argc, argv);
+    const char *env = getenv("PMPI_PROF_SYNC");
+    sync_collectives = env && !strcmp(env, "1");
+    init_time = PMPI_Wtime();
+    return err;
+}
+
+
+int
+MPI_Bcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm)
+{
+    double start = prof_begin(PROF_BCAST, comm);
+    int err = PMPI_Bcast(buf, count, type, root, comm);
+    prof_end(PROF_BCAST, start, type_bytes(count, type));
+    return err;
+}
+
+
+int
+MPI_Scatter(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+        void *recvbuf, int recvcount, MPI_Datatype recvtype,
+        int root, MPI_Comm comm)
+{
+    double start = prof_begin(PROF_SCATTER, comm);
+    int err = PMPI_Scatter(sendbuf, sendcount, sendtype, recvbuf,
+            recvcount, recvtype, root, comm);
+    double bytes = recvbuf != MPI_IN_PLACE ? type_bytes(recvcount, recvtype) : 0.0;
+    if (is_root(root, comm))
+    {
+        int num_procs;
+        PMPI_Comm_size(comm, &num_procs);
+        bytes += num_procs * type_bytes(sendcount, sendtype);
+    }
+    prof_end(PROF_SCATTER, start, bytes);
+    return err;
+}
+
+
+int
+MPI_Scatterv(const void *sendbuf, const int *sendcounts, const int *displs,
+        MPI_Datatype sendtype, void *recvbuf, int recvcount,
+        MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+    double start = prof_begin(PROF_SCATTERV, comm);
+    int err = PMPI_Scatterv(sendbuf, sendcounts, displs, sendtype, recvbuf,
+            recvcount, recvtype, root, comm);
+    double bytes = recvbuf != MPI_IN_PLACE ? type_bytes(recvcount, recvtype) : 0.0;
+    if (is_root(root, comm))
+        bytes += sum_bytes(sendcounts, sendtype, comm);
+    prof_end(PROF_SCATTERV, start, bytes);
+    return err;
+}
+
+
+int
+MPI_Gather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+        void *recvbuf, int recvcount, MPI_Datatype recvtype,
+        int root, MPI_Comm comm)
+{
+    double start = prof_begin(PROF_GATHER, comm);
+    int err = PMPI_Gather(sendbuf, sendcount, sendtype, recvbuf,
+            recvcount, recvtype, root, comm);
+    double bytes = sendbuf != MPI_IN_PLACE ? type_bytes(sendcount, sendtype) : 0.0;
+    if (is_root(root, comm))
+    {
+        int num_procs;
+        PMPI_Comm_size(comm, &num_procs);
+        bytes += num_procs * type_bytes(recvcount, recvtype);
+    }
+    prof_end(PROF_GATHER, start, bytes);
+    return err;
+}
+
+
+int
+MPI_Gatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+        void *recvbuf, const int *recvcounts, const int *displs,
+        MPI_Datatype recvtype, int root, MPI_Comm comm)
+{
+    double start = prof_begin(PROF_GATHERV, comm);
+    int err = PMPI_Gatherv(sendbuf, sendcount, sendtype, recvbuf,
+            recvcounts, displs, recvtype, root, comm);
+    double bytes = sendbuf != MPI_IN_PLACE ? type_bytes(sendcount, sendtype) : 0.0;
+    if (is_root(root, comm))
+        bytes += sum_bytes(recvcounts, recvtype, comm);
+    prof_end(PROF_GATHERV, start, bytes);
+    return err;
+}
+
+
+int
+MPI_Allgather(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+        void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm)
+{
+    double start = prof_begin(PROF_ALLGATHER, comm);
+    int err = PMPI_Allgather(sendbuf, sendcount, sendtype, recvbuf,
+            recvcount, recvtype, comm);
+    int num_procs;
+    PMPI_Comm_size(comm, &num_procs);
+    double bytes = sendbuf != MPI_IN_PLACE ? type_bytes(sendcount, sendtype) : 0.0;
+    prof_end(PROF_ALLGATHER, start, bytes + num_procs * type_bytes(recvcount, recvtype));
+    return err;
+}
+
+
+int
+MPI_Allgatherv(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+        void *recvbuf, const int *recvcounts, const int *displs,
+        MPI_Datatype recvtype, MPI_Comm comm)
+{
+    double start = prof_begin(PROF_ALLGATHERV, comm);
+    int err = PMPI_Allgatherv(sendbuf, sendcount, sendtype, recvbuf,
+            recvcounts, displs, recvtype, comm);
+    double bytes = sendbuf != MPI_IN_PLACE ? type_bytes(sendcount, sendtype) : 0.0;
+    prof_end(PROF_ALLGATHERV, start, bytes + sum_bytes(recvcounts, recvtype, comm));
+    return err;
+}
+
+
+int
+MPI_Reduce(const void *sendbuf, void *recvbuf, int count,
+        MPI_Datatype type, MPI_Op op, int root, MPI_Comm comm)
+{
+    double start = prof_begin(PROF_REDUCE, comm);
+    int err = PMPI_Reduce(sendbuf, recvbuf, count, type, op, root, comm);
+    prof_end(PROF_REDUCE, start, type_bytes(count, type));
+    return err;
+}
+
+
+int
+MPI_Allreduce(const void *sendbuf, void *recvbuf, int count,
+        MPI_Datatype type, MPI_Op op, MPI_Comm comm)
+{
+    double start = prof_begin(PROF_ALLREDUCE, comm);
+    int err = PMPI_Allreduce(sendbuf, recvbuf, count, type, op, comm);
+    prof_end(PROF_ALLREDUCE, start, 2.0 * type_bytes(count, type));
+    return err;
+}
+
+
+int
+MPI_Alltoall(const void *sendbuf, int sendcount, MPI_Datatype sendtype,
+        void *recvbuf, int recvcount, MPI_Datatype recvtype, MPI_Comm comm)
+{
+    double start = prof_begin(PROF_ALLTOALL, comm);
+    int err = PMPI_Alltoall(sendbuf, sendcount, sendtype, recvbuf,
+            recvcount, recvtype, comm);
+    int num_procs;
+    PMPI_Comm_size(comm, &num_procs);
+    prof_end(PROF_ALLTOALL, start, num_procs * (type_bytes(sendcount, sendtype)
+            + type_bytes(recvcount, recvtype)));
+    return err;
+}
+
+
+int
+MPI_Alltoallv(const void *sendbuf, const int *sendcounts, const int *sdispls,
+        MPI_Datatype sendtype, void *recvbuf, const int *recvcounts,
+        const int *rdispls, MPI_Datatype recvtype, MPI_Comm comm)
+{
+    double start = prof_begin(PROF_ALLTOALLV, comm);
+    int err = PMPI_Alltoallv(sendbuf, sendcounts, sdispls, sendtype,
+            recvbuf, recvcounts, rdispls, recvtype, comm);
+    prof_end(PROF_ALLTOALLV, start, sum_bytes(sendcounts, sendtype, comm)
+            + sum_bytes(recvcounts, recvtype, comm));
+    return err;
+}
+
+
+int
+MPI_Alltoallw(const void *sendbuf, const int *sendcounts, const int *sdispls,
+        const MPI_Datatype *sendtypes, void *recvbuf, const int *recvcounts,
+        const int *rdispls, const MPI_Datatype *recvtypes, MPI_Comm comm)
+{
+    int num_procs;
+    double bytes = 0.0;
+    double start = prof_begin(PROF_ALLTOALLW, comm);
+    int err = PMPI_Alltoallw(sendbuf, sendcounts, sdispls, sendtypes,
+            recvbuf, recvcounts, rdispls, recvtypes, comm);
+    PMPI_Comm_size(comm, &num_procs);
+    for (int i = 0; i < num_procs; i++)
+        bytes += type_bytes(sendcounts[i], sendtypes[i]) + type_bytes(recvcounts[i], recvtypes[i]);
+    prof_end(PROF_ALLTOALLW, start, bytes);
+    return err;
+}
+
+
+int
+MPI_Barrier(MPI_Comm comm)
+{
+    double start = PMPI_Wtime();
+    int err = PMPI_Barrier(comm);
+    prof_end(PROF_BARRIER, start, 0.0);
+    return err;
+}
+
+
+int
+MPI_Send(const void *buf, int count, MPI_Datatype type, int dest,
+        int tag, MPI_Comm comm)
+{
+    double start = PMPI_Wtime();
+    int err = PMPI_Send(buf, count, type, dest, tag, comm);
+    prof_end(PROF_SEND, start, type_bytes(count, type));
+    return err;
+}
+
+
+int
+MPI_Recv(void *buf, int count, MPI_Datatype type, int source, int tag,
+        MPI_Comm comm, MPI_Status *status)
+{
+    double start = PMPI_Wtime();
+    int err = PMPI_Recv(buf, count, type, source, tag, comm, status);
+    prof_end(PROF_RECV, start, type_bytes(count, type));
+    return err;
+}
+
+
+int
+MPI_Isend(const void *buf, int count, MPI_Datatype type, int dest,
+        int tag, MPI_Comm comm, MPI_Request *request)
+{
+    double start = PMPI_Wtime();
+    int err = PMPI_Isend(buf, count, type, dest, tag, comm, request);
+    prof_end(PROF_ISEND, start, type_bytes(count, type));
+    return err;
+}
+
+
+int
+MPI_Irecv(void *buf, int count, MPI_Datatype type, int source, int tag,
+        MPI_Comm comm, MPI_Request *request)
+{
+    double start = PMPI_Wtime();
+    int err = PMPI_Irecv(buf, count, type, source, tag, comm, request);
+    prof_end(PROF_IRECV, start, type_bytes(count, type));
+    return err;
+}
+
+
+// never synchronised, a barrier would complete nothing of it
+int
+MPI_Ibcast(void *buf, int count, MPI_Datatype type, int root, MPI_Comm comm,
+        MPI_Request *request)
+{
+    double start = PMPI_Wtime();
+    int err = PMPI_Ibcast(buf, count, type, root, comm, request);
+    prof_end(PROF_IBCAST, start, type_bytes(count, type));
+    return err;
+}
+
+
+int
+MPI_Wait(MPI_Request *request, MPI_Status *status)
+{
+    double start = PMPI_Wtime();
+    int err = PMPI_Wait(request, status);
+    prof_end(PROF_WAIT, start, 0.0);
+    return err;
+}
+
+
+int
+MPI_Waitall(int count, MPI_Request requests[], MPI_Status statuses[])
+{
+    double start = PMPI_Wtime();
+    int err = PMPI_Waitall(count, requests, statuses);
+    prof_end(PROF_WAITALL, start, 0.0);
+    return err;
+}
+
+
+int
+MPI_Test(MPI_Request *request, int *flag, MPI_Status *status)
+{
+    double start = PMPI_Wtime();
+    int err = PMPI_Test(request, flag, status);
+    prof_end(PROF_TEST, start, 0.0);
+    return err;
+}
+
+
+int
+MPI_Testall(int count, MPI_Request requests[], int *flag, MPI_Status statuses[])
+{
+    double start = PMPI_Wtime();
+    int err = PMPI_Testall(count, requests, flag, statuses);
+    prof_end(PROF_TESTALL, start, 0.0);
+    return err;
+}
+
+
+static void
+report(FILE *file, const double *all, const double *walls, int num_procs)
+{
+    // all is num_procs blocks of NUM_PROF x NUM_STATS
+    const int block = NUM_PROF * NUM_STATS;
+    double wall_max = 0.0;
+    for (int r = 0; r < num_procs; r++)
+        wall_max = walls[r] > wall_max ? walls[r] : wall_max;
+
+    fprintf(file, "PMPI profile: %d ranks, wall time %.6f s%s\n", num_procs,
+            wall_max, sync_collectives ? ", collectives synchronised" : "");
+    fprintf(file, "%-15s %10s %14s %12s %12s %12s %10s %12s\n", "function",
+            "calls", "bytes", "time min", "time mean", "time max",
+            "imbalance", "wait mean");
+    for (int id = 0; id < NUM_PROF; id++)
+    {
+        double calls = 0.0, bytes = 0.0, t_min = 0.0, t_max = 0.0, t_sum = 0.0, w_sum = 0.0;
+        for (int r = 0; r < num_procs; r++)
+        {
+            const double *s = all + r * block + id * NUM_STATS;
+            calls += s[STAT_CALLS];
+            bytes += s[STAT_BYTES];
+            t_sum += s[STAT_TIME];
+            w_sum += s[STAT_WAIT];
+            t_min = (r == 0 || s[STAT_TIME] < t_min) ? s[STAT_TIME] : t_min;
+            t_max = s[STAT_TIME] > t_max ? s[STAT_TIME] : t_max;
+        }
+        if (calls == 0.0)
+            continue;
+        const double t_mean = t_sum / num_procs;
+        fprintf(file, "%-15s %10.0f %14.0f %12.6f %12.6f %12.6f %9.1f%% %12.6f\n",
+                prof_names[id], calls, bytes, t_min, t_mean, t_max,
+                t_mean > 0.0 ? 100.0 * (t_max / t_mean - 1.0) : 0.0,
+                w_sum / num_procs);
+    }
+
+    fprintf(file, "%-6s %12s %12s %12s %8s\n", "rank", "wall", "mpi", "compute", "mpi %");
+    double compute_sum = 0.0, compute_max = 0.0;
+    int straggler = 0;
+    for (int r = 0; r < num_procs; r++)
+    {
+        double mpi = 0.0;
+        for (int id = 0; id < NUM_PROF; id++)
+            mpi += all[r * block + id * NUM_STATS + STAT_TIME]
+                + all[r * block + id * NUM_STATS + STAT_WAIT];
+        const double compute = walls[r] - mpi;
+        compute_sum += compute;
+        if (compute > compute_max)
+        {
+            compute_max = compute;
+            straggler = r;
+        }
+        fprintf(file, "%-6d %12.6f %12.6f %12.6f %7.1f%%\n", r, walls[r], mpi,
+                compute, walls[r] > 0.0 ? 100.0 * mpi / walls[r] : 0.0);
+    }
+    const double compute_mean = compute_sum / num_procs;
+    fprintf(file, "slowest rank: %d, compute %.6f s (%.1f%% above mean)\n",
+            straggler, compute_max,
+            compute_mean > 0.0 ? 100.0 * (compute_max / compute_mean - 1.0) : 0.0);
+}
+
+
+int
+MPI_Finalize(void)
+{
+    double *all = NULL, *walls = NULL;
+    int rank, num_procs;
+    double wall = PMPI_Wtime() - init_time;
+    PMPI_Comm_rank(MPI_COMM_WORLD, &rank);
+    PMPI_Comm_size(MPI_COMM_WORLD, &num_procs);
+
+    if (rank == 0)
+    {
+        all = (double *) malloc((size_t) num_procs * NUM_PROF * NUM_STATS * sizeof(double));
+        walls = (double *) malloc(num_procs * sizeof(double));
+    }
+    PMPI_Gather(stats, NUM_PROF * NUM_STATS, MPI_DOUBLE, all,
+            NUM_PROF * NUM_STATS, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    PMPI_Gather(&wall, 1, MPI_DOUBLE, walls, 1, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+
+    if (rank == 0)
+    {
+        if (all && walls)
+        {
+            const char *path = getenv("PMPI_PROF_FILE");
+            FILE *file = path ? fopen(path, "w") : stderr;
+            if (!file)
+            {
+                log_warn("Could not open %s, reporting to stderr", path);
+                file = stderr;
+            }
+            report(file, all, walls, num_procs);
+            if (file != stderr)
+                fclose(file);
+        }
+        else
+        {
+            log_warn("Out of memory, no PMPI profile");
+        }
+        free(all);
+        free(walls);
+    }
+    return PMPI_Finalize();
+}
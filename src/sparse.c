@@ -0,0 +1,602 @@
+#include "dbg.h"
+#include "sparse.h"
+
+#include <omp.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+
+static int
+alloc_entries(sparse_matrix_t *S, uint32_t nnz)
+{
+    S->nnz = nnz;
+    // one more, so that an empty matrix still has valid pointers
+    S->col_idx = (uint32_t *) malloc(((size_t) nnz + 1) * sizeof(uint32_t));
+    check_mem(S->col_idx);
+    S->val = (double *) malloc(((size_t) nnz + 1) * sizeof(double));
+    check_mem(S->val);
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+sparse_alloc(sparse_matrix_t *S, uint32_t rows, uint32_t cols, uint32_t nnz)
+{
+    check_mem(S);
+    S->row_ptr = S->col_idx = NULL;
+    S->val = NULL;
+    S->rows = rows;
+    S->cols = cols;
+    S->row_ptr = (uint32_t *) calloc((size_t) rows + 1, sizeof(uint32_t));
+    check_mem(S->row_ptr);
+    check(!alloc_entries(S, nnz), "Out of memory.");
+    return 0;
+error:
+    sparse_free(S);
+    return -1;
+}
+
+
+void
+sparse_free(sparse_matrix_t *S)
+{
+    if (!S)
+        return;
+    if (S->row_ptr)
+        free(S->row_ptr);
+    if (S->col_idx)
+        free(S->col_idx);
+    if (S->val)
+        free(S->val);
+    S->row_ptr = S->col_idx = NULL;
+    S->val = NULL;
+    S->nnz = 0;
+}
+
+
+int
+sparse_from_dense(sparse_matrix_t *S, const double *M, uint32_t rows, uint32_t cols)
+{
+    check_mem(S); check_mem(M);
+    S->row_ptr = S->col_idx = NULL;
+    S->val = NULL;
+    S->rows = rows;
+    S->cols = cols;
+    S->row_ptr = (uint32_t *) calloc((size_t) rows + 1, sizeof(uint32_t));
+    check_mem(S->row_ptr);
+
+#   pragma omp parallel for schedule(static)
+    for (uint32_t row = 0; row < rows; row++)
+    {
+        uint32_t count = 0;
+        for (uint32_t col = 0; col < cols; col++)
+            count += M[(size_t) row*cols + col] != 0.0;
+        S->row_ptr[row + 1] = count;
+    }
+    for (uint32_t row = 0; row < rows; row++)
+        S->row_ptr[row + 1] += S->row_ptr[row];
+    check(!alloc_entries(S, S->row_ptr[rows]), "Out of memory.");
+
+#   pragma omp parallel for schedule(static)
+    for (uint32_t row = 0; row < rows; row++)
+    {
+        uint32_t e = S->row_ptr[row];
+        for (uint32_t col = 0; col < cols; col++)
+        {
+            const double elmt = M[(size_t) row*cols + col];
+            if (elmt != 0.0)
+            {
+                S->col_idx[e] = col;
+                S->val[e++] = elmt;
+            }
+        }
+    }
+    return 0;
+error:
+    sparse_free(S);
+    return -1;
+}
+
+
+int
+sparse_to_dense(const sparse_matrix_t *S, double *M)
+{
+    check_mem(S); check_mem(M);
+#   pragma omp parallel for schedule(static)
+    for (uint32_t row = 0; row < S->rows; row++)
+    {
+        double *M_row = M + (size_t) row * S->cols;
+        memset(M_row, 0, S->cols * sizeof(double));
+        for (uint32_t e = S->row_ptr[row]; e < S->row_ptr[row + 1]; e++)
+            M_row[S->col_idx[e]] = S->val[e];
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+sparse_read_matrix(FILE *file, sparse_matrix_t *S, uint32_t width)
+{
+    check(!sparse_alloc(S, width, width, width), "Out of memory.");
+    check(file, "Not a valid FILE pointer");
+    uint32_t capacity = width, nnz = 0;
+    for (uint32_t row = 0; row < width; row++)
+    {
+        for (uint32_t col = 0; col < width; col++)
+        {
+            double elmt;
+            int scan_flag = fscanf(file, "%lf", &elmt);
+            check(scan_flag != EOF, "Unexpected EOF");
+            check(scan_flag > 0, "Nothing was scanned");
+            if (elmt == 0.0)
+                continue;
+            if (nnz == capacity)
+            {
+                capacity *= 2;
+                uint32_t *col_idx = (uint32_t *) realloc(S->col_idx, ((size_t) capacity + 1) * sizeof(uint32_t));
+                check_mem(col_idx);
+                S->col_idx = col_idx;
+                double *val = (double *) realloc(S->val, ((size_t) capacity + 1) * sizeof(double));
+                check_mem(val);
+                S->val = val;
+            }
+            S->col_idx[nnz] = col;
+            S->val[nnz++] = elmt;
+        }
+        S->row_ptr[row + 1] = nnz;
+    }
+    S->nnz = nnz;
+    return 0;
+error:
+    sparse_free(S);
+    return -1;
+}
+
+
+int
+sparse_transpose(const sparse_matrix_t *S, sparse_matrix_t *T)
+{
+    check_mem(S);
+    check(!sparse_alloc(T, S->cols, S->rows, S->nnz), "Out of memory.");
+    for (uint32_t e = 0; e < S->nnz; e++)
+        T->row_ptr[S->col_idx[e] + 1]++;
+    for (uint32_t row = 0; row < T->rows; row++)
+        T->row_ptr[row + 1] += T->row_ptr[row];
+
+    // the rows of S are walked in order, so every row of T comes out
+    // sorted, row_ptr[row] is the next free entry meanwhile
+    for (uint32_t row = 0; row < S->rows; row++)
+    {
+        for (uint32_t e = S->row_ptr[row]; e < S->row_ptr[row + 1]; e++)
+        {
+            const uint32_t dest = T->row_ptr[S->col_idx[e]]++;
+            T->col_idx[dest] = row;
+            T->val[dest] = S->val[e];
+        }
+    }
+    for (uint32_t row = T->rows; row > 0; row--)
+        T->row_ptr[row] = T->row_ptr[row - 1];
+    T->row_ptr[0] = 0;
+    return 0;
+error:
+    return -1;
+}
+
+
+// first row of part out of parts, by nonzeros plus one per row
+static uint32_t
+split_row(const sparse_matrix_t *A, uint32_t part, uint32_t parts)
+{
+    const uint64_t target = ((uint64_t) A->nnz + A->rows) * part / parts;
+    uint32_t low = 0, high = A->rows;
+    while (low < high)
+    {
+        const uint32_t mid = low + (high - low) / 2;
+        if ((uint64_t) A->row_ptr[mid] + mid < target)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+
+void
+sparse_partition(const sparse_matrix_t *A, uint32_t parts, uint32_t *bounds)
+{
+    for (uint32_t part = 0; part < parts; part++)
+        bounds[part] = split_row(A, part, parts);
+    bounds[parts] = A->rows;
+}
+
+
+int
+spmm_omp(const sparse_matrix_t *A, const double *B, double *C, uint32_t ncols)
+{
+    check_mem(A); check_mem(B); check_mem(C);
+    check(ncols > 0, "Non-positive number of columns");
+
+#   pragma omp parallel
+    {
+        const uint32_t thread = (uint32_t) omp_get_thread_num();
+        const uint32_t num_threads = (uint32_t) omp_get_num_threads();
+        const uint32_t row_end = thread + 1 == num_threads ? A->rows
+            : split_row(A, thread + 1, num_threads);
+        for (uint32_t row = split_row(A, thread, num_threads); row < row_end; row++)
+        {
+            double *C_row = C + (size_t) row * ncols;
+            memset(C_row, 0, ncols * sizeof(double));
+            for (uint32_t e = A->row_ptr[row]; e < A->row_ptr[row + 1]; e++)
+            {
+                const double elmt = A->val[e];
+                const double *B_row = B + (size_t) A->col_idx[e] * ncols;
+                for (uint32_t col = 0; col < ncols; col++)
+                    C_row[col] += elmt * B_row[col];
+            }
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+spmv_omp(const sparse_matrix_t *A, const double *x, double *y)
+{
+    return spmm_omp(A, x, y, 1);
+}
+
+
+static int
+compare_keys(const void *a, const void *b)
+{
+    const uint64_t x = *(const uint64_t *) a, y = *(const uint64_t *) b;
+    return (x > y) - (x < y);
+}
+
+
+int
+sparse_rcm_order(const sparse_matrix_t *A, uint32_t *perm)
+{
+    sparse_matrix_t T = {0};
+    uint32_t *degree = NULL;
+    uint64_t *keys = NULL;
+    char *visited = NULL;
+    check_mem(A); check_mem(perm);
+    check(A->rows == A->cols, "Not a square matrix");
+    const uint32_t n = A->rows;
+
+    // the neighbours of a node are its row in A and in A^T
+    check(!sparse_transpose(A, &T), "Transpose failed");
+    degree = (uint32_t *) malloc(((size_t) n + 1) * sizeof(uint32_t));
+    check_mem(degree);
+    keys = (uint64_t *) malloc(2 * ((size_t) n + 1) * sizeof(uint64_t));
+    check_mem(keys);
+    visited = (char *) calloc((size_t) n + 1, 1);
+    check_mem(visited);
+    uint64_t *starts = keys + n + 1;
+    for (uint32_t node = 0; node < n; node++)
+    {
+        degree[node] = A->row_ptr[node + 1] - A->row_ptr[node]
+            + T.row_ptr[node + 1] - T.row_ptr[node];
+        starts[node] = (uint64_t) degree[node] << 32 | node;
+    }
+    qsort(starts, n, sizeof(uint64_t), compare_keys);
+
+    // breadth first from the unvisited node of least degree, the
+    // neighbours of each node enqueued by increasing degree, perm
+    // itself is the queue
+    uint32_t head = 0, tail = 0;
+    for (uint32_t s = 0; s < n; s++)
+    {
+        const uint32_t start = (uint32_t) starts[s];
+        if (visited[start])
+            continue;
+        visited[start] = 1;
+        perm[tail++] = start;
+        while (head < tail)
+        {
+            const uint32_t node = perm[head++];
+            uint32_t count = 0;
+            const sparse_matrix_t *sides[] = {A, &T};
+            for (int side = 0; side < 2; side++)
+            {
+                const sparse_matrix_t *S = sides[side];
+                for (uint32_t e = S->row_ptr[node]; e < S->row_ptr[node + 1]; e++)
+                {
+                    const uint32_t next = S->col_idx[e];
+                    if (visited[next])
+                        continue;
+                    visited[next] = 1;
+                    keys[count++] = (uint64_t) degree[next] << 32 | next;
+                }
+            }
+            qsort(keys, count, sizeof(uint64_t), compare_keys);
+            for (uint32_t i = 0; i < count; i++)
+                perm[tail++] = (uint32_t) keys[i];
+        }
+    }
+
+    for (uint32_t i = 0; i < n / 2; i++)
+    {
+        const uint32_t tmp = perm[i];
+        perm[i] = perm[n - 1 - i];
+        perm[n - 1 - i] = tmp;
+    }
+    sparse_free(&T);
+    free(degree); free(keys); free(visited);
+    return 0;
+error:
+    sparse_free(&T);
+    if (degree)
+        free(degree);
+    if (keys)
+        free(keys);
+    if (visited)
+        free(visited);
+    return -1;
+}
+
+
+int
+sparse_permute(const sparse_matrix_t *A, const uint32_t *perm, sparse_matrix_t *B)
+{
+    sparse_matrix_t U = {0}, T = {0};
+    uint32_t *inverse = NULL;
+    check_mem(A); check_mem(perm);
+    check(A->rows == A->cols, "Not a square matrix");
+    const uint32_t n = A->rows;
+    inverse = (uint32_t *) malloc(((size_t) n + 1) * sizeof(uint32_t));
+    check_mem(inverse);
+    for (uint32_t i = 0; i < n; i++)
+        inverse[perm[i]] = i;
+
+    check(!sparse_alloc(&U, n, n, A->nnz), "Out of memory.");
+    for (uint32_t row = 0; row < n; row++)
+    {
+        const uint32_t from = perm[row];
+        U.row_ptr[row + 1] = U.row_ptr[row] + A->row_ptr[from + 1] - A->row_ptr[from];
+        for (uint32_t e = A->row_ptr[from], dest = U.row_ptr[row]; e < A->row_ptr[from + 1]; e++, dest++)
+        {
+            U.col_idx[dest] = inverse[A->col_idx[e]];
+            U.val[dest] = A->val[e];
+        }
+    }
+    // the rows of U are unsorted, transposing twice sorts them
+    check(!sparse_transpose(&U, &T), "Transpose failed");
+    check(!sparse_transpose(&T, B), "Transpose failed");
+    sparse_free(&U); sparse_free(&T);
+    free(inverse);
+    return 0;
+error:
+    sparse_free(&U); sparse_free(&T);
+    if (inverse)
+        free(inverse);
+    return -1;
+}
+
+
+static void
+heap_push(uint32_t *heap, uint32_t *size, uint32_t key)
+{
+    uint32_t i = (*size)++;
+    while (i > 0 && heap[(i - 1) / 2] > key)
+    {
+        heap[i] = heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    heap[i] = key;
+}
+
+
+static uint32_t
+heap_pop(uint32_t *heap, uint32_t *size)
+{
+    const uint32_t top = heap[0], last = heap[--(*size)];
+    uint32_t i = 0;
+    for (;;)
+    {
+        uint32_t child = 2 * i + 1;
+        if (child >= *size)
+            break;
+        if (child + 1 < *size && heap[child + 1] < heap[child])
+            child++;
+        if (heap[child] >= last)
+            break;
+        heap[i] = heap[child];
+        i = child;
+    }
+    heap[i] = last;
+    return top;
+}
+
+
+static int
+compare_cols(const void *a, const void *b)
+{
+    const uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+
+int
+sparse_lu_factor(const sparse_matrix_t *A, sparse_matrix_t *LU)
+{
+    double *work = NULL;
+    uint32_t *diag = NULL;
+    char *mark = NULL;
+    check_mem(A); check_mem(LU);
+    LU->row_ptr = LU->col_idx = NULL;
+    LU->val = NULL;
+    check(A->rows == A->cols, "Not a square matrix");
+    const uint32_t n = A->rows;
+
+    work = (double *) calloc((size_t) n + 1, sizeof(double));
+    check_mem(work);
+    mark = (char *) calloc((size_t) n + 1, 1);
+    check_mem(mark);
+    // diagonal positions, then the heap of columns left of the
+    // diagonal and the columns found left and right of it
+    diag = (uint32_t *) malloc(4 * ((size_t) n + 1) * sizeof(uint32_t));
+    check_mem(diag);
+    uint32_t *heap = diag + n + 1, *lower = heap + n + 1, *upper = lower + n + 1;
+    uint32_t capacity = 2 * A->nnz + n;
+    check(!sparse_alloc(LU, n, n, capacity), "Out of memory.");
+
+    // row by row: scatter row i of A into work, then eliminate its
+    // entries left of the diagonal by increasing column with the rows
+    // of U above, each of which can add more (fill) to the right
+    uint32_t nnz = 0;
+    for (uint32_t i = 0; i < n; i++)
+    {
+        uint32_t heap_size = 0, num_lower = 0, num_upper = 0;
+        for (uint32_t e = A->row_ptr[i]; e < A->row_ptr[i + 1]; e++)
+        {
+            const uint32_t col = A->col_idx[e];
+            work[col] = A->val[e];
+            mark[col] = 1;
+            if (col < i)
+                heap_push(heap, &heap_size, col);
+            else
+                upper[num_upper++] = col;
+        }
+        while (heap_size > 0)
+        {
+            const uint32_t k = heap_pop(heap, &heap_size);
+            const double factor = work[k] / LU->val[diag[k]];
+            work[k] = factor;
+            lower[num_lower++] = k;
+            for (uint32_t e = diag[k] + 1; e < LU->row_ptr[k + 1]; e++)
+            {
+                const uint32_t col = LU->col_idx[e];
+                if (!mark[col])
+                {
+                    mark[col] = 1;
+                    work[col] = 0.0;
+                    if (col < i)
+                        heap_push(heap, &heap_size, col);
+                    else
+                        upper[num_upper++] = col;
+                }
+                work[col] -= factor * LU->val[e];
+            }
+        }
+        check(mark[i] && work[i] != 0.0, "Zero pivot found! Use partial pivoting algo.");
+        qsort(upper, num_upper, sizeof(uint32_t), compare_cols);
+
+        if (nnz + num_lower + num_upper > capacity)
+        {
+            capacity = 2 * capacity + num_lower + num_upper;
+            uint32_t *col_idx = (uint32_t *) realloc(LU->col_idx, ((size_t) capacity + 1) * sizeof(uint32_t));
+            check_mem(col_idx);
+            LU->col_idx = col_idx;
+            double *val = (double *) realloc(LU->val, ((size_t) capacity + 1) * sizeof(double));
+            check_mem(val);
+            LU->val = val;
+        }
+        // the lower columns came off the heap in order
+        for (uint32_t j = 0; j < num_lower; j++, nnz++)
+        {
+            LU->col_idx[nnz] = lower[j];
+            LU->val[nnz] = work[lower[j]];
+            mark[lower[j]] = 0;
+        }
+        diag[i] = nnz;
+        for (uint32_t j = 0; j < num_upper; j++, nnz++)
+        {
+            LU->col_idx[nnz] = upper[j];
+            LU->val[nnz] = work[upper[j]];
+            mark[upper[j]] = 0;
+        }
+        LU->row_ptr[i + 1] = nnz;
+    }
+    LU->nnz = nnz;
+
+    free(work); free(mark); free(diag);
+    return 0;
+error:
+    sparse_free(LU);
+    if (work)
+        free(work);
+    if (mark)
+        free(mark);
+    if (diag)
+        free(diag);
+    return -1;
+}
+
+
+int
+sparse_lu_solve(const sparse_matrix_t *LU, double *b)
+{
+    check_mem(LU); check_mem(b);
+    const uint32_t n = LU->rows;
+    // forward substitution with the unit lower triangle
+    for (uint32_t row = 0; row < n; row++)
+    {
+        double sum = b[row];
+        for (uint32_t e = LU->row_ptr[row]; e < LU->row_ptr[row + 1] && LU->col_idx[e] < row; e++)
+            sum -= LU->val[e] * b[LU->col_idx[e]];
+        b[row] = sum;
+    }
+    // back substitution with the upper triangle
+    for (uint32_t row = n; row-- > 0;)
+    {
+        double sum = b[row], pivot = 0.0;
+        for (uint32_t e = LU->row_ptr[row]; e < LU->row_ptr[row + 1]; e++)
+        {
+            const uint32_t col = LU->col_idx[e];
+            if (col > row)
+                sum -= LU->val[e] * b[col];
+            else if (col == row)
+                pivot = LU->val[e];
+        }
+        check(pivot != 0.0, "Zero pivot found! Use partial pivoting algo.");
+        b[row] = sum / pivot;
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+sparse_solve(const sparse_matrix_t *A, double *b)
+{
+    sparse_matrix_t B = {0}, LU = {0};
+    uint32_t *perm = NULL;
+    double *x = NULL;
+    check_mem(A); check_mem(b);
+    const uint32_t n = A->rows;
+    perm = (uint32_t *) malloc(((size_t) n + 1) * sizeof(uint32_t));
+    check_mem(perm);
+    x = (double *) malloc(((size_t) n + 1) * sizeof(double));
+    check_mem(x);
+
+    check(!sparse_rcm_order(A, perm), "Ordering failed");
+    check(!sparse_permute(A, perm, &B), "Permutation failed");
+    check(!sparse_lu_factor(&B, &LU), "Sparse LU failed");
+    for (uint32_t i = 0; i < n; i++)
+        x[i] = b[perm[i]];
+    check(!sparse_lu_solve(&LU, x), "Sparse LU solve failed");
+    for (uint32_t i = 0; i < n; i++)
+        b[perm[i]] = x[i];
+
+    sparse_free(&B); sparse_free(&LU);
+    free(perm); free(x);
+    return 0;
+error:
+    sparse_free(&B); sparse_free(&LU);
+    if (perm)
+        free(perm);
+    if (x)
+        free(x);
+    return -1;
+}
@@ -0,0 +1,123 @@
+#include "dbg.h"
+#include "sparse.h"
+
+#include <mpi.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+
+int
+spmm_mpi(const sparse_matrix_t *A, const double *B, double *C, uint32_t ncols,
+        int proc_rank, int num_procs)
+{
+    uint32_t *bounds = NULL, *row_ptr = NULL, *col_idx = NULL;
+    int *counts = NULL;
+    double *val = NULL, *B_local = NULL, *C_local = NULL;
+    uint32_t dims[2] = {0, 0};
+    int mpi_err;
+    check(ncols > 0, "Non-positive number of columns");
+
+    bounds = (uint32_t *) malloc(((size_t) num_procs + 1) * sizeof(uint32_t));
+    check_mem(bounds);
+    // rows, row offsets, nonzeros, nonzero offsets, entries of C and
+    // their offsets, per process
+    counts = (int *) malloc(6 * num_procs * sizeof(int));
+    check_mem(counts);
+    int *row_counts = counts, *row_displs = counts + num_procs;
+    int *nnz_counts = counts + 2 * num_procs, *nnz_displs = counts + 3 * num_procs;
+    int *C_counts = counts + 4 * num_procs, *C_displs = counts + 5 * num_procs;
+
+    if (proc_rank == 0)
+    {
+        check_mem(A); check_mem(B); check_mem(C);
+        dims[0] = A->rows;
+        dims[1] = A->cols;
+        sparse_partition(A, (uint32_t) num_procs, bounds);
+        for (int p = 0; p < num_procs; p++)
+        {
+            row_counts[p] = (int) (bounds[p + 1] - bounds[p]);
+            row_displs[p] = (int) bounds[p];
+            nnz_counts[p] = (int) (A->row_ptr[bounds[p + 1]] - A->row_ptr[bounds[p]]);
+            nnz_displs[p] = (int) A->row_ptr[bounds[p]];
+            C_counts[p] = row_counts[p] * (int) ncols;
+            C_displs[p] = row_displs[p] * (int) ncols;
+        }
+    }
+    mpi_err = MPI_Bcast(dims, 2, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Broadcasting the dimensions failed");
+    mpi_err = MPI_Bcast(counts, 6 * num_procs, MPI_INT, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Broadcasting the partition failed");
+
+    const int my_rows = row_counts[proc_rank], my_nnz = nnz_counts[proc_rank];
+    row_ptr = (uint32_t *) malloc(((size_t) my_rows + 1) * sizeof(uint32_t));
+    check_mem(row_ptr);
+    col_idx = (uint32_t *) malloc(((size_t) my_nnz + 1) * sizeof(uint32_t));
+    check_mem(col_idx);
+    val = (double *) malloc(((size_t) my_nnz + 1) * sizeof(double));
+    check_mem(val);
+    C_local = (double *) malloc(((size_t) my_rows * ncols + 1) * sizeof(double));
+    check_mem(C_local);
+    if (proc_rank != 0)
+    {
+        B_local = (double *) malloc(((size_t) dims[1] * ncols + 1) * sizeof(double));
+        check_mem(B_local);
+    }
+
+    // every row pointer but the one past the end is sent once, that
+    // one is the nonzero count
+    mpi_err = MPI_Scatterv(proc_rank == 0 ? A->row_ptr : NULL, row_counts, row_displs,
+            MPI_UINT32_T, row_ptr, my_rows, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Scattering the row pointers failed");
+    mpi_err = MPI_Scatterv(proc_rank == 0 ? A->col_idx : NULL, nnz_counts, nnz_displs,
+            MPI_UINT32_T, col_idx, my_nnz, MPI_UINT32_T, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Scattering the column indices failed");
+    mpi_err = MPI_Scatterv(proc_rank == 0 ? A->val : NULL, nnz_counts, nnz_displs,
+            MPI_DOUBLE, val, my_nnz, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Scattering the values failed");
+    mpi_err = MPI_Bcast(proc_rank == 0 ? (double *) B : B_local, (int) (dims[1] * ncols),
+            MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Broadcasting the dense operand failed");
+
+    const uint32_t base = nnz_displs[proc_rank];
+    for (int row = 0; row < my_rows; row++)
+        row_ptr[row] -= base;
+    row_ptr[my_rows] = (uint32_t) my_nnz;
+    const sparse_matrix_t local = {(uint32_t) my_rows, dims[1], (uint32_t) my_nnz,
+        row_ptr, col_idx, val};
+    check(!spmm_omp(&local, proc_rank == 0 ? B : B_local, C_local, ncols),
+            "Local product failed");
+
+    mpi_err = MPI_Gatherv(C_local, my_rows * (int) ncols, MPI_DOUBLE,
+            C, C_counts, C_displs, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Gathering the product failed");
+
+    free(bounds); free(counts);
+    free(row_ptr); free(col_idx); free(val); free(C_local);
+    if (B_local)
+        free(B_local);
+    return EXIT_SUCCESS;
+error:
+    if (bounds)
+        free(bounds);
+    if (counts)
+        free(counts);
+    if (row_ptr)
+        free(row_ptr);
+    if (col_idx)
+        free(col_idx);
+    if (val)
+        free(val);
+    if (B_local)
+        free(B_local);
+    if (C_local)
+        free(C_local);
+    return EXIT_FAILURE;
+}
+
+
+int
+spmv_mpi(const sparse_matrix_t *A, const double *x, double *y,
+        int proc_rank, int num_procs)
+{
+    return spmm_mpi(A, x, y, 1, proc_rank, num_procs);
+}
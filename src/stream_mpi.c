@@ -0,0 +1,220 @@
+#include "dbg.h"
+#include "stream_mpi.h"
+
+#include <mpi.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define STREAM_TAG 44
+// chunks of M_1 in flight from process 0
+#define SEND_SLOTS 4
+
+
+/* count rows of width doubles into buf, testing the pending request
+ * after every row so that it progresses while process 0 parses */
+static int
+scan_rows(FILE *file, double *buf, int rows, int width, MPI_Request *pending)
+{
+    for (int row = 0; row < rows; row++)
+    {
+        for (int col = 0; col < width; col++)
+        {
+            int scan_rv = fscanf(file, "%lf", buf + (size_t) row * width + col);
+            check(scan_rv != EOF, "Unexpected EOF");
+            check(scan_rv > 0, "Nothing scanned");
+        }
+        if (pending && *pending != MPI_REQUEST_NULL)
+        {
+            int done;
+            MPI_Test(pending, &done, MPI_STATUS_IGNORE);
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+matMulSquare_stream_mpi(FILE *file, double **P, int *width,
+        int proc_rank, int num_procs)
+{
+    int *rows = NULL;
+    double *A_local = NULL, *C_local = NULL, *B_slots = NULL, *send_slots = NULL;
+    MPI_Request *requests = NULL;
+    int mpi_err, num_requests = 0;
+    check_mem(P); check_mem(width);
+    *P = NULL;
+
+    if (proc_rank == 0)
+    {
+        check(file, "Not a valid FILE pointer");
+        int scan_rv = fscanf(file, "%d", width);
+        check(scan_rv != EOF, "Unexpected EOF");
+        check(scan_rv > 0, "Nothing scanned");
+        check(*width > 0, "Non-positive width");
+    }
+    // the others can set up while the matrices are read
+    mpi_err = MPI_Bcast(width, 1, MPI_INT, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Broadcasting width failed");
+    const int n = *width;
+    check(n >= num_procs, "Poorly balanced problem: (%d rows, %d processes)", n, num_procs);
+
+    rows = (int *) malloc(2 * num_procs * sizeof(int));
+    check_mem(rows);
+    int *offsets = rows + num_procs;
+    for (int i = 0, offset = 0; i < num_procs; i++)
+    {
+        rows[i] = n / num_procs + (i < n % num_procs);
+        offsets[i] = offset;
+        offset += rows[i];
+    }
+    const int my_rows = rows[proc_rank];
+    const int chunk = STREAM_CHUNK_DOUBLES / n > 0 ? STREAM_CHUNK_DOUBLES / n : 1;
+    const size_t chunk_size = (size_t) chunk * n;
+    const int A_chunks = (my_rows + chunk - 1) / chunk;
+    const int B_chunks = (n + chunk - 1) / chunk;
+
+    A_local = (double *) malloc((size_t) my_rows * n * sizeof(double));
+    check_mem(A_local);
+    C_local = (double *) calloc((size_t) my_rows * n, sizeof(double));
+    check_mem(C_local);
+    B_slots = (double *) malloc(2 * chunk_size * sizeof(double));
+    check_mem(B_slots);
+    // the chunks of M_1 (sends on 0, receives elsewhere), then the
+    // two broadcast slots of M_2
+    num_requests = (proc_rank == 0 ? SEND_SLOTS : A_chunks) + 2;
+    requests = (MPI_Request *) malloc(num_requests * sizeof(MPI_Request));
+    check_mem(requests);
+    for (int i = 0; i < num_requests; i++)
+        requests[i] = MPI_REQUEST_NULL;
+    MPI_Request *A_requests = requests, *B_requests = requests + num_requests - 2;
+
+    // M_1 chunk by chunk to the owners, in file order
+    if (proc_rank == 0)
+    {
+        send_slots = (double *) malloc(SEND_SLOTS * chunk_size * sizeof(double));
+        check_mem(send_slots);
+        for (int dest = 0, slot = 0; dest < num_procs; dest++)
+        {
+            for (int row = 0; row < rows[dest]; row += chunk)
+            {
+                const int count = rows[dest] - row < chunk ? rows[dest] - row : chunk;
+                if (dest == 0)
+                {
+                    check(!scan_rows(file, A_local + (size_t) row * n, count, n, NULL),
+                            "Could not read M_1");
+                    continue;
+                }
+                double *buf = send_slots + slot * chunk_size;
+                mpi_err = MPI_Wait(A_requests + slot, MPI_STATUS_IGNORE);
+                check(!mpi_err, "Sending a chunk failed");
+                check(!scan_rows(file, buf, count, n, NULL), "Could not read M_1");
+                mpi_err = MPI_Isend(buf, count * n, MPI_DOUBLE, dest, STREAM_TAG,
+                        MPI_COMM_WORLD, A_requests + slot);
+                check(!mpi_err, "Sending a chunk failed");
+                slot = (slot + 1) % SEND_SLOTS;
+            }
+        }
+    }
+    else
+    {
+        for (int c = 0; c < A_chunks; c++)
+        {
+            const int row = c * chunk;
+            const int count = my_rows - row < chunk ? my_rows - row : chunk;
+            mpi_err = MPI_Irecv(A_local + (size_t) row * n, count * n, MPI_DOUBLE, 0,
+                    STREAM_TAG, MPI_COMM_WORLD, A_requests + c);
+            check(!mpi_err, "Receiving a chunk failed");
+        }
+        mpi_err = MPI_Ibcast(B_slots, (chunk < n ? chunk : n) * n, MPI_DOUBLE, 0,
+                MPI_COMM_WORLD, B_requests);
+        check(!mpi_err, "Broadcasting a chunk failed");
+        mpi_err = MPI_Waitall(A_chunks, A_requests, MPI_STATUSES_IGNORE);
+        check(!mpi_err, "Receiving a chunk failed");
+    }
+
+    // M_2 chunk by chunk to everyone, each a rank chunk update of the
+    // local rows of the product
+    for (int c = 0; c < B_chunks; c++)
+    {
+        const int k0 = c * chunk;
+        const int count = n - k0 < chunk ? n - k0 : chunk;
+        double *B_chunk = B_slots + (c % 2) * chunk_size;
+        if (proc_rank == 0)
+        {
+            mpi_err = MPI_Wait(B_requests + c % 2, MPI_STATUS_IGNORE);
+            check(!mpi_err, "Broadcasting a chunk failed");
+            check(!scan_rows(file, B_chunk, count, n, B_requests + (c + 1) % 2),
+                    "Could not read M_2");
+            mpi_err = MPI_Ibcast(B_chunk, count * n, MPI_DOUBLE, 0, MPI_COMM_WORLD,
+                    B_requests + c % 2);
+            check(!mpi_err, "Broadcasting a chunk failed");
+        }
+        else
+        {
+            if (c + 1 < B_chunks)
+            {
+                const int next = n - k0 - count < chunk ? n - k0 - count : chunk;
+                mpi_err = MPI_Ibcast(B_slots + ((c + 1) % 2) * chunk_size, next * n,
+                        MPI_DOUBLE, 0, MPI_COMM_WORLD, B_requests + (c + 1) % 2);
+                check(!mpi_err, "Broadcasting a chunk failed");
+            }
+            mpi_err = MPI_Wait(B_requests + c % 2, MPI_STATUS_IGNORE);
+            check(!mpi_err, "Broadcasting a chunk failed");
+        }
+
+        for (int row = 0; row < my_rows; row++)
+        {
+            double *C_row = C_local + (size_t) row * n;
+            const double *A_row = A_local + (size_t) row * n + k0;
+            for (int k = 0; k < count; k++)
+            {
+                const double elmt = A_row[k];
+                const double *B_row = B_chunk + (size_t) k * n;
+                for (int col = 0; col < n; col++)
+                    C_row[col] += elmt * B_row[col];
+            }
+        }
+    }
+    mpi_err = MPI_Waitall(num_requests, requests, MPI_STATUSES_IGNORE);
+    check(!mpi_err, "Waiting for the chunks failed");
+
+    if (proc_rank == 0)
+    {
+        *P = (double *) malloc((size_t) n * n * sizeof(double));
+        check_mem(*P);
+    }
+    for (int i = 0; i < num_procs; i++)
+    {
+        rows[i] *= n;
+        offsets[i] *= n;
+    }
+    mpi_err = MPI_Gatherv(C_local, my_rows * n, MPI_DOUBLE, *P, rows, offsets,
+            MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Gathering the product failed");
+
+    free(rows); free(A_local); free(C_local); free(B_slots); free(requests);
+    if (send_slots)
+        free(send_slots);
+    return EXIT_SUCCESS;
+error:
+    if (rows)
+        free(rows);
+    if (A_local)
+        free(A_local);
+    if (C_local)
+        free(C_local);
+    if (B_slots)
+        free(B_slots);
+    if (send_slots)
+        free(send_slots);
+    if (requests)
+        free(requests);
+    if (P && *P)
+    {
+        free(*P);
+        *P = NULL;
+    }
+    return EXIT_FAILURE;
+}
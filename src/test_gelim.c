@@ -1,6 +1,15 @@
 #include "dbg.h"
+#include "banded.h"
+#include "chain.h"
 #include "impl_mpi.h"
 #include "impl_omp.h"
+#include "matalloc.h"
+#include "matgen.h"
+#include "morton.h"
+#include "ooc.h"
+#include "sparse.h"
+#include "transpose.h"
+#include "verify.h"
 
 #include <inttypes.h>
 #include <math.h>
@@ -9,9 +18,13 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 const double THRESHOLD = 0.01l;
 
+#define CHAIN_MAX 7
+
 static
 inline
 double percent_error(double of, double against)
@@ -25,6 +38,38 @@ double percent_error(double of, double against)
 }
 
 
+static
+void fill_rhs(const double *P, double *B, size_t width, int nrhs)
+{
+    // B = P X for X with column c filled with c+1
+    for (size_t row = 0; row < width; row++)
+    {
+        double row_sum = 0.0l;
+        for (size_t col = 0; col < width; col++)
+            row_sum += P[row * width + col];
+        for (int c = 0; c < nrhs; c++)
+            B[row * nrhs + c] = (c + 1) * row_sum;
+    }
+}
+
+
+static
+void matmul_rect_ref(const double *A, const double *B, double *C,
+        size_t m, size_t k, size_t n)
+{
+    for (size_t row = 0; row < m; row++)
+    {
+        for (size_t col = 0; col < n; col++)
+        {
+            double sum = 0.0l;
+            for (size_t i = 0; i < k; i++)
+                sum += A[row * k + i] * B[i * n + col];
+            C[row * n + col] = sum;
+        }
+    }
+}
+
+
 impl_mpi_t mpi_methods[] = 
 { 
     matMulSquare_balanced_mpi,
@@ -45,6 +90,20 @@ int main(int argc, char *argv[])
 {
     double *m1 = NULL, *m2 = NULL;
     double *p_omp = NULL, *p_mpi = NULL;
+    double *lu_omp = NULL, *lu_mpi = NULL, *x_omp = NULL, *x_mpi = NULL, *rhs = NULL;
+    double *sym = NULL, *sym_ref = NULL;
+    double *rows_a = NULL, *rows_at = NULL;
+    int *row_counts = NULL;
+    double *batch_m1 = NULL, *batch_m2 = NULL, *batch_ref = NULL;
+    double *batch_omp = NULL, *batch_il = NULL, *batch_mpi = NULL;
+    morton_matrix_t z1 = {0}, z2 = {0}, zp = {0};
+    sparse_matrix_t sp_a = {0}, sp_b = {0};
+    band_matrix_t band = {0};
+    chain_plan_t chain_opt = {0}, chain_seq = {0};
+    double *chain_buf = NULL, *chain_ref = NULL;
+    matgen_t gen = {0};
+    char ooc_paths[3][32] = {"/tmp/gelim_ooc_XXXXXX", "/tmp/gelim_ooc_XXXXXX", "/tmp/gelim_ooc_XXXXXX"};
+    int ooc_made = 0;
     int mpi_err, scan_rv, my_err, mpi_init_flag;
     uint32_t width_omp; int width_mpi;
 
@@ -123,45 +182,920 @@ int main(int argc, char *argv[])
             proc_rank, num_procs);
     check(!my_err, "Something went wrong with MPI matmul");
 
+    // Freivalds' test of both products, then of a corrupted one that it
+    // has to reject (an error is logged for it)
+    const int transposed_b = method_index == 2;
+    if (proc_rank == 0)
+    {
+        my_err = verify_matmul_omp(m1, m2, p_omp, width_omp, transposed_b,
+                VERIFY_TRIALS, 1, VERIFY_TOL);
+        check(!my_err, "OMP matmul failed Freivalds' test");
+    }
+    my_err = verify_matmul_mpi(m1, m2, p_mpi, width_mpi, transposed_b,
+            VERIFY_TRIALS, 2, VERIFY_TOL, proc_rank, num_procs);
+    check(!my_err, "MPI matmul failed Freivalds' test");
+    {
+        const size_t corrupt = (size_t) width_mpi * width_mpi / 2;
+        double saved = 0.0l;
+        if (proc_rank == 0)
+        {
+            saved = p_mpi[corrupt];
+            p_mpi[corrupt] = 2.0l * saved + 1.0l;
+        }
+        my_err = verify_matmul_mpi(m1, m2, p_mpi, width_mpi, transposed_b,
+                VERIFY_TRIALS, 3, VERIFY_TOL, proc_rank, num_procs);
+        check(my_err, "A corrupted product passed Freivalds' test");
+        if (proc_rank == 0)
+        {
+            my_err = verify_matmul_omp(m1, m2, p_mpi, width_omp, transposed_b,
+                    VERIFY_TRIALS, 4, VERIFY_TOL);
+            check(my_err, "A corrupted product passed Freivalds' test");
+            p_mpi[corrupt] = saved;
+        }
+    }
+
+    // the low memory kernel with all of M_2 and in panels of columns
+    // that do not divide the width, by Freivalds' test of M_1 M_2
+    {
+        const int panels[] = {0, 3, width_mpi / 2 + 1};
+        if (proc_rank == 0)
+        {
+            sym = (double *) malloc(width * width * sizeof(double));
+            check_mem(sym);
+        }
+        for (size_t i = 0; i < sizeof(panels)/sizeof(int); i++)
+        {
+            my_err = matMulSquare_lowmem_mpi(m1, m2, sym, width_mpi, proc_rank, num_procs, panels[i]);
+            check(!my_err, "Something went wrong with the low memory MPI matmul");
+            my_err = verify_matmul_mpi(m1, m2, sym, width_mpi, 0, VERIFY_TRIALS, 5 + i,
+                    VERIFY_TOL, proc_rank, num_procs);
+            check(!my_err, "Low memory matmul (panel %d) failed Freivalds' test", panels[i]);
+        }
+        if (proc_rank == 0)
+        {
+            free(sym);
+            sym = NULL;
+        }
+    }
+
+    // the tiled kernel (that autotuning may pick) against the method
+    // under test, unless that one expects M_2 transposed. A tile that
+    // does not divide the width checks the edge tiles
+    if (proc_rank == 0 && matmul_omp != matMulSquare_pretranspose_omp)
+    {
+        sym = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym);
+        my_err = matMulSquare_tiled_omp(m1, m2, sym, width_omp, 24);
+        check(!my_err, "Something went wrong with OMP tiled matmul");
+        for (size_t i = 0; i < width * width; i++)
+        {
+            check(percent_error(sym[i], p_omp[i]) < THRESHOLD,
+                    "Bad tiled matmul at %lu: %lf %lf", i, sym[i], p_omp[i]);
+        }
+        free(sym);
+        sym = NULL;
+    }
+
+    // the same on Morton ordered tiles, converted back to row-major
+    if (proc_rank == 0 && matmul_omp != matMulSquare_pretranspose_omp)
+    {
+        sym = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym);
+        check(!morton_alloc(&z1, width_omp) && !morton_alloc(&z2, width_omp)
+                && !morton_alloc(&zp, width_omp), "Morton allocation failed");
+        my_err = morton_from_rowmajor_omp(&z1, m1) || morton_from_rowmajor_omp(&z2, m2);
+        check(!my_err, "Conversion to Morton order failed");
+        my_err = matMulSquare_morton_omp(&z1, &z2, &zp);
+        check(!my_err, "Something went wrong with OMP Morton matmul");
+        my_err = morton_to_rowmajor_omp(&zp, sym);
+        check(!my_err, "Conversion from Morton order failed");
+        for (size_t i = 0; i < width * width; i++)
+        {
+            check(percent_error(sym[i], p_omp[i]) < THRESHOLD,
+                    "Bad Morton matmul at %lu: %lf %lf", i, sym[i], p_omp[i]);
+        }
+        free(sym);
+        sym = NULL;
+        morton_free(&z1); morton_free(&z2); morton_free(&zp);
+    }
+
+    // the out-of-core kernels on files, with panels of a few rows
+    // that do not divide the width, m1 through the text converter
+    if (proc_rank == 0)
+    {
+        for (; ooc_made < 3; ooc_made++)
+        {
+            int fd = mkstemp(ooc_paths[ooc_made]);
+            check(fd >= 0, "Could not create a temporary file");
+            close(fd);
+        }
+        sym = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym);
+        FILE *file = tmpfile();
+        check(file, "Could not open a temporary file");
+        for (size_t i = 0; i < width * width; i++)
+            fprintf(file, "%.17g%c", m1[i], (i + 1) % width ? ' ' : '\n');
+        rewind(file);
+        my_err = ooc_convert_text(file, ooc_paths[0], width_omp);
+        fclose(file);
+        check(!my_err, "Converting to a matrix file failed");
+        my_err = ooc_read_matrix(ooc_paths[0], sym, width_omp);
+        check(!my_err, "Reading a matrix file failed");
+        check(!memcmp(sym, m1, width * width * sizeof(double)), "Bad matrix file");
+
+        if (matmul_omp != matMulSquare_pretranspose_omp)
+        {
+            my_err = ooc_write_matrix(ooc_paths[1], m2, width_omp);
+            check(!my_err, "Writing a matrix file failed");
+            my_err = matMulSquare_ooc_omp(ooc_paths[0], ooc_paths[1], ooc_paths[2],
+                    7 * 4 * width * sizeof(double));
+            check(!my_err, "Something went wrong with out-of-core matmul");
+            my_err = ooc_read_matrix(ooc_paths[2], sym, width_omp);
+            check(!my_err, "Reading a matrix file failed");
+            for (size_t i = 0; i < width * width; i++)
+            {
+                check(percent_error(sym[i], p_omp[i]) < THRESHOLD,
+                        "Bad out-of-core matmul at %lu: %lf %lf", i, sym[i], p_omp[i]);
+            }
+        }
+        free(sym);
+        sym = NULL;
+    }
+
+    // generated matrices: the threads' rows against the rows made one
+    // by one backwards and through a matrix file, a dominant matrix
+    // factorised without pivoting and the Frobenius norm of a
+    // prescribed spectrum
+    if (proc_rank == 0)
+    {
+        sym = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym);
+        sym_ref = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym_ref);
+        check(!matgen_init(&gen, MATGEN_DOMINANT, width_omp, 7, 1, 1.0e3l, -1.0l, 1.0l),
+                "Bad generator settings");
+        my_err = matgen_fill_omp(&gen, sym);
+        check(!my_err, "Something went wrong generating a matrix");
+        for (size_t row = width; row > 0; row--)
+            matgen_rows(&gen, sym_ref + (row - 1) * width, row - 1, 1);
+        check(!memcmp(sym, sym_ref, width * width * sizeof(double)), "Generated rows differ");
+        my_err = matgen_write_omp(&gen, ooc_paths[0], 3 * width * sizeof(double));
+        check(!my_err, "Writing a generated matrix failed");
+        my_err = ooc_read_matrix(ooc_paths[0], sym_ref, width_omp);
+        check(!my_err, "Reading a matrix file failed");
+        check(!memcmp(sym, sym_ref, width * width * sizeof(double)), "Bad generated matrix file");
+        my_err = lu_factor_inplace_omp(sym_ref, width_omp);
+        check(!my_err, "Something went wrong with OMP LU");
+        my_err = verify_lu_omp(sym, sym_ref, width_omp, VERIFY_TRIALS, 8, VERIFY_TOL);
+        check(!my_err, "Bad LU of a generated matrix");
+        matgen_free(&gen);
+
+        check(!matgen_init(&gen, MATGEN_SPECTRUM, width_omp, 7, 2, 1.0e6l, 0.0l, 0.0l),
+                "Bad generator settings");
+        my_err = matgen_fill_omp(&gen, sym);
+        check(!my_err, "Something went wrong generating a matrix");
+        double frobenius = 0.0l, sigma_sum = 0.0l;
+        for (size_t i = 0; i < width * width; i++)
+            frobenius += sym[i] * sym[i];
+        for (size_t i = 0; i < width; i++)
+            sigma_sum += gen.sigma[i] * gen.sigma[i];
+        check(percent_error(frobenius, sigma_sum) < 1.0e-12,
+                "Generated spectrum is off: %le %le", frobenius, sigma_sum);
+        matgen_free(&gen);
+        free(sym); free(sym_ref);
+        sym = sym_ref = NULL;
+    }
+
+    // transposes: a rectangular block of m1 and all of it in place
+    // against the plain loop, then m1 distributed by rows
+    if (proc_rank == 0)
+    {
+        const uint32_t cols = width_omp / 2 + 1;
+        sym_ref = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym_ref);
+        sym = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym);
+        for (size_t row = 0; row < width; row++)
+        {
+            for (size_t col = 0; col < width; col++)
+                sym_ref[col * width + row] = m1[row * width + col];
+        }
+        my_err = transpose_omp(m1, width_omp, sym, width_omp, width_omp, cols);
+        check(!my_err, "Something went wrong with the OMP transpose");
+        for (size_t row = 0; row < cols; row++)
+        {
+            for (size_t col = 0; col < width; col++)
+                check(sym[row * width + col] == sym_ref[row * width + col],
+                        "Bad transpose at row %lu, col %lu", row, col);
+        }
+        memcpy(sym, m1, width * width * sizeof(double));
+        my_err = transpose_inplace_omp(sym, width_omp);
+        check(!my_err, "Something went wrong with the in place transpose");
+        check(!memcmp(sym, sym_ref, width * width * sizeof(double)),
+                "Bad in place transpose");
+    }
+
+    row_counts = (int *) malloc(2 * num_procs * sizeof(int));
+    check_mem(row_counts);
+    for (int i = 0, offset = 0; i < num_procs; i++)
+    {
+        row_counts[i] = (width_mpi / num_procs + (i < width_mpi % num_procs)) * width_mpi;
+        row_counts[num_procs + i] = offset;
+        offset += row_counts[i];
+    }
+    rows_a = (double *) malloc((row_counts[proc_rank] + 1) * sizeof(double));
+    check_mem(rows_a);
+    rows_at = (double *) malloc((row_counts[proc_rank] + 1) * sizeof(double));
+    check_mem(rows_at);
+    mpi_err = MPI_Scatterv(m1, row_counts, row_counts + num_procs, MPI_DOUBLE,
+            rows_a, row_counts[proc_rank], MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Scattering rows to transpose failed");
+    my_err = transpose_mpi(rows_a, rows_at, width_mpi, proc_rank, num_procs);
+    check(!my_err, "Something went wrong with the MPI transpose");
+    mpi_err = MPI_Gatherv(rows_at, row_counts[proc_rank], MPI_DOUBLE, sym,
+            row_counts, row_counts + num_procs, MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Gathering transposed rows failed");
+    if (proc_rank == 0)
+    {
+        check(!memcmp(sym, sym_ref, width * width * sizeof(double)),
+                "Bad MPI transpose");
+        free(sym); free(sym_ref);
+        sym = sym_ref = NULL;
+    }
+    free(rows_a); free(rows_at); free(row_counts);
+    rows_a = rows_at = NULL;
+    row_counts = NULL;
+
+    // symmetric kernels: m1 m1^T through SYRK against the general
+    // pretransposed kernel, then its Cholesky factor against itself
+    if (proc_rank == 0)
+    {
+        sym_ref = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym_ref);
+        sym = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym);
+        my_err = matMulSquare_pretranspose_omp(m1, m1, sym_ref, width_omp);
+        check(!my_err, "Something went wrong with OMP pretranspose matmul");
+        my_err = syrk_lower_omp(m1, sym, width_omp);
+        check(!my_err, "Something went wrong with OMP SYRK");
+        for (size_t row = 0; row < width; row++)
+        {
+            for (size_t col = 0; col <= row; col++)
+            {
+                size_t i = row * width + col;
+                check(percent_error(sym[i], sym_ref[i]) < THRESHOLD,
+                        "Bad SYRK at row %lu, col %lu: %lf %lf",
+                        row, col, sym[i], sym_ref[i]);
+            }
+        }
+
+        my_err = cholesky_inplace_omp(sym, width_omp);
+        check(!my_err, "Something went wrong during OMP Cholesky");
+        for (size_t row = 0; row < width; row++)
+        {
+            for (size_t col = 0; col <= row; col++)
+            {
+                double elmt = 0.0l;
+                for (size_t k = 0; k <= col; k++)
+                    elmt += sym[row * width + k] * sym[col * width + k];
+                check(percent_error(elmt, sym_ref[row * width + col]) < THRESHOLD,
+                        "Bad Cholesky factor at row %lu, col %lu: %lf %lf",
+                        row, col, elmt, sym_ref[row * width + col]);
+            }
+        }
+        free(sym); free(sym_ref);
+        sym = sym_ref = NULL;
+    }
+
+    // sparse kernels on a diagonally dominant matrix that keeps the
+    // tridiagonal and about a tenth of the rest of m1: the products
+    // against the dense ones, a round trip through a file, the
+    // unordered LU against the dense LU and the ordered solve
+    if (proc_rank == 0)
+    {
+        sym = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym);
+        sym_ref = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym_ref);
+        x_omp = (double *) malloc((width + 1) * width * sizeof(double));
+        check_mem(x_omp);
+        for (size_t row = 0; row < width; row++)
+        {
+            double row_sum = 1.0l;
+            for (size_t col = 0; col < width; col++)
+            {
+                const int keep = row == col + 1 || col == row + 1 || (row * 31 + col * 17) % 10 == 0;
+                sym[row * width + col] = keep ? m1[row * width + col] : 0.0l;
+                row_sum += fabs(sym[row * width + col]);
+            }
+            sym[row * width + row] = row_sum;
+        }
+        my_err = sparse_from_dense(&sp_a, sym, width_omp, width_omp);
+        check(!my_err, "Conversion to CSR failed");
+        my_err = matMulSquare_baseline_omp(sym, m2, sym_ref, width_omp);
+        check(!my_err, "Something went wrong with OMP matmul");
+        my_err = spmm_omp(&sp_a, m2, x_omp, width_omp);
+        check(!my_err, "Something went wrong with OMP SpMM");
+        for (size_t i = 0; i < width * width; i++)
+        {
+            check(percent_error(x_omp[i], sym_ref[i]) < THRESHOLD,
+                    "Bad SpMM at %lu: %lf %lf", i, x_omp[i], sym_ref[i]);
+        }
+        // the first column of m2 times the matrix is the first column
+        // of the product
+        for (size_t row = 0; row < width; row++)
+            x_omp[width * width + row] = m2[row * width];
+        my_err = spmv_omp(&sp_a, x_omp + width * width, x_omp);
+        check(!my_err, "Something went wrong with OMP SpMV");
+        for (size_t row = 0; row < width; row++)
+        {
+            check(percent_error(x_omp[row], sym_ref[row * width]) < THRESHOLD,
+                    "Bad SpMV at row %lu: %lf %lf", row, x_omp[row], sym_ref[row * width]);
+        }
+
+        FILE *file = tmpfile();
+        check(file, "Could not open a temporary file");
+        for (size_t i = 0; i < width * width; i++)
+            fprintf(file, "%.17g%c", sym[i], (i + 1) % width ? ' ' : '\n');
+        rewind(file);
+        my_err = sparse_read_matrix(file, &sp_b, width_omp);
+        fclose(file);
+        check(!my_err, "Reading a sparse matrix failed");
+        check(sp_b.nnz == sp_a.nnz
+                && !memcmp(sp_b.row_ptr, sp_a.row_ptr, (width + 1) * sizeof(uint32_t))
+                && !memcmp(sp_b.col_idx, sp_a.col_idx, sp_a.nnz * sizeof(uint32_t))
+                && !memcmp(sp_b.val, sp_a.val, sp_a.nnz * sizeof(double)),
+                "Bad sparse matrix read back");
+        sparse_free(&sp_b);
+    }
+
+    my_err = spmm_mpi(&sp_a, m2, x_omp, width_omp, proc_rank, num_procs);
+    check(!my_err, "Something went wrong with MPI SpMM");
+
+    if (proc_rank == 0)
+    {
+        for (size_t i = 0; i < width * width; i++)
+        {
+            check(percent_error(x_omp[i], sym_ref[i]) < THRESHOLD,
+                    "Bad MPI SpMM at %lu: %lf %lf", i, x_omp[i], sym_ref[i]);
+        }
+
+        my_err = sparse_lu_factor(&sp_a, &sp_b);
+        check(!my_err, "Something went wrong with sparse LU");
+        my_err = sparse_to_dense(&sp_b, sym_ref);
+        check(!my_err, "Conversion from CSR failed");
+        fill_rhs(sym, x_omp, width, 1);
+        my_err = lu_factor_inplace_omp(sym, width_omp);
+        check(!my_err, "Something went wrong with OMP LU");
+        for (size_t i = 0; i < width * width; i++)
+        {
+            check(percent_error(sym_ref[i], sym[i]) < THRESHOLD,
+                    "Bad sparse LU at row %lu, col %lu: %lf %lf",
+                    i / width, i % width, sym_ref[i], sym[i]);
+        }
+        my_err = sparse_solve(&sp_a, x_omp);
+        check(!my_err, "Something went wrong with the sparse solve");
+        for (size_t row = 0; row < width; row++)
+        {
+            check(percent_error(x_omp[row], 1.0l) < THRESHOLD,
+                    "Bad sparse solve at row %lu: %lf", row, x_omp[row]);
+        }
+        sparse_free(&sp_a); sparse_free(&sp_b);
+        free(sym); free(sym_ref); free(x_omp);
+        sym = sym_ref = x_omp = NULL;
+    }
+
+    // banded kernels on the band of m1 from three below to two above
+    // the diagonal, against the dense LU and elimination, then the
+    // tridiagonal solvers on the tridiagonal of m1
+    if (proc_rank == 0)
+    {
+        uint32_t lower, upper;
+        sym = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym);
+        sym_ref = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym_ref);
+        lu_omp = (double *) malloc(width * width * sizeof(double));
+        check_mem(lu_omp);
+        x_omp = (double *) malloc(5 * width * sizeof(double));
+        check_mem(x_omp);
+        for (size_t row = 0; row < width; row++)
+        {
+            for (size_t col = 0; col < width; col++)
+            {
+                const int keep = col + 3 >= row && col <= row + 2;
+                sym[row * width + col] = keep ? m1[row * width + col] + 10.0l * (row == col) : 0.0l;
+            }
+        }
+        my_err = band_detect(sym, width_omp, &lower, &upper);
+        check(!my_err, "Band detection failed");
+        check(lower == (width > 3 ? 3 : width - 1) && upper == (width > 2 ? 2 : width - 1),
+                "Bad band detected: %u below, %u above", lower, upper);
+        check(!band_alloc(&band, width_omp, lower, upper), "Band allocation failed");
+        my_err = band_from_dense(&band, sym);
+        check(!my_err, "Packing the band failed");
+        my_err = band_lu_factor_omp(&band);
+        check(!my_err, "Something went wrong with banded LU");
+        my_err = band_to_dense(&band, sym_ref);
+        check(!my_err, "Unpacking the band failed");
+        memcpy(lu_omp, sym, width * width * sizeof(double));
+        my_err = lu_factor_inplace_omp(lu_omp, width_omp);
+        check(!my_err, "Something went wrong with OMP LU");
+        for (size_t i = 0; i < width * width; i++)
+        {
+            check(percent_error(sym_ref[i], lu_omp[i]) < THRESHOLD,
+                    "Bad banded LU at row %lu, col %lu: %lf %lf",
+                    i / width, i % width, sym_ref[i], lu_omp[i]);
+        }
+        fill_rhs(sym, x_omp, width, 1);
+        my_err = band_lu_solve(&band, x_omp, 1);
+        check(!my_err, "Something went wrong with the banded solve");
+        for (size_t row = 0; row < width; row++)
+        {
+            check(percent_error(x_omp[row], 1.0l) < THRESHOLD,
+                    "Bad banded solve at row %lu: %lf", row, x_omp[row]);
+        }
+        band_free(&band);
+
+        memcpy(lu_omp, sym, width * width * sizeof(double));
+        my_err = gaussian_elimination_naive_inplace_omp(lu_omp, width_omp);
+        check(!my_err, "Something went wrong during OMP gauss elim");
+        my_err = gaussian_elimination_banded_omp(sym, width_omp);
+        check(!my_err, "Something went wrong during banded gauss elim");
+        for (size_t i = 0; i < width * width; i++)
+        {
+            check(percent_error(sym[i], lu_omp[i]) < THRESHOLD,
+                    "Bad banded gausselim at %lu: %lf %lf", i, sym[i], lu_omp[i]);
+        }
+        // a dense matrix, which it eliminates without the band storage
+        memcpy(sym, m1, width * width * sizeof(double));
+        memcpy(lu_omp, m1, width * width * sizeof(double));
+        my_err = gaussian_elimination_naive_inplace_omp(lu_omp, width_omp);
+        check(!my_err, "Something went wrong during OMP gauss elim");
+        my_err = gaussian_elimination_banded_omp(sym, width_omp);
+        check(!my_err, "Something went wrong during banded gauss elim of a dense matrix");
+        for (size_t i = 0; i < width * width; i++)
+        {
+            check(percent_error(sym[i], lu_omp[i]) < THRESHOLD,
+                    "Bad banded gausselim of a dense matrix at %lu: %lf %lf", i, sym[i], lu_omp[i]);
+        }
+
+        // a, b, c, then the right hand side for x all ones twice
+        double *a = x_omp, *b = x_omp + width, *c = x_omp + 2 * width;
+        double *d = x_omp + 3 * width, *d_cr = x_omp + 4 * width;
+        for (size_t row = 0; row < width; row++)
+        {
+            a[row] = row > 0 ? m1[row * width + row - 1] : 0.0l;
+            b[row] = m1[row * width + row];
+            c[row] = row + 1 < width ? m1[row * width + row + 1] : 0.0l;
+            d[row] = d_cr[row] = a[row] + b[row] + c[row];
+        }
+        my_err = tridiag_solve_thomas(a, b, c, d, width_omp, 1);
+        check(!my_err, "Something went wrong with the Thomas solve");
+        my_err = tridiag_solve_cr_omp(a, b, c, d_cr, width_omp);
+        check(!my_err, "Something went wrong with cyclic reduction");
+        for (size_t row = 0; row < width; row++)
+        {
+            check(percent_error(d[row], 1.0l) < THRESHOLD,
+                    "Bad Thomas solve at row %lu: %lf", row, d[row]);
+            check(percent_error(d_cr[row], 1.0l) < THRESHOLD,
+                    "Bad cyclic reduction at row %lu: %lf", row, d_cr[row]);
+            d[row] = a[row] + b[row] + c[row];
+        }
+        // a zero pivot has to be reported, not divided by
+        {
+            const double saved = b[0];
+            b[0] = 0.0l;
+            my_err = tridiag_solve_cr_omp(a, b, c, d_cr, width_omp);
+            check(my_err, "Cyclic reduction missed a zero pivot");
+            b[0] = saved;
+        }
+        free(sym); free(sym_ref); free(lu_omp);
+        sym = sym_ref = lu_omp = NULL;
+    }
+
+    if (width >= 2 * (size_t) num_procs)
+    {
+        my_err = tridiag_solve_mpi(x_omp, x_omp + width, x_omp + 2 * width,
+                x_omp + 3 * width, width_mpi, proc_rank, num_procs);
+        check(!my_err, "Something went wrong with the MPI tridiagonal solve");
+        for (size_t row = 0; proc_rank == 0 && row < width; row++)
+        {
+            check(percent_error(x_omp[3 * width + row], 1.0l) < THRESHOLD,
+                    "Bad MPI tridiagonal solve at row %lu: %lf", row, x_omp[3 * width + row]);
+        }
+    }
+    if (proc_rank == 0)
+    {
+        free(x_omp);
+        x_omp = NULL;
+    }
+
+    // batched kernels on nb blocks cut from the top left corner of
+    // m1 and m2 (shifted along the diagonal so they differ), checked
+    // against one call of the single matrix kernel per block
+    const int batch_widths[] = {12, 16};
+    for (size_t w = 0; w < sizeof(batch_widths)/sizeof(int); w++)
+    {
+        const int bw = batch_widths[w], nb = 37;
+        const size_t bsize = (size_t) bw * bw;
+        if ((size_t) bw > width)
+            continue;
+        if (proc_rank == 0)
+        {
+            batch_m1 = (double *) malloc(nb * bsize * sizeof(double));
+            check_mem(batch_m1);
+            batch_m2 = (double *) malloc(nb * bsize * sizeof(double));
+            check_mem(batch_m2);
+            batch_ref = (double *) malloc(nb * bsize * sizeof(double));
+            check_mem(batch_ref);
+            batch_omp = (double *) malloc(nb * bsize * sizeof(double));
+            check_mem(batch_omp);
+            batch_il = (double *) malloc(3 * nb * bsize * sizeof(double));
+            check_mem(batch_il);
+            batch_mpi = (double *) malloc(nb * bsize * sizeof(double));
+            check_mem(batch_mpi);
+            for (int b = 0; b < nb; b++)
+            {
+                for (int row = 0; row < bw; row++)
+                {
+                    for (int col = 0; col < bw; col++)
+                    {
+                        batch_m1[b*bsize + row*bw + col] = m1[row*width + col] + (row == col) * b;
+                        batch_m2[b*bsize + row*bw + col] = m2[row*width + col];
+                    }
+                }
+                my_err = matMulSquare_baseline_omp(batch_m1 + b*bsize,
+                        batch_m2 + b*bsize, batch_ref + b*bsize, bw);
+                check(!my_err, "Something went wrong with OMP matmul");
+            }
+
+            my_err = matMulBatched_strided_omp(batch_m1, batch_m2, batch_omp,
+                    bw, bsize, nb);
+            check(!my_err, "Something went wrong with OMP batched matmul");
+            double *il_m1 = batch_il, *il_m2 = batch_il + nb*bsize, *il_p = batch_il + 2*nb*bsize;
+            batch_interleave(batch_m1, il_m1, bw, nb);
+            batch_interleave(batch_m2, il_m2, bw, nb);
+            my_err = matMulBatched_interleaved_omp(il_m1, il_m2, il_p, bw, nb);
+            check(!my_err, "Something went wrong with OMP interleaved matmul");
+            batch_deinterleave(il_p, batch_mpi, bw, nb);
+            for (size_t i = 0; i < nb * bsize; i++)
+            {
+                check(percent_error(batch_omp[i], batch_ref[i]) < THRESHOLD,
+                        "Bad batched matmul (width %d) at %lu: %lf %lf", bw, i, batch_omp[i], batch_ref[i]);
+                check(percent_error(batch_mpi[i], batch_ref[i]) < THRESHOLD,
+                        "Bad interleaved matmul (width %d) at %lu: %lf %lf", bw, i, batch_mpi[i], batch_ref[i]);
+            }
+        }
+
+        my_err = matMulBatched_mpi(batch_m1, batch_m2, batch_mpi, bw, nb,
+                proc_rank, num_procs);
+        check(!my_err, "Something went wrong with MPI batched matmul");
+
+        if (proc_rank == 0)
+        {
+            for (size_t i = 0; i < nb * bsize; i++)
+            {
+                check(percent_error(batch_mpi[i], batch_ref[i]) < THRESHOLD,
+                        "Bad MPI batched matmul (width %d) at %lu: %lf %lf", bw, i, batch_mpi[i], batch_ref[i]);
+            }
+
+            // eliminations of the products, one call per block as reference
+            memcpy(batch_omp, batch_ref, nb * bsize * sizeof(double));
+            memcpy(batch_mpi, batch_ref, nb * bsize * sizeof(double));
+            batch_interleave(batch_ref, batch_il, bw, nb);
+            for (int b = 0; b < nb; b++)
+            {
+                my_err = gaussian_elimination_naive_inplace_omp(batch_ref + b*bsize, bw);
+                check(!my_err, "Something went wrong during OMP gauss elim");
+            }
+            my_err = gaussian_elimination_batched_strided_omp(batch_omp, bw, bsize, nb);
+            check(!my_err, "Something went wrong during OMP batched gauss elim");
+            my_err = gaussian_elimination_batched_interleaved_omp(batch_il, bw, nb);
+            check(!my_err, "Something went wrong during OMP interleaved gauss elim");
+            batch_deinterleave(batch_il, batch_m1, bw, nb);
+            for (size_t i = 0; i < nb * bsize; i++)
+            {
+                check(percent_error(batch_omp[i], batch_ref[i]) < THRESHOLD,
+                        "Bad batched gauss elim (width %d) at %lu: %lf %lf", bw, i, batch_omp[i], batch_ref[i]);
+                check(percent_error(batch_m1[i], batch_ref[i]) < THRESHOLD,
+                        "Bad interleaved gauss elim (width %d) at %lu: %lf %lf", bw, i, batch_m1[i], batch_ref[i]);
+            }
+        }
+
+        my_err = gaussian_elimination_batched_mpi(batch_mpi, bw, nb,
+                proc_rank, num_procs);
+        check(!my_err, "Something went wrong during MPI batched gauss elim");
+
+        if (proc_rank == 0)
+        {
+            for (size_t i = 0; i < nb * bsize; i++)
+            {
+                check(percent_error(batch_mpi[i], batch_ref[i]) < THRESHOLD,
+                        "Bad MPI batched gauss elim (width %d) at %lu: %lf %lf", bw, i, batch_mpi[i], batch_ref[i]);
+            }
+            free(batch_m1); free(batch_m2); free(batch_ref);
+            free(batch_omp); free(batch_il); free(batch_mpi);
+            batch_m1 = batch_m2 = batch_ref = batch_omp = batch_il = batch_mpi = NULL;
+        }
+    }
+
+    // matrix chains: the order and cost of the textbook chain, then a
+    // chain of blocks of m1 and m2 and (A B)(C D) with the inner
+    // dimensions wide (whose halves go to tasks and subcommunicators),
+    // planned and in the written order, against one product at a time
+    {
+        const uint32_t book[] = {30, 35, 15, 5, 10, 20, 25};
+        my_err = chain_plan(&chain_opt, book, 6, 0.0l);
+        check(!my_err, "Planning a chain failed");
+        check(chain_opt.flops[5] == 2.0l * 15125 && chain_opt.split[5] == 2
+                && chain_opt.split[2] == 0 && chain_opt.split[3*6 + 5] == 4,
+                "Bad plan of the textbook chain, %lf flops", chain_opt.flops[5]);
+        chain_plan_free(&chain_opt);
+    }
+    const uint32_t third = 1 + width_omp / 3 < width_omp ? 1 + width_omp / 3 : width_omp;
+    const uint32_t half = 1 + width_omp / 2 < width_omp ? 1 + width_omp / 2 : width_omp;
+    const uint32_t chain_dims[2][CHAIN_MAX + 1] = {
+        {width_omp, third, width_omp, width_omp < 2 ? 1 : 2, width_omp, half,
+            width_omp < 3 ? 1 : 3, width_omp},
+        {128, 1024, 128, 1024, 128}};
+    const uint32_t chain_counts[2] = {7, 4};
+    for (int c = 0; c < 2; c++)
+    {
+        const uint32_t count = chain_counts[c], *dims = chain_dims[c];
+        const double *chain_m[CHAIN_MAX] = {NULL}, *ref = NULL;
+        double *chain_p = NULL;
+        const size_t size = (size_t) dims[0] * dims[count];
+        my_err = chain_plan(&chain_opt, dims, count, 0.0l);
+        check(!my_err, "Planning a chain failed");
+        my_err = chain_plan_left(&chain_seq, dims, count);
+        check(!my_err, "Planning a chain failed");
+        const double opt_flops = chain_opt.flops[count - 1], seq_flops = chain_seq.flops[count - 1];
+        check(opt_flops <= seq_flops, "Planned chain %d costs %lf flops, more than %lf in order",
+                c, opt_flops, seq_flops);
+        check(c == 0 || chain_opt.concurrent[count - 1], "Halves of chain %d not concurrent", c);
+
+        if (proc_rank == 0)
+        {
+            size_t total = 0, largest = 0;
+            for (uint32_t p = 0; p < count; p++)
+                total += (size_t) dims[p] * dims[p + 1];
+            for (uint32_t p = 0; p <= count; p++)
+                largest = dims[p] > largest ? dims[p] : largest;
+            chain_buf = (double *) malloc(total * sizeof(double));
+            check_mem(chain_buf);
+            chain_ref = (double *) malloc(3 * largest * largest * sizeof(double));
+            check_mem(chain_ref);
+            for (uint32_t p = 0, from = 0; p < count; from += dims[p] * dims[p + 1], p++)
+            {
+                double *block = chain_buf + from;
+                for (size_t row = 0; row < dims[p]; row++)
+                {
+                    for (size_t col = 0; col < dims[p + 1]; col++)
+                        block[row * dims[p + 1] + col] = c == 0
+                            ? (p % 2 ? m2 : m1)[row * width + col]
+                            : ((row * 37 + col * 11 + p) % 17 + 1) / 17.0l;
+                }
+                chain_m[p] = block;
+            }
+            // one product at a time, ping-ponging between two buffers
+            ref = chain_m[0];
+            for (uint32_t p = 1; p < count; p++)
+            {
+                double *next = chain_ref + (p % 2) * largest * largest;
+                matmul_rect_ref(ref, chain_m[p], next, dims[0], dims[p], dims[p + 1]);
+                ref = next;
+            }
+            chain_p = chain_ref + 2 * largest * largest;
+
+            double start_time = omp_get_wtime();
+            my_err = matmul_chain_omp(&chain_seq, chain_m, chain_p);
+            const double seq_time = omp_get_wtime() - start_time;
+            check(!my_err, "Something went wrong with the OMP chain in order");
+            for (size_t i = 0; i < size; i++)
+            {
+                check(percent_error(chain_p[i], ref[i]) < THRESHOLD,
+                        "Bad chain %d in order at %lu: %lf %lf", c, i, chain_p[i], ref[i]);
+            }
+            start_time = omp_get_wtime();
+            my_err = matmul_chain_omp(&chain_opt, chain_m, chain_p);
+            const double opt_time = omp_get_wtime() - start_time;
+            check(!my_err, "Something went wrong with the OMP chain");
+            for (size_t i = 0; i < size; i++)
+            {
+                check(percent_error(chain_p[i], ref[i]) < THRESHOLD,
+                        "Bad chain %d at %lu: %lf %lf", c, i, chain_p[i], ref[i]);
+            }
+            log_info("chain %d: %.0lf flops in %lf s, %.0lf flops in %lf s in order",
+                    c, opt_flops, opt_time, seq_flops, seq_time);
+            memset(chain_p, 0, size * sizeof(double));
+        }
+
+        my_err = matmul_chain_mpi(&chain_opt, chain_m, chain_p, proc_rank, num_procs);
+        check(!my_err, "Something went wrong with the MPI chain");
+
+        if (proc_rank == 0)
+        {
+            for (size_t i = 0; i < size; i++)
+            {
+                check(percent_error(chain_p[i], ref[i]) < THRESHOLD,
+                        "Bad MPI chain %d at %lu: %lf %lf", c, i, chain_p[i], ref[i]);
+            }
+            free(chain_buf);
+            free(chain_ref);
+            chain_buf = chain_ref = NULL;
+        }
+        chain_plan_free(&chain_opt);
+        chain_plan_free(&chain_seq);
+    }
+
+    // the products are the systems of the solvers below, Freivalds'
+    // test again that the kernels in between left them intact
+    if (proc_rank == 0)
+    {
+        my_err = verify_matmul_omp(m1, m2, p_omp, width_omp, transposed_b,
+                VERIFY_TRIALS, 8, VERIFY_TOL);
+        check(!my_err, "OMP matmul failed Freivalds' test");
+    }
+    my_err = verify_matmul_mpi(m1, m2, p_mpi, width_mpi, transposed_b,
+            VERIFY_TRIALS, 9, VERIFY_TOL, proc_rank, num_procs);
+    check(!my_err, "MPI matmul failed Freivalds' test");
+
     if(m1)
     {
         free(m1);
+        m1 = NULL;
         debug_mpi(proc_rank, "Freed m1");
     }
     if (m2) 
     {
         free(m2);
+        m2 = NULL;
         debug_mpi(proc_rank, "Freed m2");
     }
+    
+    // solving P X = B for a known X, see fill_rhs
+    const int nrhs = 4;
+    int refine_iter;
+    if (proc_rank == 0)
+    {
+        lu_omp = (double *) malloc(width * width * sizeof(double));
+        check_mem(lu_omp);
+        lu_mpi = (double *) malloc(width * width * sizeof(double));
+        check_mem(lu_mpi);
+        x_omp = (double *) malloc(width * nrhs * sizeof(double));
+        check_mem(x_omp);
+        x_mpi = (double *) malloc(width * nrhs * sizeof(double));
+        check_mem(x_mpi);
+        memcpy(lu_omp, p_omp, width * width * sizeof(double));
+        memcpy(lu_mpi, p_mpi, width * width * sizeof(double));
+        fill_rhs(p_omp, x_omp, width, nrhs);
+        fill_rhs(p_mpi, x_mpi, width, nrhs);
+
+        my_err = solve_omp(lu_omp, x_omp, width_omp, nrhs);
+        check(!my_err, "Something went wrong during OMP solve");
+    }
+
+    my_err = solve_mpi(lu_mpi, x_mpi, width_mpi, nrhs, proc_rank, num_procs);
+    check(!my_err, "Something went wrong during MPI solve");
 
     if (proc_rank == 0)
     {
-        for (size_t i = 0; i < width * width; i++)
+        for (size_t i = 0; i < width * nrhs; i++)
         {
-            double prcnt_err = percent_error(p_omp[i], p_mpi[i]);
-            check(prcnt_err < THRESHOLD, "MPI and OMP matmul differs at row %lu, col %lu: %lf %lf", i/width, i%width, p_omp[i], p_mpi[i]);
-    
-            double elmt;
-            scan_rv = scanf("%lf", &elmt);
-            check(scan_rv != EOF, "Unexpected EOF");
-            check(scan_rv > 0, "Couldn't scan valid double");
-    
-            prcnt_err = percent_error(p_omp[i], elmt);
-            check(prcnt_err < THRESHOLD, "OMP and actual matmul differs at\
-                    row %lu, col %lu: %lf %lf", 
-                    i/width, i%width, p_omp[i], elmt);
-    
-            prcnt_err = percent_error(p_mpi[i], elmt);
-            check(prcnt_err < THRESHOLD, "MPI and actual matmul differs at\
-                    row %lu, col %lu: %lf %lf", 
-                    i/width, i%width, p_mpi[i], elmt);
+            double expected = (double) (i % nrhs + 1);
+            check(percent_error(x_omp[i], expected) < THRESHOLD,
+                    "Bad OMP solve: %lu %lf %lf", i, x_omp[i], expected);
+            check(percent_error(x_mpi[i], expected) < THRESHOLD,
+                    "Bad MPI solve: %lu %lf %lf", i, x_mpi[i], expected);
         }
+
+        // the factors and the solutions through their residuals
+        rhs = (double *) malloc(width * nrhs * sizeof(double));
+        check_mem(rhs);
+        fill_rhs(p_omp, rhs, width, nrhs);
+        my_err = verify_lu_omp(p_omp, lu_omp, width_omp, VERIFY_TRIALS, 5, VERIFY_TOL)
+            || verify_lu_omp(p_mpi, lu_mpi, width_omp, VERIFY_TRIALS, 8, VERIFY_TOL);
+        check(!my_err, "Bad LU residual");
+        my_err = verify_solve_omp(p_omp, x_omp, rhs, width_omp, nrhs, VERIFY_TOL);
+        check(!my_err, "Bad OMP solve residual");
+        fill_rhs(p_mpi, rhs, width, nrhs);
+        my_err = verify_solve_omp(p_mpi, x_mpi, rhs, width_omp, nrhs, VERIFY_TOL);
+        check(!my_err, "Bad MPI solve residual");
+        free(rhs);
+        rhs = NULL;
+
+        // same system through the mixed precision solvers,
+        // which leave P untouched
+        fill_rhs(p_omp, x_omp, width, nrhs);
+        fill_rhs(p_mpi, x_mpi, width, nrhs);
+        my_err = solve_mixed_omp(p_omp, x_omp, width_omp, nrhs, &refine_iter);
+        check(!my_err, "Something went wrong during OMP mixed precision solve");
+        check(refine_iter >= 0, "OMP mixed precision refinement fell back to double after %d steps",
+                -refine_iter - 1);
+        debug("OMP mixed precision refinement steps: %d", refine_iter);
     }
-    
+
+    my_err = solve_mixed_mpi(p_mpi, x_mpi, width_mpi, nrhs,
+            proc_rank, num_procs, &refine_iter);
+    check(!my_err, "Something went wrong during MPI mixed precision solve");
+    check(refine_iter >= 0, "MPI mixed precision refinement fell back to double after %d steps",
+            -refine_iter - 1);
+
+    if (proc_rank == 0)
+    {
+        debug("MPI mixed precision refinement steps: %d", refine_iter);
+        for (size_t i = 0; i < width * nrhs; i++)
+        {
+            double expected = (double) (i % nrhs + 1);
+            check(percent_error(x_omp[i], expected) < THRESHOLD,
+                    "Bad OMP mixed solve: %lu %lf %lf", i, x_omp[i], expected);
+            check(percent_error(x_mpi[i], expected) < THRESHOLD,
+                    "Bad MPI mixed solve: %lu %lf %lf", i, x_mpi[i], expected);
+        }
+        free(lu_omp); free(lu_mpi); free(x_omp); free(x_mpi);
+        lu_omp = lu_mpi = x_omp = x_mpi = NULL;
+    }
+
+    // a system that overflows single precision, where both solvers
+    // have to fall back to double instead of refining NaNs
+    {
+        double big[4] = {1e300, 1.0l, 1.0l, 1e300};
+        double big_x[2] = {1e300, 1e300};
+        if (proc_rank == 0)
+        {
+            my_err = solve_mixed_omp(big, big_x, 2, 1, &refine_iter);
+            check(!my_err, "Something went wrong during OMP mixed precision solve");
+            check(refine_iter < 0, "OMP mixed precision solve refined an overflowing system");
+            for (int i = 0; i < 2; i++)
+            {
+                check(percent_error(big_x[i], 1.0l) < THRESHOLD,
+                        "Bad OMP mixed solve of the overflowing system: %d %lf", i, big_x[i]);
+                big_x[i] = 1e300;
+            }
+        }
+        my_err = solve_mixed_mpi(big, big_x, 2, 1, proc_rank, num_procs, &refine_iter);
+        check(!my_err, "Something went wrong during MPI mixed precision solve");
+        check(refine_iter < 0, "MPI mixed precision solve refined an overflowing system");
+        for (int i = 0; proc_rank == 0 && i < 2; i++)
+        {
+            check(percent_error(big_x[i], 1.0l) < THRESHOLD,
+                    "Bad MPI mixed solve of the overflowing system: %d %lf", i, big_x[i]);
+        }
+    }
+
     if (proc_rank == 0)
     {
+        check(!morton_alloc(&zp, width_omp), "Morton allocation failed");
+        my_err = morton_from_rowmajor_omp(&zp, p_omp);
+        check(!my_err, "Conversion to Morton order failed");
+        my_err = ooc_write_matrix(ooc_paths[2], p_omp, width_omp);
+        check(!my_err, "Writing a matrix file failed");
+        sym = (double *) malloc(width * width * sizeof(double));
+        check_mem(sym);
+        memcpy(sym, p_omp, width * width * sizeof(double));
         my_err = gaussian_elimination_naive_inplace_omp(p_omp, width_omp);
         check(!my_err, "Something went wrong during OMP gauss elim");
+
+        // the persistent team, also with more threads than there are
+        // cores and rows for some of them to wait idle
+        const int max_threads = omp_get_max_threads();
+        omp_set_num_threads(max_threads + 3);
+        my_err = gaussian_elimination_persistent_omp(sym, width_omp);
+        omp_set_num_threads(max_threads);
+        check(!my_err, "Something went wrong during persistent gauss elim");
+        for (size_t i = 0; i < width * width; i++)
+        {
+            check(percent_error(sym[i], p_omp[i]) < THRESHOLD,
+                    "Bad persistent gausselim at %lu: %lf %lf", i, sym[i], p_omp[i]);
+        }
+
+        // tile elimination on the Morton copy against the row-major one
+        my_err = gaussian_elimination_morton_omp(&zp);
+        check(!my_err, "Something went wrong during Morton gauss elim");
+        my_err = morton_to_rowmajor_omp(&zp, sym);
+        check(!my_err, "Conversion from Morton order failed");
+        for (size_t i = 0; i < width * width; i++)
+        {
+            check(percent_error(sym[i], p_omp[i]) < THRESHOLD,
+                    "Bad Morton gausselim at %lu: %lf %lf", i, sym[i], p_omp[i]);
+        }
+
+        // and on the file, out of core
+        my_err = gaussian_elimination_ooc_omp(ooc_paths[2], 9 * 3 * width * sizeof(double));
+        check(!my_err, "Something went wrong during out-of-core gauss elim");
+        my_err = ooc_read_matrix(ooc_paths[2], sym, width_omp);
+        check(!my_err, "Reading a matrix file failed");
+        for (size_t i = 0; i < width * width; i++)
+        {
+            check(percent_error(sym[i], p_omp[i]) < THRESHOLD,
+                    "Bad out-of-core gausselim at %lu: %lf %lf", i, sym[i], p_omp[i]);
+        }
+        free(sym);
+        sym = NULL;
+        morton_free(&zp);
+        for (; ooc_made > 0; ooc_made--)
+            unlink(ooc_paths[ooc_made - 1]);
     }
 
     my_err = gaussian_elimination_naive_inplace_mpi(p_mpi, width_mpi, 
@@ -192,6 +1126,7 @@ int main(int argc, char *argv[])
         free(p_mpi);
         debug_mpi(proc_rank, "Freed p_mpi");
     }
+    mat_scratch_release();
 
 
     mpi_err = MPI_Finalize();
@@ -206,10 +1141,54 @@ error:
         free(m1);
     if (m2)
         free(m2);
+    if (rhs)
+        free(rhs);
+    matgen_free(&gen);
     if (p_omp)
         free(p_omp);
     if (p_mpi)
         free(p_mpi);
+    if (lu_omp)
+        free(lu_omp);
+    if (lu_mpi)
+        free(lu_mpi);
+    if (x_omp)
+        free(x_omp);
+    if (x_mpi)
+        free(x_mpi);
+    if (sym)
+        free(sym);
+    if (sym_ref)
+        free(sym_ref);
+    if (rows_a)
+        free(rows_a);
+    if (rows_at)
+        free(rows_at);
+    if (row_counts)
+        free(row_counts);
+    if (batch_m1)
+        free(batch_m1);
+    if (batch_m2)
+        free(batch_m2);
+    if (batch_ref)
+        free(batch_ref);
+    if (batch_omp)
+        free(batch_omp);
+    if (batch_il)
+        free(batch_il);
+    if (batch_mpi)
+        free(batch_mpi);
+    morton_free(&z1); morton_free(&z2); morton_free(&zp);
+    sparse_free(&sp_a); sparse_free(&sp_b);
+    band_free(&band);
+    chain_plan_free(&chain_opt); chain_plan_free(&chain_seq);
+    if (chain_buf)
+        free(chain_buf);
+    if (chain_ref)
+        free(chain_ref);
+    for (; ooc_made > 0; ooc_made--)
+        unlink(ooc_paths[ooc_made - 1]);
+    mat_scratch_release();
     mpi_err = MPI_Initialized(&mpi_init_flag);
     if (mpi_err)
         log_warn("Call to `MPI_Initialized` returned with error");
@@ -223,5 +1202,5 @@ error:
         else
             log_info("done");
     }
-     
+    return -1;
 }
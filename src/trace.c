@@ -0,0 +1,146 @@
+#include "dbg.h"
+#include "trace.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+/* Only built with -DTRACE, see trace.h */
+
+typedef struct {
+    const char *name;
+    double begin;
+    double end;
+} trace_event_t;
+
+typedef struct {
+    unsigned long count;  // events recorded, the ring holds the last ones
+    int thread;
+    trace_event_t events[TRACE_EVENTS_PER_THREAD];
+} trace_ring_t;
+
+// -1: not looked at the environment yet, 0: off, 1: on
+static int enabled = -1;
+static int rank = 0;
+static double clock_offset = 0.0;
+
+// rings are registered once per thread and only read by the dumps
+static trace_ring_t *rings[TRACE_MAX_THREADS];
+static int num_rings = 0;
+static _Thread_local trace_ring_t *ring = NULL;
+static _Thread_local int ring_failed = 0;
+
+
+int
+trace_enabled(void)
+{
+    if (enabled < 0)
+    {
+        const char *env = getenv("TRACE_FILE");
+        enabled = env && strcmp(env, "");
+    }
+    return enabled;
+}
+
+
+double
+trace_now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double) ts.tv_sec + 1e-9 * (double) ts.tv_nsec;
+}
+
+
+static trace_ring_t *
+register_ring(void)
+{
+    const int slot = __atomic_fetch_add(&num_rings, 1, __ATOMIC_RELAXED);
+    check(slot < TRACE_MAX_THREADS, "More than %d threads, not tracing this one", TRACE_MAX_THREADS);
+    ring = (trace_ring_t *) malloc(sizeof(trace_ring_t));
+    check_mem(ring);
+    ring->count = 0;
+    ring->thread = slot;
+#   ifdef _OPENMP
+    ring->thread = omp_get_thread_num();
+#   endif
+    __atomic_store_n(&rings[slot], ring, __ATOMIC_RELEASE);
+    return ring;
+error:
+    ring_failed = 1;
+    return NULL;
+}
+
+
+void
+trace_event(const char *name, double begin)
+{
+    const double end = trace_now();
+    if (!trace_enabled() || ring_failed)
+        return;
+    if (!ring && !register_ring())
+        return;
+    trace_event_t *event = &ring->events[ring->count % TRACE_EVENTS_PER_THREAD];
+    event->name = name;
+    event->begin = begin;
+    event->end = end;
+    ring->count++;
+}
+
+
+void
+trace_set_rank(int r, double offset)
+{
+    rank = r;
+    clock_offset = offset;
+}
+
+
+void
+trace_write(FILE *file, int first)
+{
+    fprintf(file, "%s{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, "
+            "\"args\": {\"name\": \"rank %d\"}}", first ? "" : ",\n", rank, rank);
+    const int count = num_rings < TRACE_MAX_THREADS ? num_rings : TRACE_MAX_THREADS;
+    for (int i = 0; i < count; i++)
+    {
+        const trace_ring_t *r = __atomic_load_n(&rings[i], __ATOMIC_ACQUIRE);
+        if (!r)
+            continue;
+        const unsigned long oldest = r->count > TRACE_EVENTS_PER_THREAD
+            ? r->count - TRACE_EVENTS_PER_THREAD : 0;
+        if (oldest)
+            log_warn("Thread %d dropped its %lu oldest trace events", r->thread, oldest);
+        for (unsigned long n = oldest; n < r->count; n++)
+        {
+            const trace_event_t *e = &r->events[n % TRACE_EVENTS_PER_THREAD];
+            // microseconds on rank 0's clock
+            fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, "
+                    "\"ts\": %.3f, \"dur\": %.3f}", e->name, rank, r->thread,
+                    1e6 * (e->begin + clock_offset), 1e6 * (e->end - e->begin));
+        }
+    }
+}
+
+
+int
+trace_dump(void)
+{
+    FILE *file = NULL;
+    if (!trace_enabled())
+        return 0;
+    const char *path = getenv("TRACE_FILE");
+    file = fopen(path, "w");
+    check(file, "Could not open trace file %s", path);
+    fputs("[\n", file);
+    trace_write(file, 1);
+    fputs("\n]\n", file);
+    fclose(file);
+    return 0;
+error:
+    return -1;
+}
@@ -0,0 +1,109 @@
+#include "dbg.h"
+#include "transpose.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Built into every target, the OpenMP pragmas are only seen by the
+ * ones compiled with -fopenmp */
+
+
+static void
+transpose_leaf(const double *restrict A, size_t lda, double *restrict B,
+        size_t ldb, uint32_t rows, uint32_t cols)
+{
+    for (uint32_t row = 0; row < rows; row++)
+    {
+        for (uint32_t col = 0; col < cols; col++)
+            B[col*ldb + row] = A[row*lda + col];
+    }
+}
+
+
+static void
+transpose_recursive(const double *A, size_t lda, double *B, size_t ldb,
+        uint32_t rows, uint32_t cols)
+{
+    if (rows <= TRANSPOSE_LEAF && cols <= TRANSPOSE_LEAF)
+    {
+        transpose_leaf(A, lda, B, ldb, rows, cols);
+    }
+    else if (rows >= cols)
+    {
+        const uint32_t half = rows / 2;
+        transpose_recursive(A, lda, B, ldb, half, cols);
+        transpose_recursive(A + half*lda, lda, B + half, ldb, rows - half, cols);
+    }
+    else
+    {
+        const uint32_t half = cols / 2;
+        transpose_recursive(A, lda, B, ldb, rows, half);
+        transpose_recursive(A + half, lda, B + half*ldb, ldb, rows, cols - half);
+    }
+}
+
+
+int
+transpose_omp(const double *A, uint32_t lda, double *B, uint32_t ldb,
+        uint32_t rows, uint32_t cols)
+{
+    check_mem(A); check_mem(B);
+    check(lda >= cols && ldb >= rows, "Row strides smaller than the rows");
+    const uint32_t row_tiles = (rows + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+    const uint32_t col_tiles = (cols + TRANSPOSE_TILE - 1) / TRANSPOSE_TILE;
+
+#   ifdef _OPENMP
+#   pragma omp parallel for collapse(2) schedule(static)
+#   endif
+    for (uint32_t row_tile = 0; row_tile < row_tiles; row_tile++)
+    {
+        for (uint32_t col_tile = 0; col_tile < col_tiles; col_tile++)
+        {
+            const uint32_t row = row_tile * TRANSPOSE_TILE, col = col_tile * TRANSPOSE_TILE;
+            const uint32_t tile_rows = rows - row < TRANSPOSE_TILE ? rows - row : TRANSPOSE_TILE;
+            const uint32_t tile_cols = cols - col < TRANSPOSE_TILE ? cols - col : TRANSPOSE_TILE;
+            transpose_recursive(A + (size_t) row*lda + col, lda,
+                    B + (size_t) col*ldb + row, ldb, tile_rows, tile_cols);
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+int
+transpose_inplace_omp(double *A, uint32_t width)
+{
+    check_mem(A);
+    const uint32_t tiles = (width + TRANSPOSE_LEAF - 1) / TRANSPOSE_LEAF;
+
+    // pairs of leaf tiles above and below the diagonal are swapped by
+    // the same thread, there are fewer of them in the later tile rows
+#   ifdef _OPENMP
+#   pragma omp parallel for schedule(dynamic)
+#   endif
+    for (uint32_t tile_row = 0; tile_row < tiles; tile_row++)
+    {
+        const uint32_t row_begin = tile_row * TRANSPOSE_LEAF;
+        const uint32_t row_end = row_begin + TRANSPOSE_LEAF < width ? row_begin + TRANSPOSE_LEAF : width;
+        for (uint32_t tile_col = tile_row; tile_col < tiles; tile_col++)
+        {
+            const uint32_t col_begin = tile_col * TRANSPOSE_LEAF;
+            const uint32_t col_end = col_begin + TRANSPOSE_LEAF < width ? col_begin + TRANSPOSE_LEAF : width;
+            for (uint32_t row = row_begin; row < row_end; row++)
+            {
+                // on the diagonal tile only the upper triangle swaps
+                for (uint32_t col = (tile_col == tile_row ? row + 1 : col_begin); col < col_end; col++)
+                {
+                    const double tmp = A[(size_t) row*width + col];
+                    A[(size_t) row*width + col] = A[(size_t) col*width + row];
+                    A[(size_t) col*width + row] = tmp;
+                }
+            }
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
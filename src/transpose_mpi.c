@@ -0,0 +1,86 @@
+#include "dbg.h"
+#include "matalloc.h"
+#include "transpose.h"
+
+#include <mpi.h>
+#include <stdlib.h>
+
+int
+transpose_mpi(const double *A_rows, double *B_rows, int width,
+        int proc_rank, int num_procs)
+{
+    int *rows = NULL, *offsets = NULL, *send_counts = NULL, *send_displs = NULL;
+    int *recv_counts = NULL, *recv_displs = NULL;
+    MPI_Datatype *send_types = NULL, *recv_types = NULL;
+    int num_types = 0;
+    check(width >= num_procs, "Poorly balanced problem: (%d rows, %d processes)", width, num_procs);
+
+    rows = (int *) malloc(6 * num_procs * sizeof(int));
+    check_mem(rows);
+    offsets = rows + num_procs;
+    send_counts = rows + 2 * num_procs;
+    send_displs = rows + 3 * num_procs;
+    recv_counts = rows + 4 * num_procs;
+    recv_displs = rows + 5 * num_procs;
+    send_types = (MPI_Datatype *) malloc(2 * num_procs * sizeof(MPI_Datatype));
+    check_mem(send_types);
+    recv_types = send_types + num_procs;
+
+    for (int i = 0, offset = 0; i < num_procs; i++)
+    {
+        rows[i] = width / num_procs + (i < width % num_procs);
+        offsets[i] = offset;
+        offset += rows[i];
+    }
+    const int my_rows = rows[proc_rank];
+    check(my_rows == 0 || (A_rows && B_rows), "No local rows to transpose");
+
+    /* the block for process d is A_rows[:, offsets[d]:] transposed,
+     * rows[d] x my_rows, packed one after the other */
+    double *send_buf = (double *) mat_scratch(SCRATCH_ALLTOALL,
+            (size_t) my_rows * width * sizeof(double));
+    check_mem(send_buf);
+    size_t packed = 0;
+    for (int d = 0; d < num_procs; d++)
+    {
+        if (my_rows > 0 && rows[d] > 0)
+            check(!transpose_omp(A_rows + offsets[d], (uint32_t) width, send_buf + packed,
+                        (uint32_t) my_rows, (uint32_t) my_rows, (uint32_t) rows[d]),
+                    "Local transpose failed");
+        send_counts[d] = rows[d] * my_rows;
+        send_displs[d] = (int) (packed * sizeof(double));
+        send_types[d] = MPI_DOUBLE;
+        packed += (size_t) rows[d] * my_rows;
+    }
+
+    /* the block from process s goes to columns offsets[s] onward of
+     * B_rows, a strided datatype puts it there without unpacking */
+    for (int s = 0; s < num_procs; s++)
+    {
+        int mpi_err = MPI_Type_vector(my_rows, rows[s], width, MPI_DOUBLE, recv_types + s);
+        check(!mpi_err, "MPI_Type_vector failed");
+        num_types++;
+        mpi_err = MPI_Type_commit(recv_types + s);
+        check(!mpi_err, "MPI_Type_commit failed");
+        recv_counts[s] = (my_rows > 0 && rows[s] > 0) ? 1 : 0;
+        recv_displs[s] = (int) (offsets[s] * sizeof(double));
+    }
+
+    int mpi_err = MPI_Alltoallw(send_buf, send_counts, send_displs, send_types,
+            B_rows, recv_counts, recv_displs, recv_types, MPI_COMM_WORLD);
+    check(!mpi_err, "MPI_Alltoallw failed");
+
+    for (int s = 0; s < num_types; s++)
+        MPI_Type_free(recv_types + s);
+    free(send_types);
+    free(rows);
+    return EXIT_SUCCESS;
+error:
+    for (int s = 0; s < num_types; s++)
+        MPI_Type_free(recv_types + s);
+    if (send_types)
+        free(send_types);
+    if (rows)
+        free(rows);
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,241 @@
+#include "dbg.h"
+#include "verify.h"
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Built into every target, the OpenMP pragmas are only seen by the
+ * ones compiled with -fopenmp */
+
+// rows of Y per thread and sweep in the transposed product
+#define VERIFY_BLOCK 64
+
+
+int
+verify_block_omp(const double *M, const double *X, double *Y, uint32_t width,
+        uint32_t trials, int transposed, int absolute)
+{
+    check_mem(M); check_mem(X); check_mem(Y);
+    const size_t n = width;
+    if (!transposed)
+    {
+#       ifdef _OPENMP
+#       pragma omp parallel for schedule(static)
+#       endif
+        for (size_t row = 0; row < n; row++)
+        {
+            double *Y_row = Y + row * trials;
+            memset(Y_row, 0, trials * sizeof(double));
+            for (size_t k = 0; k < n; k++)
+            {
+                const double elmt = absolute ? fabs(M[row * n + k]) : M[row * n + k];
+                const double *X_row = X + k * trials;
+                for (uint32_t t = 0; t < trials; t++)
+                    Y_row[t] += elmt * X_row[t];
+            }
+        }
+    }
+    else
+    {
+        // row k of Y takes column k of M, each thread sweeps all rows
+        // of M for its block of columns
+#       ifdef _OPENMP
+#       pragma omp parallel for schedule(static)
+#       endif
+        for (size_t block = 0; block < n; block += VERIFY_BLOCK)
+        {
+            const size_t end = n - block < VERIFY_BLOCK ? n : block + VERIFY_BLOCK;
+            memset(Y + block * trials, 0, (end - block) * trials * sizeof(double));
+            for (size_t j = 0; j < n; j++)
+            {
+                const double *X_row = X + j * trials;
+                for (size_t k = block; k < end; k++)
+                {
+                    const double elmt = absolute ? fabs(M[j * n + k]) : M[j * n + k];
+                    for (uint32_t t = 0; t < trials; t++)
+                        Y[k * trials + t] += elmt * X_row[t];
+                }
+            }
+        }
+    }
+    return 0;
+error:
+    return -1;
+}
+
+
+void
+verify_random_block(double *X, uint32_t width, uint32_t trials, uint64_t seed)
+{
+    // xorshift64*, uniform in [-1, 1)
+    uint64_t state = seed * 2685821657736338717ull + 1;
+    for (size_t i = 0; i < (size_t) width * trials; i++)
+    {
+        state ^= state >> 12; state ^= state << 25; state ^= state >> 27;
+        X[i] = (double) ((state * 2685821657736338717ull) >> 11) / 4503599627370496.0 - 1.0;
+    }
+}
+
+
+double
+verify_worst_ratio(const double *Z, const double *W, const double *S, size_t count,
+        size_t *where)
+{
+    double worst = 0.0;
+    *where = 0;
+    for (size_t i = 0; i < count; i++)
+    {
+        const double diff = fabs(Z[i] - W[i]);
+        const double ratio = diff == 0.0 ? 0.0 : diff / S[i];
+        if (isnan(ratio))
+        {
+            // a NaN anywhere fails the check
+            *where = i;
+            return INFINITY;
+        }
+        if (ratio > worst)
+        {
+            worst = ratio;
+            *where = i;
+        }
+    }
+    return worst;
+}
+
+
+int
+verify_matmul_omp(const double *A, const double *B, const double *P, uint32_t width,
+        int transposed_b, uint32_t trials, uint64_t seed, double tol)
+{
+    double *work = NULL;
+    check_mem(A); check_mem(B); check_mem(P);
+    check(trials > 0, "No trials");
+    const size_t block = (size_t) width * trials;
+    work = (double *) malloc(8 * block * sizeof(double));
+    check_mem(work);
+    double *X = work, *X_abs = X + block, *Y = X_abs + block, *Y_abs = Y + block;
+    double *Z = Y_abs + block, *S = Z + block, *W = S + block, *S_P = W + block;
+
+    verify_random_block(X, width, trials, seed);
+    for (size_t i = 0; i < block; i++)
+        X_abs[i] = fabs(X[i]);
+    int my_err = verify_block_omp(B, X, Y, width, trials, transposed_b, 0)
+        || verify_block_omp(B, X_abs, Y_abs, width, trials, transposed_b, 1)
+        || verify_block_omp(A, Y, Z, width, trials, 0, 0)
+        || verify_block_omp(A, Y_abs, S, width, trials, 0, 1)
+        || verify_block_omp(P, X, W, width, trials, 0, 0)
+        || verify_block_omp(P, X_abs, S_P, width, trials, 0, 1);
+    check(!my_err, "Products with the random vectors failed");
+    for (size_t i = 0; i < block; i++)
+        S[i] += S_P[i];
+
+    size_t where;
+    const double worst = verify_worst_ratio(Z, W, S, block, &where);
+    check(worst <= tol, "Freivalds test failed at row %lu (vector %lu): %le against %le, error %le",
+            where / trials, where % trials, W[where], Z[where], worst);
+    free(work);
+    return 0;
+error:
+    if (work)
+        free(work);
+    return -1;
+}
+
+
+// Y = op(LU) X, the upper triangle U or the unit lower triangle L
+static void
+triangle_block(const double *LU, const double *X, double *Y, size_t n, uint32_t trials,
+        int upper, int absolute)
+{
+#   ifdef _OPENMP
+#   pragma omp parallel for schedule(dynamic, 16)
+#   endif
+    for (size_t row = 0; row < n; row++)
+    {
+        double *Y_row = Y + row * trials;
+        const size_t begin = upper ? row : 0, end = upper ? n : row + 1;
+        memset(Y_row, 0, trials * sizeof(double));
+        for (size_t k = begin; k < end; k++)
+        {
+            double elmt = (!upper && k == row) ? 1.0 : LU[row * n + k];
+            elmt = absolute ? fabs(elmt) : elmt;
+            const double *X_row = X + k * trials;
+            for (uint32_t t = 0; t < trials; t++)
+                Y_row[t] += elmt * X_row[t];
+        }
+    }
+}
+
+
+int
+verify_lu_omp(const double *M, const double *LU, uint32_t width,
+        uint32_t trials, uint64_t seed, double tol)
+{
+    double *work = NULL;
+    check_mem(M); check_mem(LU);
+    check(trials > 0, "No trials");
+    const size_t n = width, block = n * trials;
+    work = (double *) malloc(8 * block * sizeof(double));
+    check_mem(work);
+    double *X = work, *X_abs = X + block, *Y = X_abs + block, *Y_abs = Y + block;
+    double *Z = Y_abs + block, *S = Z + block, *W = S + block, *S_M = W + block;
+
+    verify_random_block(X, width, trials, seed);
+    for (size_t i = 0; i < block; i++)
+        X_abs[i] = fabs(X[i]);
+    triangle_block(LU, X, Y, n, trials, 1, 0);
+    triangle_block(LU, X_abs, Y_abs, n, trials, 1, 1);
+    triangle_block(LU, Y, Z, n, trials, 0, 0);
+    triangle_block(LU, Y_abs, S, n, trials, 0, 1);
+    int my_err = verify_block_omp(M, X, W, width, trials, 0, 0)
+        || verify_block_omp(M, X_abs, S_M, width, trials, 0, 1);
+    check(!my_err, "Products with the random vectors failed");
+    for (size_t i = 0; i < block; i++)
+        S[i] += S_M[i];
+
+    size_t where;
+    const double worst = verify_worst_ratio(Z, W, S, block, &where);
+    check(worst <= tol, "LU residual too large at row %lu (vector %lu): %le against %le, error %le",
+            where / trials, where % trials, W[where], Z[where], worst);
+    free(work);
+    return 0;
+error:
+    if (work)
+        free(work);
+    return -1;
+}
+
+
+int
+verify_solve_omp(const double *M, const double *X, const double *B, uint32_t width,
+        uint32_t nrhs, double tol)
+{
+    double *work = NULL;
+    check_mem(M); check_mem(X); check_mem(B);
+    const size_t block = (size_t) width * nrhs;
+    work = (double *) malloc(3 * block * sizeof(double));
+    check_mem(work);
+    double *MX = work, *X_abs = MX + block, *S = X_abs + block;
+
+    for (size_t i = 0; i < block; i++)
+        X_abs[i] = fabs(X[i]);
+    int my_err = verify_block_omp(M, X, MX, width, nrhs, 0, 0)
+        || verify_block_omp(M, X_abs, S, width, nrhs, 0, 1);
+    check(!my_err, "Residual products failed");
+    for (size_t i = 0; i < block; i++)
+        S[i] += fabs(B[i]);
+
+    size_t where;
+    const double worst = verify_worst_ratio(MX, B, S, block, &where);
+    check(worst <= tol, "Residual too large at row %lu (column %lu): %le against %le, error %le",
+            where / nrhs, where % nrhs, MX[where], B[where], worst);
+    free(work);
+    return 0;
+error:
+    if (work)
+        free(work);
+    return -1;
+}
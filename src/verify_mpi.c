@@ -0,0 +1,168 @@
+#include "dbg.h"
+#include "verify.h"
+
+#include <math.h>
+#include <mpi.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Built into every target, the OpenMP pragmas are only seen by the
+ * ones compiled with -fopenmp */
+
+
+/* Y = M X and Y_abs = |M| X_abs for the rows x width block M, or the
+ * width x trials sums Y += M^T X (and Y_abs += |M|^T X_abs) over the
+ * rows of M when transposed, X then being the matching rows */
+static void
+rows_block(const double *M, const double *X, const double *X_abs, double *Y,
+        double *Y_abs, int rows, int width, int trials, int transposed)
+{
+    const size_t n = width;
+    if (!transposed)
+    {
+#       ifdef _OPENMP
+#       pragma omp parallel for schedule(static)
+#       endif
+        for (int row = 0; row < rows; row++)
+        {
+            double *Y_row = Y + (size_t) row * trials, *Y_abs_row = Y_abs + (size_t) row * trials;
+            memset(Y_row, 0, trials * sizeof(double));
+            memset(Y_abs_row, 0, trials * sizeof(double));
+            for (size_t k = 0; k < n; k++)
+            {
+                const double elmt = M[row * n + k];
+                const double *X_row = X + k * trials, *X_abs_row = X_abs + k * trials;
+                for (int t = 0; t < trials; t++)
+                {
+                    Y_row[t] += elmt * X_row[t];
+                    Y_abs_row[t] += fabs(elmt) * X_abs_row[t];
+                }
+            }
+        }
+    }
+    else
+    {
+        memset(Y, 0, n * trials * sizeof(double));
+        memset(Y_abs, 0, n * trials * sizeof(double));
+#       ifdef _OPENMP
+#       pragma omp parallel for schedule(static)
+#       endif
+        for (size_t k = 0; k < n; k++)
+        {
+            for (int row = 0; row < rows; row++)
+            {
+                const double elmt = M[row * n + k];
+                const double *X_row = X + (size_t) row * trials, *X_abs_row = X_abs + (size_t) row * trials;
+                for (int t = 0; t < trials; t++)
+                {
+                    Y[k * trials + t] += elmt * X_row[t];
+                    Y_abs[k * trials + t] += fabs(elmt) * X_abs_row[t];
+                }
+            }
+        }
+    }
+}
+
+
+int
+verify_matmul_mpi(const double *A, const double *B, const double *P, int width,
+        int transposed_b, int trials, uint64_t seed, double tol,
+        int proc_rank, int num_procs)
+{
+    int *counts = NULL;
+    double *local = NULL, *work = NULL;
+    int mpi_err, my_err = 0;
+    check(trials > 0, "No trials");
+    check(width >= num_procs, "Poorly balanced problem: (%d rows, %d processes)", width, num_procs);
+    mpi_err = MPI_Bcast(&seed, 1, MPI_UINT64_T, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Broadcasting the seed failed");
+
+    // rows split as in the kernels, counts and offsets in doubles for
+    // the matrices and in vectors for the blocks
+    counts = (int *) malloc(4 * num_procs * sizeof(int));
+    check_mem(counts);
+    int *offsets = counts + num_procs, *block_counts = offsets + num_procs;
+    int *block_offsets = block_counts + num_procs;
+    for (int i = 0, offset = 0; i < num_procs; i++)
+    {
+        const int rows = width / num_procs + (i < width % num_procs);
+        counts[i] = rows * width;
+        offsets[i] = offset * width;
+        block_counts[i] = rows * trials;
+        block_offsets[i] = offset * trials;
+        offset += rows;
+    }
+    const int my_rows = width / num_procs + (proc_rank < width % num_procs);
+    const int my_first = block_offsets[proc_rank] / trials;
+    const size_t local_size = (size_t) my_rows * width;
+    const size_t block = (size_t) width * trials, my_block = (size_t) my_rows * trials;
+
+    local = (double *) malloc(3 * local_size * sizeof(double));
+    check_mem(local);
+    double *A_local = local, *B_local = A_local + local_size, *P_local = B_local + local_size;
+    mpi_err = MPI_Scatterv(A, counts, offsets, MPI_DOUBLE, A_local, local_size,
+            MPI_DOUBLE, 0, MPI_COMM_WORLD)
+        || MPI_Scatterv(B, counts, offsets, MPI_DOUBLE, B_local, local_size,
+            MPI_DOUBLE, 0, MPI_COMM_WORLD)
+        || MPI_Scatterv(P, counts, offsets, MPI_DOUBLE, P_local, local_size,
+            MPI_DOUBLE, 0, MPI_COMM_WORLD);
+    check(!mpi_err, "Scattering the rows failed");
+
+    // X and |X| everywhere, then Y = op(B) X and |op(B)| |X|, then the
+    // local rows of A Y against P X
+    work = (double *) malloc((4 * block + 4 * my_block) * sizeof(double));
+    check_mem(work);
+    double *X = work, *X_abs = X + block, *Y = X_abs + block, *Y_abs = Y + block;
+    double *Z = Y_abs + block, *S = Z + my_block, *W = S + my_block, *S_P = W + my_block;
+    verify_random_block(X, width, trials, seed);
+    for (size_t i = 0; i < block; i++)
+        X_abs[i] = fabs(X[i]);
+
+    const size_t mine = (size_t) my_first * trials;
+    if (transposed_b)
+    {
+        // every process sums its rows of B into all of Y
+        rows_block(B_local, X + mine, X_abs + mine, Y, Y_abs, my_rows, width, trials, 1);
+        mpi_err = MPI_Allreduce(MPI_IN_PLACE, Y, 2 * block, MPI_DOUBLE, MPI_SUM, MPI_COMM_WORLD);
+        check(!mpi_err, "Reducing B^T X failed");
+    }
+    else
+    {
+        rows_block(B_local, X, X_abs, Y + mine, Y_abs + mine, my_rows, width, trials, 0);
+        mpi_err = MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, Y, block_counts,
+                block_offsets, MPI_DOUBLE, MPI_COMM_WORLD)
+            || MPI_Allgatherv(MPI_IN_PLACE, 0, MPI_DATATYPE_NULL, Y_abs, block_counts,
+                block_offsets, MPI_DOUBLE, MPI_COMM_WORLD);
+        check(!mpi_err, "Gathering B X failed");
+    }
+    rows_block(A_local, Y, Y_abs, Z, S, my_rows, width, trials, 0);
+    rows_block(P_local, X, X_abs, W, S_P, my_rows, width, trials, 0);
+    for (size_t i = 0; i < my_block; i++)
+        S[i] += S_P[i];
+
+    size_t where;
+    const double my_worst = verify_worst_ratio(Z, W, S, my_block, &where);
+    double worst;
+    mpi_err = MPI_Allreduce(&my_worst, &worst, 1, MPI_DOUBLE, MPI_MAX, MPI_COMM_WORLD);
+    check(!mpi_err, "Reducing the verdict failed");
+    if (worst > tol)
+    {
+        if (my_worst == worst)
+            log_err("Freivalds test failed at row %lu (vector %lu): %le against %le, error %le",
+                    my_first + where / trials, where % trials, W[where], Z[where], worst);
+        my_err = -1;
+    }
+
+    free(counts); free(local); free(work);
+    return my_err;
+error:
+    if (counts)
+        free(counts);
+    if (local)
+        free(local);
+    if (work)
+        free(work);
+    return -1;
+}
@@ -0,0 +1,193 @@
+"""
+Strong and weak scaling study for the OpenMP and MPI kernels.
+
+Runs bin/bench.out for every matmul method in `omp_methods[]` and
+`mpi_methods[]` (see src/test_gelim.c) and for the elimination, over
+a range of widths and thread/rank counts, and computes parallel
+efficiencies against the single thread/rank run:
+
+    strong: width fixed,                    E = t_1 / (p * t_p)
+    weak:   width grows with p^(1/3),       E = t_1 / t_p
+            (constant O(width^3) work per thread/rank)
+
+The results are written to a CSV file and compared against a baseline
+file (test/baselines/scaling.csv by default). A configuration whose
+efficiency, or whose single thread/rank time, is worse than the
+baseline by more than the tolerance is flagged as a regression and
+the script exits with a non-zero status, as it does when no
+configuration of the sweep is in the baseline at all.
+
+    python3 scaling.py                   # run and compare
+    python3 scaling.py --quick           # fewer repetitions
+    python3 scaling.py --update-baseline # run and store as baseline
+
+Rank counts larger than the core count are run oversubscribed. The
+defaults are the sweep of the checked-in baseline, widths 64 and 128
+on 1 and 2 threads/ranks. For larger sweeps regenerate the baseline
+with the same arguments and --update-baseline on the machine the
+study is meant for.
+"""
+
+import argparse
+import csv
+import os
+import platform
+import shlex
+import subprocess
+import sys
+
+here = os.path.dirname(os.path.abspath(__file__))
+bench = os.path.join(here, "..", "bin", "bench.out")
+
+omp_methods = ("baseline", "transpose", "pretranspose")
+mpi_methods = ("balanced", "transpose", "pretranspose")
+
+fields = ("mode", "backend", "kernel", "method", "width", "procs",
+          "min", "median", "stddev", "gflops", "efficiency", "cpu")
+
+
+def cpu_model():
+    try:
+        with open("/proc/cpuinfo") as f:
+            for line in f:
+                if line.startswith("model name"):
+                    return line.split(":", 1)[1].strip()
+    except OSError:
+        pass
+    return platform.processor() or "unknown"
+
+
+def run_bench(args, backend, kernel, method, width, procs):
+    cmd = [bench, "-b", backend, "-k", kernel, "-m", method,
+           "-w", str(width), "-n", str(args.reps), "-x", str(args.warmup),
+           "-f", "csv"]
+    if backend == "omp":
+        cmd += ["-t", str(procs)]
+    else:
+        cmd = shlex.split(args.mpirun) + ["-np", str(procs)] + cmd + ["-t", "1"]
+    out = subprocess.run(cmd, check=True, capture_output=True, text=True).stdout
+    return next(csv.DictReader(out.splitlines()))
+
+
+def sweep(args):
+    cpu = cpu_model()
+    configs = []
+    for kernel in ("matmul", "elim"):
+        for backend, methods, counts in (("omp", omp_methods, args.threads),
+                                         ("mpi", mpi_methods, args.ranks)):
+            for method in (methods if kernel == "matmul" else ("naive",)):
+                configs.append((kernel, backend, method, counts))
+
+    rows = []
+    for kernel, backend, method, counts in configs:
+        for mode in ("strong", "weak"):
+            for base_width in args.widths:
+                t_1 = None
+                for procs in counts:
+                    width = base_width
+                    if mode == "weak":
+                        width = int(round(base_width * procs ** (1.0 / 3.0)))
+                    result = run_bench(args, backend, kernel, method,
+                                       width, procs)
+                    t_p = float(result["min"])
+                    if t_1 is None:
+                        t_1 = t_p
+                    speedup = t_1 / t_p
+                    rows.append({
+                        "mode": mode, "backend": backend, "kernel": kernel,
+                        "method": method, "width": base_width, "procs": procs,
+                        "min": result["min"], "median": result["median"],
+                        "stddev": result["stddev"], "gflops": result["gflops"],
+                        "efficiency": "%.4f" % (speedup / procs if mode == "strong" else speedup),
+                        "cpu": cpu,
+                    })
+                    print("%-6s %-3s %-6s %-12s width %6d procs %3d  min %.3e s  E %s"
+                          % (mode, backend, kernel, method, width, procs,
+                             t_p, rows[-1]["efficiency"]), flush=True)
+    return rows
+
+
+def key(row):
+    return (row["mode"], row["backend"], row["kernel"], row["method"],
+            int(row["width"]), int(row["procs"]))
+
+
+def compare(rows, baseline_rows, tolerance):
+    baseline = {key(row): row for row in baseline_rows}
+    regressions = []
+    compared = 0
+    for row in rows:
+        ref = baseline.get(key(row))
+        if ref is None:
+            continue
+        if compared == 0 and ref["cpu"] != row["cpu"]:
+            print("warning: baseline was recorded on '%s', comparing anyway" % ref["cpu"])
+        compared += 1
+        eff, ref_eff = float(row["efficiency"]), float(ref["efficiency"])
+        if eff < ref_eff * (1.0 - tolerance):
+            regressions.append("%s: efficiency %.3f, baseline %.3f" % (key(row), eff, ref_eff))
+        if int(row["procs"]) == 1:
+            t, ref_t = float(row["min"]), float(ref["min"])
+            if t > ref_t * (1.0 + tolerance):
+                regressions.append("%s: time %.3e s, baseline %.3e s" % (key(row), t, ref_t))
+    print("compared %d of %d configurations against the baseline" % (compared, len(rows)))
+    if 0 < compared < len(rows):
+        print("warning: %d configurations are not in the baseline and were not checked"
+              % (len(rows) - compared))
+    return compared, regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--widths", type=int, nargs="+", default=[64, 128])
+    parser.add_argument("--threads", type=int, nargs="+", default=[1, 2])
+    parser.add_argument("--ranks", type=int, nargs="+", default=[1, 2])
+    parser.add_argument("--reps", type=int, default=5)
+    parser.add_argument("--warmup", type=int, default=1)
+    parser.add_argument("--quick", action="store_true",
+                        help="3 repetitions")
+    parser.add_argument("--mpirun", default="mpirun --oversubscribe")
+    parser.add_argument("--tolerance", type=float, default=0.15,
+                        help="allowed relative loss in efficiency or time")
+    parser.add_argument("--output", default=os.path.join(here, "output", "scaling.csv"))
+    parser.add_argument("--baseline", default=os.path.join(here, "baselines", "scaling.csv"))
+    parser.add_argument("--update-baseline", action="store_true")
+    args = parser.parse_args()
+    if args.quick:
+        args.reps = 3
+    # efficiencies are relative to the first count, which has to be 1
+    args.threads = sorted(set([1] + args.threads))
+    args.ranks = sorted(set([1] + args.ranks))
+
+    rows = sweep(args)
+    out = args.baseline if args.update_baseline else args.output
+    os.makedirs(os.path.dirname(out), exist_ok=True)
+    with open(out, "w", newline="") as f:
+        writer = csv.DictWriter(f, fieldnames=fields)
+        writer.writeheader()
+        writer.writerows(rows)
+    print("results written to %s" % out)
+    if args.update_baseline:
+        return 0
+
+    if not os.path.exists(args.baseline):
+        print("no baseline at %s, nothing to compare against" % args.baseline)
+        return 0
+    with open(args.baseline, newline="") as f:
+        compared, regressions = compare(rows, list(csv.DictReader(f)), args.tolerance)
+    if compared == 0:
+        print("ERROR: no configuration of the sweep is in the baseline %s, nothing was "
+              "checked. Run the baseline's widths and counts, or regenerate it with "
+              "--update-baseline" % args.baseline)
+        return 2
+    for regression in regressions:
+        print("REGRESSION %s" % regression)
+    if regressions:
+        return 1
+    print("no regressions beyond %.0f%%" % (100 * args.tolerance))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
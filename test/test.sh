@@ -1,5 +1,10 @@
 #!/bin/bash
 
+# bind the threads, spread over the sockets, so that the first touch
+# placement of the benchmark matches the threads that use the rows
+export OMP_PLACES=${OMP_PLACES:-cores}
+export OMP_PROC_BIND=${OMP_PROC_BIND:-spread}
+
 widths=(100 1000 5000 10000)
 threads=(4 6 12 20)
 
@@ -41,6 +46,7 @@ impl=1
 if [ ! -e output/ ]; then
     mkdir output
 fi
+echo "backend,kernel,method,width,threads,ranks,reps,warmup,min,median,mean,stddev,gflops,gbytes_per_s" > $timefile
 
 # timing study for different input sizes for 12 threads
 echo $impl
@@ -50,9 +56,9 @@ while [ $impl -le $num_impl ]; do
         m1="${m1_files[$i]}"
         m2="${m2_files[$i]}"
         width="${widths[$i]}"         
-        "../bin/omp.out -l $m1 -r $m2 -i $impl -t $base_num_threads -w $width > output/output.dat 2>> $timefile"
+        ../bin/bench.out -b omp -m $(expr $impl - 1) -t $base_num_threads \
+            -w $width -l $m1 -r $m2 -n 5 -x 1 -N >> $timefile 2>> output/output.dat
     done
-    echo -e "\n" >> $timefile
     impl=$(expr $impl + 1)
 done
 